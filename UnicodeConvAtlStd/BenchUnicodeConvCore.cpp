@@ -0,0 +1,968 @@
+////////////////////////////////////////////////////////////////////////////////
+// BenchUnicodeConvCore.cpp : Benchmark the portable transcoding core
+// by Giovanni Dicanio <giovanni.dicanio AT gmail.com>
+//
+// This file depends only on the C++ Standard Library, e.g.:
+//
+//      g++ -std=c++17 -O2 BenchUnicodeConvCore.cpp -o BenchUnicodeConvCore
+//
+// The engine runs with the best kernel tier of the processor; to compare
+// tiers, set the UNICODECONVATLSTD_KERNEL_TIER environment variable.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "UnicodeConvCore.hpp"       // Module to benchmark
+#include "UnicodeConvParallel.hpp"   // Module to benchmark
+
+#include <chrono>                    // For timing
+#include <cstdio>                    // For console output
+#include <string>                    // std::string, std::u16string
+#include <vector>                    // std::vector
+
+#if defined(__cpp_lib_memory_resource)
+#include <memory_resource>           // std::pmr::monotonic_buffer_resource
+#endif
+
+
+//
+// Input corpora
+//
+
+// Build a UTF-16 string of about 'length' code units,
+// repeating the given sample text
+std::u16string MakeUtf16Corpus(const char16_t* sample, size_t length)
+{
+    const std::u16string sampleString(sample);
+
+    std::u16string corpus;
+    corpus.reserve(length + sampleString.length());
+    while (corpus.length() < length)
+    {
+        corpus += sampleString;
+    }
+
+    return corpus;
+}
+
+
+struct Corpus
+{
+    const char* name;
+    const char16_t* sample;
+};
+
+const Corpus kCorpora[] =
+{
+    { "ASCII",  u"The quick brown fox jumps over the lazy dog. {\"id\": 12345} " },
+    { "Latin",  u"D\x00FCsseldorf, M\x00E1laga, \x00C7e\x015Fme, \x0160ibenik, Z\x00FCrich. " },
+    { "Cyrillic", u"\x041F\x0440\x0438\x0432\x0435\x0442, \x043C\x0438\x0440! \x0417\x0434\x0440\x0430\x0432\x0441\x0442\x0432\x0443\x0439\x0442\x0435. " },
+    { "CJK",    u"\x5B66\x751F\x306F\x65E5\x672C\x8A9E\x3092\x52C9\x5F37\x3057\x307E\x3059\x3002" },
+    { "Emoji",  u"\xD83D\xDE00\xD83D\xDE80\xD83C\xDF89\xD83D\xDC4D " },
+    { "Mixed",  u"{\"name\": \"M\x00FCller\", \"city\": \"\x6771\x4EAC\", \"text\": \"\x041F\x0440\x0438\x0432\x0435\x0442 \xD83D\xDE00\"} " },
+};
+
+
+//
+// Timing helpers
+//
+
+// Run 'func' repeatedly for a short while and return the throughput
+// in MB/s of input data
+template <typename Func>
+double MeasureThroughput(size_t inputBytes, Func func)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr auto kMinDuration = std::chrono::milliseconds(300);
+
+    size_t iterations = 0;
+    const auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    do
+    {
+        func();
+        iterations++;
+        elapsed = Clock::now() - start;
+    } while (elapsed < kMinDuration);
+
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    return (static_cast<double>(inputBytes) * iterations) / (seconds * 1e6);
+}
+
+
+// Prevent the optimizer from discarding benchmark results
+volatile size_t g_sink = 0;
+
+
+//
+// Reference two-pass conversion: first measure the output length,
+// then allocate exactly and convert (as the former
+// WideCharToMultiByte-based implementation did).
+//
+
+size_t MeasureUtf8Length(std::u16string_view utf16)
+{
+    size_t length = 0;
+    for (size_t i = 0; i < utf16.length(); i++)
+    {
+        const char16_t unit = utf16[i];
+        if (unit < 0x80)
+        {
+            length += 1;
+        }
+        else if (unit < 0x800)
+        {
+            length += 2;
+        }
+        else if (unit >= 0xD800 && unit <= 0xDBFF)
+        {
+            length += 4;
+            i++;
+        }
+        else
+        {
+            length += 3;
+        }
+    }
+    return length;
+}
+
+std::string TwoPassUtf16ToUtf8(std::u16string_view utf16)
+{
+    std::string utf8(MeasureUtf8Length(utf16), ' ');
+    (void)UnicodeConvAtlStd::Details::ConvertUtf16ToUtf8Scalar(
+        utf16.data(), utf16.length(), utf8.data());
+    return utf8;
+}
+
+size_t MeasureUtf16Length(std::string_view utf8)
+{
+    size_t length = 0;
+    for (size_t i = 0; i < utf8.length(); )
+    {
+        char32_t codePoint = 0;
+        const size_t sequenceLength = UnicodeConvAtlStd::Details::DecodeUtf8Sequence(
+            utf8.data() + i, utf8.length() - i, codePoint);
+        if (sequenceLength == 0)
+        {
+            return 0;
+        }
+        length += (codePoint < 0x10000) ? 1 : 2;
+        i += sequenceLength;
+    }
+    return length;
+}
+
+std::u16string TwoPassUtf8ToUtf16(std::string_view utf8)
+{
+    std::u16string utf16(MeasureUtf16Length(utf8), u' ');
+    (void)UnicodeConvAtlStd::Details::ConvertUtf8ToUtf16Scalar(
+        utf8.data(), utf8.length(), utf16.data());
+    return utf16;
+}
+
+
+//
+// Benchmarks
+//
+
+void BenchUtf16ToUtf8()
+{
+    std::printf("UTF-16 -> UTF-8 (MB/s of UTF-16 input)\n");
+    std::printf("  %-9s %12s %12s %12s\n", "corpus", "two-pass", "scalar", "engine");
+
+    for (const Corpus& corpus : kCorpora)
+    {
+        const std::u16string utf16 = MakeUtf16Corpus(corpus.sample, 1 << 20);
+        const size_t inputBytes = utf16.length() * sizeof(char16_t);
+
+        const double twoPass = MeasureThroughput(inputBytes, [&]
+        {
+            g_sink = g_sink + TwoPassUtf16ToUtf8(utf16).length();
+        });
+
+        const double scalar = MeasureThroughput(inputBytes, [&]
+        {
+            std::string utf8(utf16.length() * 3, ' ');
+            const auto result = UnicodeConvAtlStd::Details::ConvertUtf16ToUtf8Scalar(
+                utf16.data(), utf16.length(), utf8.data());
+            utf8.resize(result.unitsWritten);
+            g_sink = g_sink + utf8.length();
+        });
+
+        const double engine = MeasureThroughput(inputBytes, [&]
+        {
+            std::string utf8;
+            (void)UnicodeConvAtlStd::Details::Utf16ToUtf8SinglePass(utf16, utf8);
+            g_sink = g_sink + utf8.length();
+        });
+
+        std::printf("  %-9s %12.1f %12.1f %12.1f\n", corpus.name, twoPass, scalar, engine);
+    }
+}
+
+
+void BenchUtf8ToUtf16()
+{
+    std::printf("UTF-8 -> UTF-16 (MB/s of UTF-8 input)\n");
+    std::printf("  %-9s %12s %12s %12s\n", "corpus", "two-pass", "scalar", "engine");
+
+    for (const Corpus& corpus : kCorpora)
+    {
+        std::string utf8;
+        (void)UnicodeConvAtlStd::Details::Utf16ToUtf8SinglePass(
+            MakeUtf16Corpus(corpus.sample, 1 << 20), utf8);
+        const size_t inputBytes = utf8.length();
+
+        const double twoPass = MeasureThroughput(inputBytes, [&]
+        {
+            g_sink = g_sink + TwoPassUtf8ToUtf16(utf8).length();
+        });
+
+        const double scalar = MeasureThroughput(inputBytes, [&]
+        {
+            std::u16string utf16(utf8.length(), u' ');
+            const auto result = UnicodeConvAtlStd::Details::ConvertUtf8ToUtf16Scalar(
+                utf8.data(), utf8.length(), utf16.data());
+            utf16.resize(result.unitsWritten);
+            g_sink = g_sink + utf16.length();
+        });
+
+        const double engine = MeasureThroughput(inputBytes, [&]
+        {
+            std::u16string utf16;
+            (void)UnicodeConvAtlStd::Details::Utf8ToUtf16SinglePass(utf8, utf16);
+            g_sink = g_sink + utf16.length();
+        });
+
+        std::printf("  %-9s %12.1f %12.1f %12.1f\n", corpus.name, twoPass, scalar, engine);
+    }
+}
+
+
+//
+// ASCII fast path microbenchmark: the conversion with and without
+// the word-at-a-time leading ASCII conversion (and the exact allocation
+// of pure ASCII UTF-8 output), on many short strings and on long text.
+//
+
+// Identifier-like ASCII strings of 4 to 32 chars; one in 'nonAsciiEvery'
+// (if not zero) ends with a non-ASCII letter
+std::vector<std::u16string> MakeIdentifiers(size_t count, size_t nonAsciiEvery)
+{
+    static const char16_t* const kWords[] =
+    {
+        u"user", u"Name", u"id", u"Count", u"total", u"Buffer", u"m_", u"Index", u"max", u"Length"
+    };
+
+    std::vector<std::u16string> identifiers;
+    for (size_t i = 0; i < count; i++)
+    {
+        std::u16string identifier;
+        const size_t length = 4 + (i * 7) % 29;
+        for (size_t word = i; identifier.length() < length; word = word * 31 + 7)
+        {
+            identifier += kWords[word % 10];
+        }
+        identifier.resize(length);
+        if (nonAsciiEvery != 0 && i % nonAsciiEvery == 0)
+        {
+            identifier.back() = u'\x00E9';
+        }
+        identifiers.push_back(identifier);
+    }
+    return identifiers;
+}
+
+
+// The UTF-16 to UTF-8 conversion without the ASCII fast path:
+// worst-case allocation, kernels and scalar code from the first code unit
+std::string Utf16ToUtf8WithoutAsciiPath(std::u16string_view utf16)
+{
+    using namespace UnicodeConvAtlStd::Details;
+
+    std::string utf8(utf16.length() * kMaxUtf8CharsPerUtf16Unit, '\0');
+    const auto kernel = GetKernelTable().utf16ToUtf8;
+    const UnicodeConvAtlStd::ConversionResult result = (kernel == nullptr)
+        ? ConvertUtf16ToUtf8Scalar(utf16.data(), utf16.length(), utf8.data())
+        : RunConversionEngine(utf16.data(), utf16.length(), utf8.data(), kernel, ConvertUtf16ToUtf8Scalar);
+    utf8.resize(result.unitsWritten);
+    ShrinkIfWasteful(utf8);
+    return utf8;
+}
+
+
+// The UTF-8 to UTF-16 conversion without the ASCII fast path
+std::u16string Utf8ToUtf16WithoutAsciiPath(std::string_view utf8)
+{
+    using namespace UnicodeConvAtlStd::Details;
+
+    std::u16string utf16(utf8.length(), u'\0');
+    const auto kernel = GetKernelTable().utf8ToUtf16;
+    const UnicodeConvAtlStd::ConversionResult result = (kernel == nullptr)
+        ? ConvertUtf8ToUtf16Scalar(utf8.data(), utf8.length(), utf16.data())
+        : RunConversionEngine(utf8.data(), utf8.length(), utf16.data(), kernel, ConvertUtf8ToUtf16Scalar);
+    utf16.resize(result.unitsWritten);
+    ShrinkIfWasteful(utf16);
+    return utf16;
+}
+
+
+void BenchAsciiFastPath()
+{
+    using UnicodeConvAtlStd::KernelTier;
+
+    struct Input
+    {
+        const char* name;
+        std::vector<std::u16string> utf16;
+    };
+
+    Input inputs[] =
+    {
+        { "ASCII ids", MakeIdentifiers(4096, 0) },
+        { "mostly ids", MakeIdentifiers(4096, 8) },
+        { "ASCII text", { MakeUtf16Corpus(kCorpora[0].sample, 1 << 20) } },
+        { "mostly text", { MakeUtf16Corpus(kCorpora[0].sample, 1 << 20) } },
+    };
+
+    // A non-ASCII letter about every 1000 code units
+    std::u16string& mostlyText = inputs[3].utf16[0];
+    for (size_t i = 500; i < mostlyText.length(); i += 1000)
+    {
+        mostlyText[i] = u'\x00E9';
+    }
+
+    const KernelTier bestTier = UnicodeConvAtlStd::GetKernelTier();
+
+    std::printf("ASCII fast path (MB/s of input; without / with the ASCII path)\n");
+    std::printf("  %-12s %-7s %12s %12s %12s %12s\n",
+                "input", "tier", "16->8 w/o", "16->8 with", "8->16 w/o", "8->16 with");
+
+    for (const Input& input : inputs)
+    {
+        std::vector<std::string> utf8;
+        size_t utf16Bytes = 0;
+        size_t utf8Bytes = 0;
+        for (const std::u16string& utf16 : input.utf16)
+        {
+            utf8.push_back(UnicodeConvAtlStd::Utf16ToUtf8(utf16));
+            utf16Bytes += utf16.length() * sizeof(char16_t);
+            utf8Bytes += utf8.back().length();
+        }
+
+        for (KernelTier tier : { bestTier, KernelTier::Scalar })
+        {
+            UnicodeConvAtlStd::SetKernelTier(tier);
+
+            const double utf16ToUtf8Without = MeasureThroughput(utf16Bytes, [&]
+            {
+                for (const std::u16string& utf16 : input.utf16)
+                {
+                    g_sink = g_sink + Utf16ToUtf8WithoutAsciiPath(utf16).length();
+                }
+            });
+            const double utf16ToUtf8With = MeasureThroughput(utf16Bytes, [&]
+            {
+                for (const std::u16string& utf16 : input.utf16)
+                {
+                    g_sink = g_sink + UnicodeConvAtlStd::Utf16ToUtf8(utf16).length();
+                }
+            });
+            const double utf8ToUtf16Without = MeasureThroughput(utf8Bytes, [&]
+            {
+                for (const std::string& text : utf8)
+                {
+                    g_sink = g_sink + Utf8ToUtf16WithoutAsciiPath(text).length();
+                }
+            });
+            const double utf8ToUtf16With = MeasureThroughput(utf8Bytes, [&]
+            {
+                for (const std::string& text : utf8)
+                {
+                    g_sink = g_sink + UnicodeConvAtlStd::Utf8ToUtf16(text).length();
+                }
+            });
+
+            std::printf("  %-12s %-7s %12.1f %12.1f %12.1f %12.1f\n",
+                        input.name, UnicodeConvAtlStd::GetKernelTierName(tier),
+                        utf16ToUtf8Without, utf16ToUtf8With, utf8ToUtf16Without, utf8ToUtf16With);
+        }
+    }
+
+    UnicodeConvAtlStd::SetKernelTier(bestTier);
+}
+
+
+//
+// Validation benchmark: checking the input by converting it (as callers
+// had to do before the validators), against the scalar and vectorized validators.
+//
+
+void BenchValidation()
+{
+    using UnicodeConvAtlStd::KernelTier;
+
+    const KernelTier bestTier = UnicodeConvAtlStd::GetKernelTier();
+
+    std::printf("Validation (MB/s of input; converting / scalar / %s validator)\n",
+                UnicodeConvAtlStd::GetKernelTierName(bestTier));
+    std::printf("  %-9s %12s %12s %12s %12s %12s %12s\n", "corpus",
+                "UTF-8 conv", "UTF-8 scal", "UTF-8 simd", "UTF-16 conv", "UTF-16 scal", "UTF-16 simd");
+
+    for (const Corpus& corpus : kCorpora)
+    {
+        const std::u16string utf16 = MakeUtf16Corpus(corpus.sample, 1 << 20);
+        const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+        const size_t utf16Bytes = utf16.length() * sizeof(char16_t);
+
+        const double utf8Convert = MeasureThroughput(utf8.length(), [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf8ToUtf16(utf8).length();
+        });
+        const double utf16Convert = MeasureThroughput(utf16Bytes, [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf16ToUtf8(utf16).length();
+        });
+
+        double utf8Validate[2] = {};
+        double utf16Validate[2] = {};
+        const KernelTier tiers[2] = { KernelTier::Scalar, bestTier };
+        for (int i = 0; i < 2; i++)
+        {
+            UnicodeConvAtlStd::SetKernelTier(tiers[i]);
+            utf8Validate[i] = MeasureThroughput(utf8.length(), [&]
+            {
+                g_sink = g_sink + UnicodeConvAtlStd::IsValidUtf8(utf8);
+            });
+            utf16Validate[i] = MeasureThroughput(utf16Bytes, [&]
+            {
+                g_sink = g_sink + UnicodeConvAtlStd::IsValidUtf16(utf16);
+            });
+        }
+        UnicodeConvAtlStd::SetKernelTier(bestTier);
+
+        std::printf("  %-9s %12.1f %12.1f %12.1f %12.1f %12.1f %12.1f\n", corpus.name,
+                    utf8Convert, utf8Validate[0], utf8Validate[1],
+                    utf16Convert, utf16Validate[0], utf16Validate[1]);
+    }
+}
+
+
+//
+// Length query benchmark: the output length taken from a conversion,
+// against the scalar and vectorized length queries.
+//
+
+void BenchLengthQueries()
+{
+    using UnicodeConvAtlStd::KernelTier;
+
+    const KernelTier bestTier = UnicodeConvAtlStd::GetKernelTier();
+
+    std::printf("Length queries (MB/s of input; converting / scalar / %s query)\n",
+                UnicodeConvAtlStd::GetKernelTierName(bestTier));
+    std::printf("  %-9s %12s %12s %12s %12s %12s %12s\n", "corpus",
+                "8->16 conv", "8->16 scal", "8->16 simd", "16->8 conv", "16->8 scal", "16->8 simd");
+
+    for (const Corpus& corpus : kCorpora)
+    {
+        const std::u16string utf16 = MakeUtf16Corpus(corpus.sample, 1 << 20);
+        const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+        const size_t utf16Bytes = utf16.length() * sizeof(char16_t);
+
+        const double utf8Convert = MeasureThroughput(utf8.length(), [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf8ToUtf16(utf8).length();
+        });
+        const double utf16Convert = MeasureThroughput(utf16Bytes, [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf16ToUtf8(utf16).length();
+        });
+
+        double utf8Measure[2] = {};
+        double utf16Measure[2] = {};
+        const KernelTier tiers[2] = { KernelTier::Scalar, bestTier };
+        for (int i = 0; i < 2; i++)
+        {
+            UnicodeConvAtlStd::SetKernelTier(tiers[i]);
+            utf8Measure[i] = MeasureThroughput(utf8.length(), [&]
+            {
+                g_sink = g_sink + UnicodeConvAtlStd::Utf16LengthOf(utf8);
+            });
+            utf16Measure[i] = MeasureThroughput(utf16Bytes, [&]
+            {
+                g_sink = g_sink + UnicodeConvAtlStd::Utf8LengthOf(utf16);
+            });
+        }
+        UnicodeConvAtlStd::SetKernelTier(bestTier);
+
+        std::printf("  %-9s %12.1f %12.1f %12.1f %12.1f %12.1f %12.1f\n", corpus.name,
+                    utf8Convert, utf8Measure[0], utf8Measure[1],
+                    utf16Convert, utf16Measure[0], utf16Measure[1]);
+    }
+}
+
+
+//
+// Error handling benchmark: many short strings, some of them invalid,
+// converted with the throwing API (catching its exceptions)
+// and with the non-throwing Try API.
+//
+
+void BenchErrorHandling()
+{
+    std::printf("Error handling (MB/s of input; 64-char strings; throwing / Try API)\n");
+    std::printf("  %-9s %12s %12s %12s %12s\n", "invalid",
+                "8->16 throw", "8->16 try", "16->8 throw", "16->8 try");
+
+    constexpr size_t kStringCount = 1000;
+    const std::u16string valid16 = MakeUtf16Corpus(kCorpora[5].sample, 64).substr(0, 64);
+    const std::string valid8 = UnicodeConvAtlStd::Utf16ToUtf8(valid16);
+    const std::u16string invalid16 = valid16.substr(0, 32) + u'\xD800' + valid16.substr(33);
+    const std::string invalid8 = valid8.substr(0, valid8.length() - 1) + '\xC0';
+
+    for (const int invalidPercent : { 0, 10, 50, 100 })
+    {
+        std::vector<std::string> utf8Strings;
+        std::vector<std::u16string> utf16Strings;
+        size_t utf8Bytes = 0;
+        size_t utf16Bytes = 0;
+        for (size_t i = 0; i < kStringCount; i++)
+        {
+            const bool invalid = (i % 100) < static_cast<size_t>(invalidPercent);
+            utf8Strings.push_back(invalid ? invalid8 : valid8);
+            utf16Strings.push_back(invalid ? invalid16 : valid16);
+            utf8Bytes += utf8Strings.back().length();
+            utf16Bytes += utf16Strings.back().length() * sizeof(char16_t);
+        }
+
+        const double utf8Throwing = MeasureThroughput(utf8Bytes, [&]
+        {
+            for (const std::string& utf8 : utf8Strings)
+            {
+                try
+                {
+                    g_sink = g_sink + UnicodeConvAtlStd::Utf8ToUtf16(utf8).length();
+                }
+                catch (const UnicodeConvAtlStd::UnicodeConversionException&)
+                {
+                    g_sink = g_sink + 1;
+                }
+            }
+        });
+        const double utf8Try = MeasureThroughput(utf8Bytes, [&]
+        {
+            for (const std::string& utf8 : utf8Strings)
+            {
+                const auto utf16 = UnicodeConvAtlStd::TryUtf8ToUtf16(utf8);
+                g_sink = g_sink + (utf16 ? utf16->length() : 1);
+            }
+        });
+        const double utf16Throwing = MeasureThroughput(utf16Bytes, [&]
+        {
+            for (const std::u16string& utf16 : utf16Strings)
+            {
+                try
+                {
+                    g_sink = g_sink + UnicodeConvAtlStd::Utf16ToUtf8(utf16).length();
+                }
+                catch (const UnicodeConvAtlStd::UnicodeConversionException&)
+                {
+                    g_sink = g_sink + 1;
+                }
+            }
+        });
+        const double utf16Try = MeasureThroughput(utf16Bytes, [&]
+        {
+            for (const std::u16string& utf16 : utf16Strings)
+            {
+                const auto utf8 = UnicodeConvAtlStd::TryUtf16ToUtf8(utf16);
+                g_sink = g_sink + (utf8 ? utf8->length() : 1);
+            }
+        });
+
+        std::printf("  %8d%% %12.1f %12.1f %12.1f %12.1f\n", invalidPercent,
+                    utf8Throwing, utf8Try, utf16Throwing, utf16Try);
+    }
+}
+
+
+//
+// Error policy benchmark: the strict conversion against the one replacing
+// invalid input with U+FFFD, on valid text and on text with an invalid
+// code unit every 4 KB.
+//
+
+void BenchErrorPolicy()
+{
+    std::printf("Error policy (MB/s of input; strict / replace / replace with an error every 4 KB)\n");
+    std::printf("  %-9s %12s %12s %12s %12s %12s %12s\n", "corpus",
+                "8->16 strict", "8->16 repl", "8->16 errs", "16->8 strict", "16->8 repl", "16->8 errs");
+
+    using UnicodeConvAtlStd::ErrorPolicy;
+    constexpr size_t kErrorSpacing = 4096;
+
+    for (const Corpus& corpus : kCorpora)
+    {
+        const std::u16string utf16 = MakeUtf16Corpus(corpus.sample, 1 << 20);
+        const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+
+        std::u16string invalid16 = utf16;
+        for (size_t i = kErrorSpacing; i < invalid16.length(); i += kErrorSpacing)
+        {
+            invalid16[i] = u'\xDC00';
+        }
+        std::string invalid8 = utf8;
+        for (size_t i = kErrorSpacing; i < invalid8.length(); i += kErrorSpacing)
+        {
+            invalid8[i] = '\xFF';
+        }
+
+        const double utf8Strict = MeasureThroughput(utf8.length(), [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf8ToUtf16(utf8).length();
+        });
+        const double utf8Replace = MeasureThroughput(utf8.length(), [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf8ToUtf16(utf8, ErrorPolicy::Replace).length();
+        });
+        const double utf8Errors = MeasureThroughput(invalid8.length(), [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf8ToUtf16(invalid8, ErrorPolicy::Replace).length();
+        });
+
+        const size_t utf16Bytes = utf16.length() * sizeof(char16_t);
+        const double utf16Strict = MeasureThroughput(utf16Bytes, [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf16ToUtf8(utf16).length();
+        });
+        const double utf16Replace = MeasureThroughput(utf16Bytes, [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf16ToUtf8(utf16, ErrorPolicy::Replace).length();
+        });
+        const double utf16Errors = MeasureThroughput(utf16Bytes, [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf16ToUtf8(invalid16, ErrorPolicy::Replace).length();
+        });
+
+        std::printf("  %-9s %12.1f %12.1f %12.1f %12.1f %12.1f %12.1f\n", corpus.name,
+                    utf8Strict, utf8Replace, utf8Errors, utf16Strict, utf16Replace, utf16Errors);
+    }
+}
+
+
+//
+// Batch conversion benchmark: a column of short strings (e.g. names or keys)
+// converted one string at a time, into a string each, and as a single batch,
+// into one string plus offsets.
+//
+
+void BenchBatchConversions()
+{
+    std::printf("Batch conversions (MB/s of input; 100000 strings; per string / batch)\n");
+    std::printf("  %-9s %-8s %12s %12s %12s %12s\n", "corpus", "length",
+                "16->8 each", "16->8 batch", "8->16 each", "8->16 batch");
+
+    constexpr size_t kStringCount = 100000;
+
+    for (const Corpus& corpus : { kCorpora[0], kCorpora[1], kCorpora[5] })
+    {
+        for (const size_t length : { 8, 24, 64 })
+        {
+            // Strings of about the given length, cut at different points of the sample
+            const std::u16string text = MakeUtf16Corpus(corpus.sample, 4 * length + 64);
+            std::vector<std::u16string> utf16Strings;
+            std::vector<std::string> utf8Strings;
+            size_t utf16Bytes = 0;
+            size_t utf8Bytes = 0;
+            for (size_t i = 0; i < kStringCount; i++)
+            {
+                const size_t start = UnicodeConvAtlStd::Details::Utf16ChunkBoundary(text.data(), text.length(), i % 64);
+                const size_t end = UnicodeConvAtlStd::Details::Utf16ChunkBoundary(
+                    text.data(), text.length(), start + length + i % 3);
+                utf16Strings.push_back(text.substr(start, end - start));
+                utf8Strings.push_back(UnicodeConvAtlStd::Utf16ToUtf8(utf16Strings.back()));
+                utf16Bytes += utf16Strings.back().length() * sizeof(char16_t);
+                utf8Bytes += utf8Strings.back().length();
+            }
+            const std::vector<std::u16string_view> utf16Views(utf16Strings.begin(), utf16Strings.end());
+            const std::vector<std::string_view> utf8Views(utf8Strings.begin(), utf8Strings.end());
+
+            const double utf16Each = MeasureThroughput(utf16Bytes, [&]
+            {
+                std::vector<std::string> results;
+                results.reserve(kStringCount);
+                for (const std::u16string_view utf16 : utf16Views)
+                {
+                    results.push_back(UnicodeConvAtlStd::Utf16ToUtf8(utf16));
+                }
+                g_sink = g_sink + results.back().length();
+            });
+            const double utf16Batch = MeasureThroughput(utf16Bytes, [&]
+            {
+                const auto batch = UnicodeConvAtlStd::Utf16ToUtf8Batch(utf16Views.data(), utf16Views.size());
+                g_sink = g_sink + batch.data.length();
+            });
+            const double utf8Each = MeasureThroughput(utf8Bytes, [&]
+            {
+                std::vector<std::u16string> results;
+                results.reserve(kStringCount);
+                for (const std::string_view utf8 : utf8Views)
+                {
+                    results.push_back(UnicodeConvAtlStd::Utf8ToUtf16(utf8));
+                }
+                g_sink = g_sink + results.back().length();
+            });
+            const double utf8Batch = MeasureThroughput(utf8Bytes, [&]
+            {
+                const auto batch = UnicodeConvAtlStd::Utf8ToUtf16Batch(utf8Views.data(), utf8Views.size());
+                g_sink = g_sink + batch.data.length();
+            });
+
+            std::printf("  %-9s %-8zu %12.1f %12.1f %12.1f %12.1f\n", corpus.name, length,
+                        utf16Each, utf16Batch, utf8Each, utf8Batch);
+        }
+    }
+}
+
+
+//
+// Parallel conversion benchmark: a very large buffer converted
+// on the calling thread, and on an increasing number of threads.
+//
+
+void BenchParallelConversions()
+{
+    std::printf("Parallel conversions (MB/s of input; 32M code units; serial / threads)\n");
+    std::printf("  %-9s %-8s %10s %10s %10s %10s %10s %10s\n", "corpus", "dir",
+                "serial", "1", "2", "4", "8", "16");
+
+    constexpr size_t kInputLength = size_t{ 32 } << 20;
+
+    for (const Corpus& corpus : { kCorpora[0], kCorpora[3], kCorpora[5] })
+    {
+        const std::u16string utf16 = MakeUtf16Corpus(corpus.sample, kInputLength);
+        const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+        const size_t utf16Bytes = utf16.length() * sizeof(char16_t);
+
+        std::printf("  %-9s %-8s %10.1f", corpus.name, "16->8", MeasureThroughput(utf16Bytes, [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf16ToUtf8(utf16).length();
+        }));
+        for (const unsigned int threadCount : { 1, 2, 4, 8, 16 })
+        {
+            std::printf(" %10.1f", MeasureThroughput(utf16Bytes, [&]
+            {
+                g_sink = g_sink + UnicodeConvAtlStd::Utf16ToUtf8Parallel(
+                    utf16, UnicodeConvAtlStd::ThreadExecutor(threadCount)).length();
+            }));
+        }
+        std::printf("\n");
+
+        std::printf("  %-9s %-8s %10.1f", corpus.name, "8->16", MeasureThroughput(utf8.length(), [&]
+        {
+            g_sink = g_sink + UnicodeConvAtlStd::Utf8ToUtf16(utf8).length();
+        }));
+        for (const unsigned int threadCount : { 1, 2, 4, 8, 16 })
+        {
+            std::printf(" %10.1f", MeasureThroughput(utf8.length(), [&]
+            {
+                g_sink = g_sink + UnicodeConvAtlStd::Utf8ToUtf16Parallel(
+                    utf8, UnicodeConvAtlStd::ThreadExecutor(threadCount)).length();
+            }));
+        }
+        std::printf("\n");
+    }
+}
+
+
+#if defined(__cpp_lib_memory_resource)
+
+//
+// Allocator benchmark: a "request" converting many short strings,
+// allocated from the global heap and from a per-request
+// monotonic_buffer_resource, released at once at the end of the request.
+//
+
+void BenchAllocators()
+{
+    std::printf("Allocators (MB/s of input; 1000 strings per request; heap / monotonic resource)\n");
+    std::printf("  %-9s %-8s %12s %12s %12s %12s\n", "corpus", "length",
+                "16->8 heap", "16->8 pmr", "8->16 heap", "8->16 pmr");
+
+    constexpr size_t kStringCount = 1000;
+    std::vector<char> arena(1 << 20);
+
+    for (const Corpus& corpus : { kCorpora[0], kCorpora[5] })
+    {
+        for (const size_t length : { 16, 64, 256 })
+        {
+            const std::u16string utf16 = MakeUtf16Corpus(corpus.sample, length).substr(0, length);
+            const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+
+            const double utf16Heap = MeasureThroughput(utf16.length() * sizeof(char16_t) * kStringCount, [&]
+            {
+                std::vector<std::string> results;
+                results.reserve(kStringCount);
+                for (size_t i = 0; i < kStringCount; i++)
+                {
+                    results.push_back(UnicodeConvAtlStd::Utf16ToUtf8(utf16));
+                }
+                g_sink = g_sink + results.back().length();
+            });
+            const double utf16Pmr = MeasureThroughput(utf16.length() * sizeof(char16_t) * kStringCount, [&]
+            {
+                std::pmr::monotonic_buffer_resource resource(arena.data(), arena.size());
+                std::pmr::vector<std::pmr::string> results(&resource);
+                results.reserve(kStringCount);
+                for (size_t i = 0; i < kStringCount; i++)
+                {
+                    results.push_back(UnicodeConvAtlStd::Utf16ToUtf8(utf16, &resource));
+                }
+                g_sink = g_sink + results.back().length();
+            });
+            const double utf8Heap = MeasureThroughput(utf8.length() * kStringCount, [&]
+            {
+                std::vector<std::u16string> results;
+                results.reserve(kStringCount);
+                for (size_t i = 0; i < kStringCount; i++)
+                {
+                    results.push_back(UnicodeConvAtlStd::Utf8ToUtf16(utf8));
+                }
+                g_sink = g_sink + results.back().length();
+            });
+            const double utf8Pmr = MeasureThroughput(utf8.length() * kStringCount, [&]
+            {
+                std::pmr::monotonic_buffer_resource resource(arena.data(), arena.size());
+                std::pmr::vector<std::pmr::u16string> results(&resource);
+                results.reserve(kStringCount);
+                for (size_t i = 0; i < kStringCount; i++)
+                {
+                    results.push_back(UnicodeConvAtlStd::Utf8ToUtf16(utf8, &resource));
+                }
+                g_sink = g_sink + results.back().length();
+            });
+
+            std::printf("  %-9s %-8zu %12.1f %12.1f %12.1f %12.1f\n", corpus.name, length,
+                        utf16Heap, utf16Pmr, utf8Heap, utf8Pmr);
+        }
+    }
+}
+
+#endif // __cpp_lib_memory_resource
+
+
+//
+// Output allocation benchmark: the conversion into a string resized
+// (so zero-filled) before converting, against the conversion that
+// writes the output only once (with C++23 resize_and_overwrite).
+//
+
+// The UTF-16 to UTF-8 conversion into a zero-filled worst-case output
+std::string Utf16ToUtf8WithFill(std::u16string_view utf16)
+{
+    using namespace UnicodeConvAtlStd::Details;
+
+    std::string utf8(utf16.length() * kMaxUtf8CharsPerUtf16Unit, '\0');
+    const UnicodeConvAtlStd::ConversionResult result =
+        ConvertUtf16ToUtf8(utf16.data(), utf16.length(), utf8.data());
+    utf8.resize(result.unitsWritten);
+    ShrinkIfWasteful(utf8);
+    return utf8;
+}
+
+
+// The UTF-8 to UTF-16 conversion into a zero-filled worst-case output
+std::u16string Utf8ToUtf16WithFill(std::string_view utf8)
+{
+    using namespace UnicodeConvAtlStd::Details;
+
+    std::u16string utf16(utf8.length(), u'\0');
+    const UnicodeConvAtlStd::ConversionResult result =
+        ConvertUtf8ToUtf16(utf8.data(), utf8.length(), utf16.data());
+    utf16.resize(result.unitsWritten);
+    ShrinkIfWasteful(utf16);
+    return utf16;
+}
+
+
+void BenchOutputAllocation()
+{
+#if defined(__cpp_lib_string_resize_and_overwrite)
+    const char* const strategy = "resize_and_overwrite";
+#else
+    const char* const strategy = "resize (no C++23 resize_and_overwrite)";
+#endif
+
+    std::printf("Output allocation (MB/s of input; zero-filled / written once with %s)\n", strategy);
+    std::printf("  %-9s %-8s %12s %12s %12s %12s\n",
+                "corpus", "input", "16->8 fill", "16->8 once", "8->16 fill", "8->16 once");
+
+    constexpr size_t kInputSizes[] = { 1 << 10, 64 << 10, 1 << 20, 16 << 20, 100 << 20 };
+
+    for (const Corpus& corpus : { kCorpora[0], kCorpora[3] })
+    {
+        for (size_t inputSize : kInputSizes)
+        {
+            // Input sizes are in bytes of UTF-16 text
+            const std::u16string utf16 = MakeUtf16Corpus(corpus.sample, inputSize / sizeof(char16_t));
+            const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+            const size_t utf16Bytes = utf16.length() * sizeof(char16_t);
+
+            const double utf16ToUtf8Fill = MeasureThroughput(utf16Bytes, [&]
+            {
+                g_sink = g_sink + Utf16ToUtf8WithFill(utf16).length();
+            });
+            const double utf16ToUtf8Once = MeasureThroughput(utf16Bytes, [&]
+            {
+                g_sink = g_sink + UnicodeConvAtlStd::Utf16ToUtf8(utf16).length();
+            });
+            const double utf8ToUtf16Fill = MeasureThroughput(utf8.length(), [&]
+            {
+                g_sink = g_sink + Utf8ToUtf16WithFill(utf8).length();
+            });
+            const double utf8ToUtf16Once = MeasureThroughput(utf8.length(), [&]
+            {
+                g_sink = g_sink + UnicodeConvAtlStd::Utf8ToUtf16(utf8).length();
+            });
+
+            char sizeName[16];
+            std::snprintf(sizeName, sizeof(sizeName), (inputSize < (1 << 20)) ? "%zu KB" : "%zu MB",
+                          (inputSize < (1 << 20)) ? (inputSize >> 10) : (inputSize >> 20));
+            std::printf("  %-9s %-8s %12.1f %12.1f %12.1f %12.1f\n",
+                        corpus.name, sizeName,
+                        utf16ToUtf8Fill, utf16ToUtf8Once, utf8ToUtf16Fill, utf8ToUtf16Once);
+        }
+    }
+}
+
+
+int main()
+{
+    std::printf("Kernel tier: %s\n\n",
+                UnicodeConvAtlStd::GetKernelTierName(UnicodeConvAtlStd::GetKernelTier()));
+    BenchUtf16ToUtf8();
+    std::printf("\n");
+    BenchUtf8ToUtf16();
+    std::printf("\n");
+    BenchAsciiFastPath();
+    std::printf("\n");
+    BenchValidation();
+    std::printf("\n");
+    BenchLengthQueries();
+    std::printf("\n");
+    BenchErrorHandling();
+    std::printf("\n");
+    BenchErrorPolicy();
+    std::printf("\n");
+#if defined(__cpp_lib_memory_resource)
+    BenchAllocators();
+    std::printf("\n");
+#endif
+    BenchBatchConversions();
+    std::printf("\n");
+    BenchParallelConversions();
+    std::printf("\n");
+    BenchOutputAllocation();
+}
@@ -7,6 +7,12 @@
 #include "UnicodeConvAtlStd.hpp"     // Module to test
 
 #include <iostream>                  // For console output
+#include <string>                    // std::wstring
+#include <vector>                    // std::vector
+
+#if defined(__cpp_lib_memory_resource)
+#include <memory_resource>           // std::pmr::monotonic_buffer_resource
+#endif
 
 
 // Convenient function to print PASSED/FAILED on a single test,
@@ -77,6 +83,246 @@ void TestStringLengths()
 }
 
 
+void TestInvalidInput()
+{
+    // Lone high surrogate (not followed by a low surrogate)
+    CString invalidUtf16 = L"Invalid \xD800 UTF-16";
+    bool thrown = false;
+    try
+    {
+        std::string utf8 = UnicodeConvAtlStd::ToUtf8(invalidUtf16);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorCode() == ERROR_NO_UNICODE_TRANSLATION);
+    }
+    ATLASSERT(thrown);
+    Check(thrown, "Invalid UTF-16 input");
+
+    // Overlong encoding of '/'
+    std::string invalidUtf8 = "Invalid \xC0\xAF UTF-8";
+    thrown = false;
+    try
+    {
+        CString utf16 = UnicodeConvAtlStd::ToUtf16(invalidUtf8);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorCode() == ERROR_NO_UNICODE_TRANSLATION);
+    }
+    ATLASSERT(thrown);
+    Check(thrown, "Invalid UTF-8 input");
+}
+
+
+void TestAppend()
+{
+    CString utf16 = L"Kanji:";
+    UnicodeConvAtlStd::AppendUtf16(utf16, " \xE5\xAD\xA6");
+    UnicodeConvAtlStd::AppendUtf16(utf16, " ok");
+    ATLASSERT(utf16 == L"Kanji: \x5B66 ok");
+    Check(utf16 == L"Kanji: \x5B66 ok", "Append UTF-16 conversions to CString");
+
+    std::string utf8 = "Kanji:";
+    UnicodeConvAtlStd::AppendUtf8(utf8, CString(L" \x5B66"));
+    UnicodeConvAtlStd::AppendUtf8(utf8, CString(L" ok"));
+    ATLASSERT(utf8 == "Kanji: \xE5\xAD\xA6 ok");
+    Check(utf8 == "Kanji: \xE5\xAD\xA6 ok", "Append UTF-8 conversions to std::string");
+
+    // On invalid input, the destination CString must be left as it was
+    bool thrown = false;
+    try
+    {
+        UnicodeConvAtlStd::AppendUtf16(utf16, "Invalid \xC0\xAF UTF-8");
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorCode() == ERROR_NO_UNICODE_TRANSLATION);
+    }
+    ATLASSERT(thrown && utf16 == L"Kanji: \x5B66 ok");
+    Check(thrown && utf16 == L"Kanji: \x5B66 ok", "Append invalid UTF-8 input to CString");
+}
+
+
+void TestInputLongerThanOutputLimit()
+{
+    // The UTF-16 output length limit of CString (INT_MAX) is lowered here,
+    // to test UTF-8 input longer than the limit without multi-GB strings.
+
+    // Four kanji: 12 UTF-8 chars, 4 UTF-16 code units
+    const std::string kanji = "\xE5\xAD\xA6\xE5\xAD\xA6\xE5\xAD\xA6\xE5\xAD\xA6";
+    CString utf16;
+    UnicodeConvAtlStd::Details::AppendUtf8ToCString(utf16, kanji, 4);
+    ATLASSERT(utf16 == L"\x5B66\x5B66\x5B66\x5B66");
+    Check(utf16 == L"\x5B66\x5B66\x5B66\x5B66", "UTF-8 input longer than the CString limit");
+
+    // Output too long: overflow_error, and the CString is left as it was
+    utf16 = L"ab";
+    bool thrown = false;
+    try
+    {
+        // "ab" + U+1F600 (a surrogate pair) can't fit 3 code units
+        UnicodeConvAtlStd::Details::AppendUtf8ToCString(utf16, "\xF0\x9F\x98\x80", 3);
+    }
+    catch (const std::overflow_error&)
+    {
+        thrown = true;
+    }
+    ATLASSERT(thrown && utf16 == L"ab");
+    Check(thrown && utf16 == L"ab", "UTF-16 output longer than the CString limit");
+}
+
+
+void TestValidation()
+{
+    const CString validUtf16 = L"Japanese kanji \x5B66 \xD83D\xDE00";
+    const CString invalidUtf16 = L"Invalid \xD800 UTF-16";
+
+    const bool valid = UnicodeConvAtlStd::IsValidUtf16(validUtf16)
+        && UnicodeConvAtlStd::IsValidUtf8(UnicodeConvAtlStd::ToUtf8(validUtf16));
+    ATLASSERT(valid);
+    Check(valid, "Validate UTF-16 and UTF-8 strings");
+
+    const bool invalid = !UnicodeConvAtlStd::IsValidUtf16(invalidUtf16)
+        && UnicodeConvAtlStd::FindInvalidUtf16(invalidUtf16) == 8
+        && UnicodeConvAtlStd::FindInvalidUtf8(std::string("Invalid \xC0\xAF UTF-8")) == 8;
+    ATLASSERT(invalid);
+    Check(invalid, "Find invalid UTF-16 and UTF-8 input");
+}
+
+
+void TestNonThrowingConversions()
+{
+    const CString utf16 = L"Japanese kanji \x5B66";
+    const std::string utf8 = "Japanese kanji \xE5\xAD\xA6";
+
+    const auto toUtf8 = UnicodeConvAtlStd::TryToUtf8(utf16);
+    const auto toUtf16 = UnicodeConvAtlStd::TryToUtf16(utf8);
+    const bool converted = toUtf8.has_value() && *toUtf8 == utf8
+        && toUtf16.has_value() && *toUtf16 == utf16;
+    ATLASSERT(converted);
+    Check(converted, "Try conversions of valid input");
+
+    const auto invalidUtf16 = UnicodeConvAtlStd::TryToUtf8(CString(L"Invalid \xD800 UTF-16"));
+    const auto invalidUtf8 = UnicodeConvAtlStd::TryToUtf16(std::string("Invalid \xC0\xAF UTF-8"));
+    const bool failed = !invalidUtf16
+        && invalidUtf16.error().status == UnicodeConvAtlStd::ConversionStatus::InvalidInput
+        && !invalidUtf8
+        && invalidUtf8.error().status == UnicodeConvAtlStd::ConversionStatus::InvalidInput;
+    ATLASSERT(failed);
+    Check(failed, "Try conversions of invalid input");
+
+    const bool reported = invalidUtf16.error().offset == 8
+        && invalidUtf16.error().kind == UnicodeConvAtlStd::ConversionErrorKind::LoneHighSurrogate
+        && invalidUtf8.error().offset == 8
+        && invalidUtf8.error().kind == UnicodeConvAtlStd::ConversionErrorKind::OverlongEncoding;
+    ATLASSERT(reported);
+    Check(reported, "Report offset and kind of invalid input");
+}
+
+
+void TestLengthQueries()
+{
+    const CString utf16 = L"Japanese kanji \x5B66 \xD83D\xDE00";
+    const std::string utf8 = UnicodeConvAtlStd::ToUtf8(utf16);
+
+    const bool sameLengths = UnicodeConvAtlStd::Utf8LengthOf(utf16) == utf8.length()
+        && UnicodeConvAtlStd::Utf16LengthOf(utf8) == static_cast<size_t>(utf16.GetLength());
+    ATLASSERT(sameLengths);
+    Check(sameLengths, "Length queries match the conversions");
+}
+
+
+void TestErrorPolicy()
+{
+    using UnicodeConvAtlStd::ErrorPolicy;
+
+    size_t count16 = 0;
+    size_t count8 = 0;
+    const CString utf16 = UnicodeConvAtlStd::ToUtf16("a\xF0\x9F\x98" "b\xC0", ErrorPolicy::Replace, &count16);
+    const std::string utf8 = UnicodeConvAtlStd::ToUtf8(CString(L"a\xD83D" L"b"), ErrorPolicy::Replace, &count8);
+
+    const bool replaced = utf16 == L"a\xFFFD" L"b\xFFFD" && count16 == 2
+        && utf8 == "a\xEF\xBF\xBD" "b" && count8 == 1;
+    ATLASSERT(replaced);
+    Check(replaced, "Replace invalid input with U+FFFD");
+}
+
+
+void TestOtherStringTypes()
+{
+    const CString utf16 = L"Japanese kanji \x5B66 \xD83D\xDE00";
+    const std::wstring utf16Std(utf16.GetString(), utf16.GetLength());
+    const std::string utf8 = UnicodeConvAtlStd::ToUtf8(utf16);
+    const std::vector<char> utf8Vector(utf8.begin(), utf8.end());
+
+    bool converted = UnicodeConvAtlStd::Utf16ToUtf8(utf16Std) == utf8
+        && UnicodeConvAtlStd::Utf8ToUtf16<std::wstring>(utf8) == utf16Std
+        && UnicodeConvAtlStd::ToUtf16(std::string_view(utf8)) == utf16
+        && UnicodeConvAtlStd::ToUtf16(utf8Vector) == utf16;
+#if defined(__cpp_char8_t)
+    const std::u8string utf8u8(utf8.begin(), utf8.end());
+    converted = converted
+        && UnicodeConvAtlStd::ToUtf8<std::u8string>(utf16) == utf8u8
+        && UnicodeConvAtlStd::ToUtf16(utf8u8) == utf16;
+#endif
+    ATLASSERT(converted);
+    Check(converted, "Convert std::wstring, std::u8string and other string types");
+}
+
+
+void TestSlicesOfLargerBuffers()
+{
+    const std::string buffer = "\xFF" "kanji \xE5\xAD\xA6" "\xFF";
+    const std::string_view slice = std::string_view(buffer).substr(1, buffer.length() - 2);
+    const CString utf16Buffer = L"\xD800" L"kanji \x5B66" L"\xD800";
+
+    CString appended = L"Kanji: ";
+    UnicodeConvAtlStd::AppendUtf16(appended, slice);
+    const auto tried = UnicodeConvAtlStd::TryToUtf16(slice);
+
+    const bool converted = UnicodeConvAtlStd::ToUtf16(slice) == L"kanji \x5B66"
+        && UnicodeConvAtlStd::ToUtf16(buffer.data() + 1, buffer.length() - 2) == L"kanji \x5B66"
+        && UnicodeConvAtlStd::ToUtf8(utf16Buffer.GetString() + 1,
+                                     static_cast<size_t>(utf16Buffer.GetLength() - 2)) == slice
+        && appended == L"Kanji: kanji \x5B66"
+        && tried && *tried == L"kanji \x5B66"
+        && UnicodeConvAtlStd::ToUtf16("kanji") == L"kanji";
+    ATLASSERT(converted);
+    Check(converted, "Convert slices of larger buffers");
+}
+
+
+void TestAllocators()
+{
+    const CString utf16 = L"Japanese kanji \x5B66 \xD83D\xDE00, and some more text to allocate";
+    const std::string utf8 = UnicodeConvAtlStd::ToUtf8(utf16);
+
+    bool converted = std::string_view(UnicodeConvAtlStd::ToUtf8(utf16, std::allocator<char>())) == utf8;
+#if defined(__cpp_lib_memory_resource)
+    char buffer[1024];
+    std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+    const std::pmr::string utf8Pmr = UnicodeConvAtlStd::ToUtf8(utf16, &resource);
+    converted = converted && std::string_view(utf8Pmr) == utf8 && utf8Pmr.get_allocator().resource() == &resource;
+#endif
+    ATLASSERT(converted);
+    Check(converted, "Allocate conversions from the given allocator or memory resource");
+}
+
+
+void TestBatchConversions()
+{
+    const CString utf16[] = { L"name", L"", L"\x5B66\x751F" };
+    const UnicodeConvAtlStd::Utf8Batch batch = UnicodeConvAtlStd::ToUtf8Batch(utf16, 3);
+
+    const bool converted = batch.size() == 3
+        && batch[0] == "name" && batch[1].empty() && batch[2] == "\xE5\xAD\xA6\xE7\x94\x9F"
+        && batch.data == "name\xE5\xAD\xA6\xE7\x94\x9F";
+    ATLASSERT(converted);
+    Check(converted, "Convert batches of CStrings into one string plus offsets");
+}
+
+
 void TestUnicodeConversions()
 {
     std::cout << "*** Test Unicode UTF-16/UTF-8 CString/std::string Conversion Functions *** \n"
@@ -86,6 +332,17 @@ void TestUnicodeConversions()
     TestEmptyStrings();
     TestStringsWithJapaneseKanji();
     TestStringLengths();
+    TestInvalidInput();
+    TestAppend();
+    TestInputLongerThanOutputLimit();
+    TestValidation();
+    TestNonThrowingConversions();
+    TestLengthQueries();
+    TestErrorPolicy();
+    TestOtherStringTypes();
+    TestSlicesOfLargerBuffers();
+    TestAllocators();
+    TestBatchConversions();
 }
 
 
@@ -0,0 +1,1656 @@
+////////////////////////////////////////////////////////////////////////////////
+// TestUnicodeConvCore.cpp : Test the portable transcoding core
+// by Giovanni Dicanio <giovanni.dicanio AT gmail.com>
+//
+// This file depends only on the C++ Standard Library (and on the file API
+// of the operating system, for UnicodeConvFile.hpp), e.g.:
+//
+//      g++ -std=c++17 -O2 TestUnicodeConvCore.cpp -o TestUnicodeConvCore
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "UnicodeConvCore.hpp"       // Module to test
+#include "UnicodeConvFile.hpp"       // Module to test
+#include "UnicodeConvLiterals.hpp"   // Module to test
+#include "UnicodeConvParallel.hpp"   // Module to test
+#include "UnicodeConvStream.hpp"     // Module to test
+#include "UnicodeConvStreambuf.hpp"  // Module to test
+
+#include <array>                     // std::array
+#include <atomic>                    // std::atomic
+#include <cstdlib>                   // std::malloc, std::free
+#include <filesystem>                // std::filesystem::temp_directory_path
+#include <fstream>                   // std::ifstream, std::ofstream
+#include <iostream>                  // For console output
+#include <iterator>                  // std::istreambuf_iterator
+#include <new>                       // std::bad_alloc
+#include <random>                    // std::mt19937
+#include <sstream>                   // std::ostringstream, std::istringstream
+#include <stdexcept>                 // std::runtime_error
+#include <string>                    // std::string, std::u16string
+#include <vector>                    // std::vector
+
+#if defined(__cpp_lib_memory_resource)
+#include <memory_resource>           // std::pmr::monotonic_buffer_resource
+#endif
+
+
+// Number of failed tests, returned as the process exit code
+int g_failedCount = 0;
+
+
+// Convenient function to print PASSED/FAILED on a single test,
+// alongside a short description for the test
+void Check(bool condition, const char* description)
+{
+    std::cout << "[" << description << "]: ";
+    if (condition)
+    {
+        std::cout << "PASSED\n";
+    }
+    else
+    {
+        std::cout << "FAILED\n";
+        g_failedCount++;
+    }
+}
+
+
+// Return true if converting the given UTF-16 input throws
+// UnicodeConversionException with the expected error code
+bool Utf16ToUtf8Throws(std::u16string_view utf16)
+{
+    try
+    {
+        (void)UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        return ex.GetErrorCode() == UnicodeConvAtlStd::kErrorNoUnicodeTranslation
+            && ex.GetConversionType() == UnicodeConvAtlStd::UnicodeConversionException::ConversionType::FromUtf16ToUtf8;
+    }
+    return false;
+}
+
+
+// Return true if converting the given UTF-8 input throws
+// UnicodeConversionException with the expected error code
+bool Utf8ToUtf16Throws(std::string_view utf8)
+{
+    try
+    {
+        (void)UnicodeConvAtlStd::Utf8ToUtf16(utf8);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        return ex.GetErrorCode() == UnicodeConvAtlStd::kErrorNoUnicodeTranslation
+            && ex.GetConversionType() == UnicodeConvAtlStd::UnicodeConversionException::ConversionType::FromUtf8ToUtf16;
+    }
+    return false;
+}
+
+
+// Allocator counting the allocations made through it
+template <typename T>
+struct CountingAllocator
+{
+    using value_type = T;
+
+    size_t* allocationCount;
+
+    explicit CountingAllocator(size_t* count) noexcept : allocationCount(count) {}
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept : allocationCount(other.allocationCount) {}
+
+    T* allocate(size_t count)
+    {
+        ++*allocationCount;
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T* p, size_t count) noexcept
+    {
+        std::allocator<T>().deallocate(p, count);
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U>& other) const noexcept
+    {
+        return allocationCount == other.allocationCount;
+    }
+
+    template <typename U>
+    bool operator!=(const CountingAllocator<U>& other) const noexcept
+    {
+        return allocationCount != other.allocationCount;
+    }
+};
+
+
+// Number of allocations made through the global operator new,
+// to check the code paths that must not allocate
+std::atomic<size_t> g_allocationCount{ 0 };
+
+
+void* operator new(size_t size)
+{
+    ++g_allocationCount;
+    if (void* p = std::malloc((size != 0) ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+
+// GCC 11+ takes the free() of the replacement operator delete, once inlined,
+// for a mismatch with operator new
+#if defined(__GNUC__) && (__GNUC__ >= 11) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GNUC__) && (__GNUC__ >= 11) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+
+// Build a random UTF-16 string of the given length, drawing code points
+// from the ranges that the vectorized kernels treat differently:
+// classes 0-4 are ASCII, 5-6 take 2 UTF-8 chars, 7-8 take 3, 9 take 4
+std::u16string MakeRandomUtf16(std::mt19937& random, size_t length, int firstClass = 0, int lastClass = 9)
+{
+    std::uniform_int_distribution<int> pickClass(firstClass, lastClass);
+    std::u16string utf16;
+    while (utf16.length() < length)
+    {
+        switch (pickClass(random))
+        {
+        case 0: case 1: case 2: case 3: case 4:
+            utf16 += static_cast<char16_t>(std::uniform_int_distribution<int>(0x20, 0x7E)(random));
+            break;
+        case 5: case 6:
+            utf16 += static_cast<char16_t>(std::uniform_int_distribution<int>(0x80, 0x7FF)(random));
+            break;
+        case 7: case 8:
+            utf16 += static_cast<char16_t>(std::uniform_int_distribution<int>(0x800, 0xD7FF)(random));
+            break;
+        default:
+            utf16 += static_cast<char16_t>(std::uniform_int_distribution<int>(0xD800, 0xDBFF)(random));
+            utf16 += static_cast<char16_t>(std::uniform_int_distribution<int>(0xDC00, 0xDFFF)(random));
+            break;
+        }
+    }
+    return utf16;
+}
+
+
+// Compare the (possibly vectorized) conversion engine, validator
+// and length query with the scalar reference
+bool SameAsScalarUtf8ToUtf16(std::string_view utf8)
+{
+    std::u16string expected(utf8.length(), u'\0');
+    std::u16string actual(utf8.length(), u'\0');
+
+    const auto expectedResult = UnicodeConvAtlStd::Details::ConvertUtf8ToUtf16Scalar(
+        utf8.data(), utf8.length(), expected.data());
+    const auto actualResult = UnicodeConvAtlStd::Details::ConvertUtf8ToUtf16(
+        utf8.data(), utf8.length(), actual.data());
+
+    // The validator must find the same error,
+    // and the length query the same error and length
+    const size_t expectedError = (expectedResult.status == UnicodeConvAtlStd::ConversionStatus::Ok)
+        ? std::string_view::npos : expectedResult.unitsRead;
+    const auto measureResult = UnicodeConvAtlStd::Details::MeasureUtf8ToUtf16(utf8.data(), utf8.length());
+
+    return UnicodeConvAtlStd::FindInvalidUtf8(utf8) == expectedError
+        && expectedResult.status == measureResult.status
+        && expectedResult.unitsRead == measureResult.unitsRead
+        && expectedResult.unitsWritten == measureResult.unitsWritten
+        && expectedResult.status == actualResult.status
+        && expectedResult.unitsRead == actualResult.unitsRead
+        && expectedResult.unitsWritten == actualResult.unitsWritten
+        && expected.compare(0, expectedResult.unitsWritten, actual, 0, actualResult.unitsWritten) == 0;
+}
+
+
+// Compare the (possibly vectorized) conversion engine, validator
+// and length query with the scalar reference
+bool SameAsScalarUtf16ToUtf8(std::u16string_view utf16)
+{
+    std::string expected(utf16.length() * 3, '\0');
+    std::string actual(utf16.length() * 3, '\0');
+
+    const auto expectedResult = UnicodeConvAtlStd::Details::ConvertUtf16ToUtf8Scalar(
+        utf16.data(), utf16.length(), expected.data());
+    const auto actualResult = UnicodeConvAtlStd::Details::ConvertUtf16ToUtf8(
+        utf16.data(), utf16.length(), actual.data());
+
+    // The validator must find the same error,
+    // and the length query the same error and length
+    const size_t expectedError = (expectedResult.status == UnicodeConvAtlStd::ConversionStatus::Ok)
+        ? std::u16string_view::npos : expectedResult.unitsRead;
+    const auto measureResult = UnicodeConvAtlStd::Details::MeasureUtf16ToUtf8(utf16.data(), utf16.length());
+
+    return UnicodeConvAtlStd::FindInvalidUtf16(utf16) == expectedError
+        && expectedResult.status == measureResult.status
+        && expectedResult.unitsRead == measureResult.unitsRead
+        && expectedResult.unitsWritten == measureResult.unitsWritten
+        && expectedResult.status == actualResult.status
+        && expectedResult.unitsRead == actualResult.unitsRead
+        && expectedResult.unitsWritten == actualResult.unitsWritten
+        && expected.compare(0, expectedResult.unitsWritten, actual, 0, actualResult.unitsWritten) == 0;
+}
+
+
+//
+// Various Tests
+//
+
+void TestEmptyStrings()
+{
+    Check(UnicodeConvAtlStd::Utf16ToUtf8(u"").empty(), "Empty UTF-16 string");
+    Check(UnicodeConvAtlStd::Utf8ToUtf16("").empty(), "Empty UTF-8 string");
+}
+
+
+void TestStringsWithJapaneseKanji()
+{
+    // Unicode character U+5B66 (Japanese kanji meaning "learn, study")
+    // UTF-16 encoding: 0x5B66
+    // UTF-8 encoding: 0xE5 0xAD 0xA6
+
+    const std::u16string utf16 = u"Japanese kanji \x5B66";
+    const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+    Check(utf8 == "Japanese kanji \xE5\xAD\xA6", "UTF-8 encoding of Japanese kanji");
+    Check(UnicodeConvAtlStd::Utf8ToUtf16(utf8) == utf16, "Round trip of Japanese kanji");
+}
+
+
+void TestAllEncodingLengths()
+{
+    // U+0041, U+00E9, U+20AC, U+1F600: 1, 2, 3 and 4 UTF-8 chars
+    const std::u16string utf16 = u"A\x00E9\x20AC\xD83D\xDE00";
+    const std::string utf8 = "A\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80";
+
+    Check(UnicodeConvAtlStd::Utf16ToUtf8(utf16) == utf8, "UTF-8 encodings of 1 to 4 chars");
+    Check(UnicodeConvAtlStd::Utf8ToUtf16(utf8) == utf16, "UTF-16 decodings of 1 to 4 chars");
+
+    // Boundary code points
+    const std::u16string boundaries = u"\x007F\x0080\x07FF\x0800\xD7FF\xE000\xFFFF\xD800\xDC00\xDBFF\xDFFF";
+    Check(UnicodeConvAtlStd::Utf8ToUtf16(UnicodeConvAtlStd::Utf16ToUtf8(boundaries)) == boundaries,
+          "Round trip of boundary code points");
+}
+
+
+void TestInvalidUtf16()
+{
+    Check(Utf16ToUtf8Throws(u"abc\xD800"), "Lone high surrogate at end");
+    Check(Utf16ToUtf8Throws(u"abc\xD800xyz"), "Lone high surrogate");
+    Check(Utf16ToUtf8Throws(u"abc\xDC00xyz"), "Lone low surrogate");
+    Check(Utf16ToUtf8Throws(u"\xDC00\xD800"), "Reversed surrogate pair");
+}
+
+
+void TestInvalidUtf8()
+{
+    Check(Utf8ToUtf16Throws("\x80"), "Stray continuation byte");
+    Check(Utf8ToUtf16Throws("abc\xE5\xAD"), "Truncated sequence");
+    Check(Utf8ToUtf16Throws("\xC0\xAF"), "Overlong 2-byte encoding");
+    Check(Utf8ToUtf16Throws("\xE0\x80\xAF"), "Overlong 3-byte encoding");
+    Check(Utf8ToUtf16Throws("\xF0\x80\x80\xAF"), "Overlong 4-byte encoding");
+    Check(Utf8ToUtf16Throws("\xED\xA0\x80"), "Encoded surrogate");
+    Check(Utf8ToUtf16Throws("\xF4\x90\x80\x80"), "Code point beyond U+10FFFF");
+    Check(Utf8ToUtf16Throws("\xFF"), "Invalid lead byte");
+}
+
+
+// Code point classes of the random test strings: all mixed,
+// then runs of 2-char, 3-char and 4-char UTF-8 sequences
+const int kRandomClassRanges[][2] = { { 0, 9 }, { 5, 6 }, { 7, 8 }, { 9, 9 } };
+
+
+void TestNonThrowingConversions()
+{
+    using UnicodeConvAtlStd::ConversionStatus;
+    using ConversionType = UnicodeConvAtlStd::UnicodeConversionException::ConversionType;
+
+    const auto utf8 = UnicodeConvAtlStd::TryUtf16ToUtf8(u"Kanji \x5B66");
+    Check(utf8.has_value() && *utf8 == "Kanji \xE5\xAD\xA6", "Try UTF-16 to UTF-8 conversion");
+
+    const auto utf16 = UnicodeConvAtlStd::TryUtf8ToUtf16("Kanji \xE5\xAD\xA6");
+    Check(utf16.has_value() && *utf16 == u"Kanji \x5B66", "Try UTF-8 to UTF-16 conversion");
+
+    const auto invalidUtf16 = UnicodeConvAtlStd::TryUtf16ToUtf8(u"abc\xD800");
+    Check(!invalidUtf16
+          && invalidUtf16.error().status == ConversionStatus::InvalidInput
+          && invalidUtf16.error().conversionType == ConversionType::FromUtf16ToUtf8,
+          "Try UTF-16 to UTF-8 conversion of invalid input");
+
+    const auto invalidUtf8 = UnicodeConvAtlStd::TryUtf8ToUtf16("abc\xE5\xAD");
+    Check(!invalidUtf8
+          && invalidUtf8.error().status == ConversionStatus::InvalidInput
+          && invalidUtf8.error().conversionType == ConversionType::FromUtf8ToUtf16,
+          "Try UTF-8 to UTF-16 conversion of invalid input");
+
+    // Invalid input is reported without allocating, even when the output
+    // wouldn't fit the small string buffer
+    std::u16string longUtf16(1000, u'a');
+    longUtf16[5] = 0xDC00;
+    std::string longUtf8(1000, 'a');
+    longUtf8[5] = '\xFF';
+
+    const size_t allocationCount = g_allocationCount;
+    const auto longInvalidUtf16 = UnicodeConvAtlStd::TryUtf16ToUtf8(longUtf16);
+    const auto longInvalidUtf8 = UnicodeConvAtlStd::TryUtf8ToUtf16(longUtf8);
+    Check(!longInvalidUtf16 && longInvalidUtf16.error().offset == 5
+          && !longInvalidUtf8 && longInvalidUtf8.error().offset == 5
+          && g_allocationCount == allocationCount,
+          "Try conversions of invalid input don't allocate");
+
+    longUtf16[5] = u'a';
+    longUtf8[5] = 'a';
+    const auto longValidUtf16 = UnicodeConvAtlStd::TryUtf16ToUtf8(longUtf16);
+    const auto longValidUtf8 = UnicodeConvAtlStd::TryUtf8ToUtf16(longUtf8);
+    Check(longValidUtf16 && *longValidUtf16 == longUtf8
+          && longValidUtf8 && *longValidUtf8 == longUtf16,
+          "Try conversions of long valid input");
+}
+
+
+// Return true if the conversion of the given UTF-8 input fails
+// at the given offset with the given kind of error,
+// both throwing and with the Try API
+bool Utf8ErrorIs(std::string_view utf8, size_t offset, UnicodeConvAtlStd::ConversionErrorKind kind)
+{
+    const auto result = UnicodeConvAtlStd::TryUtf8ToUtf16(utf8);
+    if (result || result.error().offset != offset || result.error().kind != kind)
+    {
+        return false;
+    }
+
+    try
+    {
+        (void)UnicodeConvAtlStd::Utf8ToUtf16(utf8);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        return ex.GetErrorOffset() == offset && ex.GetErrorKind() == kind;
+    }
+    return false;
+}
+
+
+// Return true if the conversion of the given UTF-16 input fails
+// at the given offset with the given kind of error,
+// both throwing and with the Try API
+bool Utf16ErrorIs(std::u16string_view utf16, size_t offset, UnicodeConvAtlStd::ConversionErrorKind kind)
+{
+    const auto result = UnicodeConvAtlStd::TryUtf16ToUtf8(utf16);
+    if (result || result.error().offset != offset || result.error().kind != kind)
+    {
+        return false;
+    }
+
+    try
+    {
+        (void)UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        return ex.GetErrorOffset() == offset && ex.GetErrorKind() == kind;
+    }
+    return false;
+}
+
+
+void TestErrorDetails()
+{
+    using UnicodeConvAtlStd::ConversionErrorKind;
+
+    // Past the first blocks of the vectorized kernels, too
+    for (const std::string& prefix : { std::string("ab"), std::string(100, 'x') })
+    {
+        const size_t offset = prefix.length();
+        Check(Utf8ErrorIs(prefix + "\xE5\xAD", offset, ConversionErrorKind::TruncatedSequence)
+              && Utf8ErrorIs(prefix + "\xF0\x9F\x98" + prefix, offset, ConversionErrorKind::TruncatedSequence),
+              "Report truncated UTF-8 sequence and its offset");
+        Check(Utf8ErrorIs(prefix + "\xC1\xBF", offset, ConversionErrorKind::OverlongEncoding)
+              && Utf8ErrorIs(prefix + "\xE0\x9F\xBF", offset, ConversionErrorKind::OverlongEncoding)
+              && Utf8ErrorIs(prefix + "\xF0\x8F\xBF\xBF", offset, ConversionErrorKind::OverlongEncoding),
+              "Report overlong UTF-8 encoding and its offset");
+        Check(Utf8ErrorIs(prefix + "\xED\xB0\x80", offset, ConversionErrorKind::SurrogateInUtf8),
+              "Report encoded surrogate and its offset");
+        Check(Utf8ErrorIs(prefix + "\xF4\x90\x80\x80", offset, ConversionErrorKind::CodePointTooLarge)
+              && Utf8ErrorIs(prefix + "\xF5\x80\x80\x80", offset, ConversionErrorKind::CodePointTooLarge),
+              "Report code point beyond U+10FFFF and its offset");
+        Check(Utf8ErrorIs(prefix + "\x80", offset, ConversionErrorKind::InvalidByte)
+              && Utf8ErrorIs(prefix + "\xFF" + prefix, offset, ConversionErrorKind::InvalidByte),
+              "Report invalid UTF-8 byte and its offset");
+
+        const std::u16string prefix16(prefix.begin(), prefix.end());
+        Check(Utf16ErrorIs(prefix16 + u"\xD83D", offset, ConversionErrorKind::LoneHighSurrogate)
+              && Utf16ErrorIs(prefix16 + u"\xD83Dx", offset, ConversionErrorKind::LoneHighSurrogate),
+              "Report lone high surrogate and its offset");
+        Check(Utf16ErrorIs(prefix16 + u"\xDE00" + prefix16, offset, ConversionErrorKind::LoneLowSurrogate),
+              "Report lone low surrogate and its offset");
+    }
+}
+
+
+void TestErrorPolicy()
+{
+    using UnicodeConvAtlStd::ErrorPolicy;
+    using UnicodeConvAtlStd::Utf16ToUtf8;
+    using UnicodeConvAtlStd::Utf8ToUtf16;
+
+    // Long enough prefixes take the vectorized paths before and after the errors
+    for (const std::string& prefix : { std::string(), std::string(100, 'x') })
+    {
+        const std::u16string prefix16(prefix.begin(), prefix.end());
+        size_t count = 0;
+
+        // The example from the Unicode Standard, "U+FFFD Substitution of Maximal Subparts"
+        Check(Utf8ToUtf16(prefix + "\x61\xF1\x80\x80\xE1\x80\xC2\x62\x80\x63\x80\xBF\x64" + prefix,
+                          ErrorPolicy::Replace, &count)
+                  == prefix16 + u"a\xFFFD\xFFFD\xFFFD" u"b\xFFFD" u"c\xFFFD\xFFFD" u"d" + prefix16
+              && count == 6,
+              "Replace each maximal subpart of invalid UTF-8 with U+FFFD");
+        Check(Utf8ToUtf16(prefix + "\xED\xA0\x80" + prefix, ErrorPolicy::Replace, &count)
+                  == prefix16 + u"\xFFFD\xFFFD\xFFFD" + prefix16 && count == 3
+              && Utf8ToUtf16(prefix + "\xF4\x90\x80\x80", ErrorPolicy::Replace, &count)
+                  == prefix16 + u"\xFFFD\xFFFD\xFFFD\xFFFD" && count == 4
+              && Utf8ToUtf16(prefix + "\xF0\x9F\x98", ErrorPolicy::Replace, &count)
+                  == prefix16 + u"\xFFFD" && count == 1,
+              "Replace encoded surrogates, too large and truncated UTF-8 sequences");
+        Check(Utf16ToUtf8(prefix16 + u"\xD83D" u"a\xDE00" + prefix16 + u"\xD83D", ErrorPolicy::Replace, &count)
+                  == prefix + "\xEF\xBF\xBD" "a\xEF\xBF\xBD" + prefix + "\xEF\xBF\xBD" && count == 3,
+              "Replace lone surrogates in UTF-16 with U+FFFD");
+        Check(Utf8ToUtf16(prefix + "\xE5\xAD\x97", ErrorPolicy::Replace, &count) == prefix16 + u"\x5B57"
+                  && count == 0
+              && Utf16ToUtf8(prefix16 + u"\x5B57", ErrorPolicy::Replace, &count) == prefix + "\xE5\xAD\x97"
+                  && count == 0,
+              "Convert valid input with no replacements");
+    }
+
+    Check(Utf8ToUtf16Throws("\x80") && Utf8ToUtf16("\x80", ErrorPolicy::Replace) == u"\xFFFD",
+          "Throw on invalid input only with the strict policy");
+}
+
+
+void TestOtherStringTypes()
+{
+    using UnicodeConvAtlStd::Utf16ToUtf8;
+    using UnicodeConvAtlStd::Utf8ToUtf16;
+
+    const std::u16string utf16 = u"Japanese kanji \x5B66 \xD83D\xDE00";
+    const std::string utf8 = "Japanese kanji \xE5\xAD\xA6 \xF0\x9F\x98\x80";
+
+    const std::vector<char16_t> utf16Vector(utf16.begin(), utf16.end());
+    const std::vector<char> utf8Vector(utf8.begin(), utf8.end());
+    const std::array<char16_t, 3> utf16Array = { u'a', u'\x5B66', u'b' };
+    Check(Utf16ToUtf8(utf16Vector) == utf8 && Utf8ToUtf16(utf8Vector) == utf16
+          && Utf16ToUtf8(utf16Array) == "a\xE5\xAD\xA6" "b",
+          "Convert from contiguous containers of code units");
+
+    Check(Utf8ToUtf16Throws(std::string_view("\xC0\x80"))
+          && Utf16ToUtf8Throws(std::u16string_view(u"\xDE00"))
+          && Utf16ToUtf8(std::u16string_view(u"\x5B66")) == "\xE5\xAD\xA6",
+          "Convert from views of code units");
+
+    bool vectorThrows = false;
+    try
+    {
+        (void)Utf16ToUtf8(std::vector<char16_t>{ u'a', u'\xD800' });
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        vectorThrows = ex.GetErrorOffset() == 1;
+    }
+    Check(vectorThrows, "Report invalid input in containers of code units");
+
+#if defined(__cpp_char8_t)
+    const std::u8string utf8u8(utf8.begin(), utf8.end());
+    Check(Utf16ToUtf8<std::u8string>(utf16) == utf8u8 && Utf8ToUtf16(utf8u8) == utf16
+          && Utf8ToUtf16(std::u8string_view(u8"\u5B66")) == u"\x5B66",
+          "Convert to and from char8_t UTF-8 strings");
+#endif
+#if defined(__cpp_lib_span)
+    Check(Utf16ToUtf8(std::span<const char16_t>(utf16Vector)) == utf8
+          && Utf8ToUtf16(std::span<const char>(utf8Vector).first(8)) == u"Japanese",
+          "Convert from spans of code units");
+#endif
+}
+
+
+void TestSlicesOfLargerBuffers()
+{
+    using UnicodeConvAtlStd::Utf16ToUtf8;
+    using UnicodeConvAtlStd::Utf8ToUtf16;
+
+    // Only the slice between the invalid bytes is converted
+    const std::string buffer = "\xFF" "kanji \xE5\xAD\xA6" "\xFF";
+    const std::u16string buffer16 = u"\xD800" u"kanji \x5B66" u"\xD800";
+    Check(Utf8ToUtf16(buffer.data() + 1, buffer.length() - 2) == u"kanji \x5B66"
+          && Utf8ToUtf16(std::string_view(buffer).substr(1, buffer.length() - 2)) == u"kanji \x5B66"
+          && Utf16ToUtf8(buffer16.data() + 1, buffer16.length() - 2) == "kanji \xE5\xAD\xA6"
+          && Utf16ToUtf8(std::u16string_view(buffer16).substr(1, buffer16.length() - 2)) == "kanji \xE5\xAD\xA6",
+          "Convert slices of larger buffers");
+
+    // Errors are reported at offsets into the slice
+    bool sliceOffset = false;
+    try
+    {
+        (void)Utf8ToUtf16(buffer.data() + 1, buffer.length() - 1);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        sliceOffset = ex.GetErrorOffset() == buffer.length() - 2;
+    }
+    Check(sliceOffset && Utf8ToUtf16(buffer.data(), 0).empty() && Utf16ToUtf8(nullptr, 0).empty(),
+          "Report errors at offsets into the slice");
+}
+
+
+void TestAllocators()
+{
+    using UnicodeConvAtlStd::Utf16ToUtf8;
+    using UnicodeConvAtlStd::Utf8ToUtf16;
+
+    // Long enough not to fit the small string buffer
+    const std::u16string utf16 = u"Japanese kanji \x5B66 \xD83D\xDE00, and some more text to allocate";
+    const std::string utf8 = Utf16ToUtf8(utf16);
+
+    size_t allocationCount = 0;
+    const auto utf8Counted = Utf16ToUtf8(utf16, CountingAllocator<char>(&allocationCount));
+    const auto utf16Counted = Utf8ToUtf16(utf8, CountingAllocator<char16_t>(&allocationCount));
+    Check(std::string_view(utf8Counted) == utf8 && std::u16string_view(utf16Counted) == utf16
+          && allocationCount >= 2,
+          "Allocate conversions from the given allocator");
+
+#if defined(__cpp_lib_memory_resource)
+    // Every allocation must come from the buffer: the upstream resource throws
+    char buffer[1024];
+    std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+    const std::pmr::string utf8Pmr = Utf16ToUtf8(utf16, &resource);
+    const std::pmr::u16string utf16Pmr = Utf8ToUtf16(utf8, &resource);
+    Check(std::string_view(utf8Pmr) == utf8 && std::u16string_view(utf16Pmr) == utf16
+          && utf8Pmr.get_allocator().resource() == &resource,
+          "Allocate conversions from the given memory resource");
+
+    bool thrown = false;
+    try
+    {
+        (void)Utf8ToUtf16(std::string_view("\xC0\x80"), &resource);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException&)
+    {
+        thrown = true;
+    }
+    Check(thrown, "Allocator-aware conversions throw on invalid input");
+#endif
+}
+
+
+void TestBatchConversions()
+{
+    const std::u16string_view utf16[] = { u"name", u"", u"\x5B66\x751F", u"\xD83D\xDE00 ok" };
+    const std::string_view utf8[] = { "name", "", "\xE5\xAD\xA6\xE7\x94\x9F", "\xF0\x9F\x98\x80 ok" };
+
+    const UnicodeConvAtlStd::Utf8Batch utf8Batch = UnicodeConvAtlStd::Utf16ToUtf8Batch(utf16, 4);
+    const UnicodeConvAtlStd::Utf16Batch utf16Batch = UnicodeConvAtlStd::Utf8ToUtf16Batch(utf8, 4);
+
+    bool sameStrings = utf8Batch.size() == 4 && utf16Batch.size() == 4;
+    for (size_t i = 0; sameStrings && i < 4; i++)
+    {
+        sameStrings = utf8Batch[i] == utf8[i] && utf16Batch[i] == utf16[i];
+    }
+    Check(sameStrings && utf8Batch.data == "name\xE5\xAD\xA6\xE7\x94\x9F\xF0\x9F\x98\x80 ok"
+          && utf8Batch.offsets == std::vector<size_t>{ 0, 4, 4, 10, 17 },
+          "Convert batches of strings into one string plus offsets");
+
+    const UnicodeConvAtlStd::Utf8Batch emptyBatch = UnicodeConvAtlStd::Utf16ToUtf8Batch(nullptr, 0);
+    Check(emptyBatch.size() == 0 && emptyBatch.data.empty() && emptyBatch.offsets.size() == 1,
+          "Convert empty batches");
+
+    // Each string is a separate piece of text: a surrogate pair can't span two strings
+    const std::u16string_view splitPair[] = { u"ab", u"c\xD83D", u"\xDE00" };
+    bool thrown = false;
+    try
+    {
+        (void)UnicodeConvAtlStd::Utf16ToUtf8Batch(splitPair, 3);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = ex.GetErrorOffset() == 3
+            && ex.GetErrorKind() == UnicodeConvAtlStd::ConversionErrorKind::LoneHighSurrogate;
+    }
+    Check(thrown, "Report invalid strings at their offset in the batch");
+
+#if defined(__cpp_lib_span)
+    const std::vector<std::string_view> column(1000, "\xE5\xAD\xA6 key");
+    const UnicodeConvAtlStd::Utf16Batch columnBatch = UnicodeConvAtlStd::Utf8ToUtf16Batch(column);
+    Check(columnBatch.size() == 1000 && columnBatch[999] == u"\x5B66 key" && columnBatch.data.length() == 5000,
+          "Convert batches from spans");
+#endif
+}
+
+
+// Return true if the parallel conversion of the given UTF-8 input fails
+// at the same offset, with the same kind of error, as the serial one
+bool SameErrorAsSerialUtf8ToUtf16(std::string_view utf8, size_t chunkLength)
+{
+    const auto expected = UnicodeConvAtlStd::TryUtf8ToUtf16(utf8);
+    try
+    {
+        (void)UnicodeConvAtlStd::Utf8ToUtf16Parallel(utf8, UnicodeConvAtlStd::ThreadExecutor(4), chunkLength);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        return !expected && ex.GetErrorOffset() == expected.error().offset
+            && ex.GetErrorKind() == expected.error().kind;
+    }
+    return false;
+}
+
+
+// Return true if the parallel conversion of the given UTF-16 input fails
+// at the same offset, with the same kind of error, as the serial one
+bool SameErrorAsSerialUtf16ToUtf8(std::u16string_view utf16, size_t chunkLength)
+{
+    const auto expected = UnicodeConvAtlStd::TryUtf16ToUtf8(utf16);
+    try
+    {
+        (void)UnicodeConvAtlStd::Utf16ToUtf8Parallel(utf16, UnicodeConvAtlStd::ThreadExecutor(4), chunkLength);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        return !expected && ex.GetErrorOffset() == expected.error().offset
+            && ex.GetErrorKind() == expected.error().kind;
+    }
+    return false;
+}
+
+
+void TestParallelConversions()
+{
+    using UnicodeConvAtlStd::ThreadExecutor;
+
+    std::mt19937 random(2023);
+    bool utf8Match = true;
+    bool utf16Match = true;
+    bool utf8ErrorMatch = true;
+    bool utf16ErrorMatch = true;
+
+    // Small chunks, to split many sequences and surrogate pairs
+    for (int i = 0; i < 200; i++)
+    {
+        const size_t length = std::uniform_int_distribution<size_t>(0, 2000)(random);
+        const size_t chunkLength = std::uniform_int_distribution<size_t>(1, 100)(random);
+        const int* classRange = kRandomClassRanges[i % 4];
+        std::u16string utf16 = MakeRandomUtf16(random, length, classRange[0], classRange[1]);
+        std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+
+        utf8Match = utf8Match
+            && UnicodeConvAtlStd::Utf16ToUtf8Parallel(utf16, ThreadExecutor(4), chunkLength) == utf8;
+        utf16Match = utf16Match
+            && UnicodeConvAtlStd::Utf8ToUtf16Parallel(utf8, ThreadExecutor(4), chunkLength) == utf16;
+
+        // Corrupt a random code unit
+        if (!utf16.empty())
+        {
+            const size_t position = std::uniform_int_distribution<size_t>(0, utf16.length() - 1)(random);
+            utf16[position] = static_cast<char16_t>(std::uniform_int_distribution<int>(0xD800, 0xDFFF)(random));
+            utf16ErrorMatch = utf16ErrorMatch
+                && (UnicodeConvAtlStd::TryUtf16ToUtf8(utf16) || SameErrorAsSerialUtf16ToUtf8(utf16, chunkLength));
+        }
+        if (!utf8.empty())
+        {
+            const size_t position = std::uniform_int_distribution<size_t>(0, utf8.length() - 1)(random);
+            utf8[position] = static_cast<char>(std::uniform_int_distribution<int>(0x80, 0xFF)(random));
+            utf8ErrorMatch = utf8ErrorMatch
+                && (UnicodeConvAtlStd::TryUtf8ToUtf16(utf8) || SameErrorAsSerialUtf8ToUtf16(utf8, chunkLength));
+        }
+    }
+    Check(utf8Match, "Parallel UTF-16 to UTF-8 matches the serial conversion");
+    Check(utf16Match, "Parallel UTF-8 to UTF-16 matches the serial conversion");
+    Check(utf16ErrorMatch, "Parallel UTF-16 to UTF-8 reports the first error of the input");
+    Check(utf8ErrorMatch, "Parallel UTF-8 to UTF-16 reports the first error of the input");
+
+    // Any executor can run the tasks, e.g. a serial one
+    size_t taskCount = 0;
+    const auto serialExecutor = [&taskCount](size_t count, const auto& task)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            task(i);
+        }
+        taskCount += count;
+    };
+    const std::string kanji = UnicodeConvAtlStd::Utf16ToUtf8(std::u16string(1000, u'\x5B66'));
+    const std::u16string kanjiUtf16 = UnicodeConvAtlStd::Utf8ToUtf16Parallel(kanji, serialExecutor, 300);
+    Check(kanjiUtf16 == std::u16string(1000, u'\x5B66') && taskCount == 2 * 10,
+          "Run the parallel conversion on a custom executor");
+
+    // Inputs not longer than a chunk are converted on the calling thread
+    taskCount = 0;
+    Check(UnicodeConvAtlStd::Utf16ToUtf8Parallel(u"abc", serialExecutor) == "abc" && taskCount == 0,
+          "Convert short inputs without the executor");
+
+    // Exceptions of the executor, while measuring or converting,
+    // are thrown to the caller
+    bool executorErrorsThrown = true;
+    for (size_t failingCall = 1; failingCall <= 2; failingCall++)
+    {
+        size_t callCount = 0;
+        const auto failingExecutor = [&](size_t count, const auto& task)
+        {
+            if (++callCount == failingCall)
+            {
+                throw std::runtime_error("No thread available");
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                task(i);
+            }
+        };
+
+        bool thrown = false;
+        try
+        {
+            (void)UnicodeConvAtlStd::Utf8ToUtf16Parallel(kanji, failingExecutor, 300);
+        }
+        catch (const std::runtime_error&)
+        {
+            thrown = true;
+        }
+        executorErrorsThrown = executorErrorsThrown && thrown && callCount == failingCall;
+    }
+    Check(executorErrorsThrown, "Throw the exceptions of the executor");
+}
+
+
+// Return the bytes of UTF-16 text, little-endian or big-endian
+std::string Utf16Bytes(std::u16string_view utf16, bool bigEndian)
+{
+    std::string bytes;
+    for (const char16_t unit : utf16)
+    {
+        const char low = static_cast<char>(unit & 0xFF);
+        const char high = static_cast<char>(unit >> 8);
+        bytes += bigEndian ? high : low;
+        bytes += bigEndian ? low : high;
+    }
+    return bytes;
+}
+
+
+void WriteFileBytes(const std::filesystem::path& path, const std::string& bytes)
+{
+    std::ofstream(path, std::ios::binary) << bytes;
+}
+
+
+std::string ReadFileBytes(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+
+void TestFileTranscoding()
+{
+    using UnicodeConvAtlStd::FileEncoding;
+
+    const std::filesystem::path source = std::filesystem::temp_directory_path() / "TestUnicodeConvCore.source.txt";
+    const std::filesystem::path target = std::filesystem::temp_directory_path() / "TestUnicodeConvCore.target.txt";
+
+    // Text spanning several mapped views, with code points split between them
+    std::mt19937 random(2023);
+    const std::u16string utf16 = MakeRandomUtf16(random, 1500000);
+    const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+
+    UnicodeConvAtlStd::FileTranscodeOptions options;
+    options.mappingLength = 2 << 20;
+    options.bufferLength = 64 << 10;
+
+    WriteFileBytes(source, "\xFF\xFE" + Utf16Bytes(utf16, false));
+    UnicodeConvAtlStd::FileTranscodeResult result = UnicodeConvAtlStd::TranscodeFile(source, target, options);
+    Check(ReadFileBytes(target) == utf8 && result.sourceEncoding == FileEncoding::Utf16LE && result.sourceHasBom
+          && result.bytesRead == 2 + 2 * utf16.length() && result.bytesWritten == utf8.length(),
+          "Transcode a UTF-16LE file with a BOM to UTF-8");
+
+    // The BOM overrides the encoding in the options
+    options.sourceEncoding = FileEncoding::Utf8;
+    WriteFileBytes(source, "\xFE\xFF" + Utf16Bytes(utf16, true));
+    result = UnicodeConvAtlStd::TranscodeFile(source, target, options);
+    Check(ReadFileBytes(target) == utf8 && result.sourceEncoding == FileEncoding::Utf16BE,
+          "Transcode a UTF-16BE file with a BOM to UTF-8");
+
+    options.targetEncoding = FileEncoding::Utf16BE;
+    options.writeBom = true;
+    WriteFileBytes(source, utf8);
+    result = UnicodeConvAtlStd::TranscodeFile(source, target, options);
+    Check(ReadFileBytes(target) == "\xFE\xFF" + Utf16Bytes(utf16, true) && !result.sourceHasBom,
+          "Transcode a UTF-8 file without a BOM to UTF-16BE with a BOM");
+
+    // Invalid text is reported at its offset in the source text
+    std::string invalidUtf8 = utf8;
+    invalidUtf8[1234567] = '\xFF';
+    const auto expected = UnicodeConvAtlStd::TryUtf8ToUtf16(invalidUtf8);
+    WriteFileBytes(source, invalidUtf8);
+    bool thrown = false;
+    try
+    {
+        (void)UnicodeConvAtlStd::TranscodeFile(source, target, options);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = !expected && ex.GetErrorOffset() == expected.error().offset
+            && ex.GetErrorKind() == expected.error().kind;
+    }
+    Check(thrown, "Report invalid text in files");
+
+    // The conversion type is the one of the files, e.g. UTF-16 to UTF-16
+    using ConversionType = UnicodeConvAtlStd::UnicodeConversionException::ConversionType;
+    options.targetEncoding = FileEncoding::Utf16BE;
+    WriteFileBytes(source, "\xFF\xFE" + Utf16Bytes(u"abc\xDC00", false));
+    thrown = false;
+    try
+    {
+        (void)UnicodeConvAtlStd::TranscodeFile(source, target, options);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = ex.GetConversionType() == ConversionType::FromUtf16ToUtf16
+            && ex.GetErrorOffset() == 3
+            && ex.GetErrorKind() == UnicodeConvAtlStd::ConversionErrorKind::LoneLowSurrogate
+            && std::string_view(ex.what()).find("from UTF-16 to UTF-16") != std::string_view::npos;
+    }
+    Check(thrown, "Report invalid text with the encodings of the files");
+
+    // A UTF-16 file with an odd length ends with a truncated code unit,
+    // found before creating the target
+    options.targetEncoding = FileEncoding::Utf8;
+    WriteFileBytes(source, "\xFF\xFE" + Utf16Bytes(u"abc", false) + "d");
+    std::filesystem::remove(target);
+    thrown = false;
+    try
+    {
+        (void)UnicodeConvAtlStd::TranscodeFile(source, target, options);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = ex.GetConversionType() == ConversionType::FromUtf16ToUtf8
+            && ex.GetErrorOffset() == 3
+            && ex.GetErrorKind() == UnicodeConvAtlStd::ConversionErrorKind::TruncatedSequence;
+    }
+    Check(thrown && !std::filesystem::exists(target), "Report a UTF-16 file with an odd length");
+
+    // On errors, an existing target is left as it was,
+    // and the temporary file written next to it is removed
+    WriteFileBytes(target, "Previous target");
+    WriteFileBytes(source, invalidUtf8);
+    thrown = false;
+    try
+    {
+        (void)UnicodeConvAtlStd::TranscodeFile(source, target, options);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException&)
+    {
+        thrown = true;
+    }
+    bool isTemporaryFileLeft = false;
+    for (const auto& entry : std::filesystem::directory_iterator(target.parent_path()))
+    {
+        const std::string name = entry.path().filename().string();
+        isTemporaryFileLeft = isTemporaryFileLeft || name.rfind(target.filename().string() + ".", 0) == 0;
+    }
+    Check(thrown && ReadFileBytes(target) == "Previous target" && !isTemporaryFileLeft,
+          "Leave the target as it was on errors");
+
+    // A file can't be transcoded onto itself
+    WriteFileBytes(source, utf8);
+    thrown = false;
+    try
+    {
+        (void)UnicodeConvAtlStd::TranscodeFile(source, source, options);
+    }
+    catch (const std::system_error&)
+    {
+        thrown = true;
+    }
+    Check(thrown && ReadFileBytes(source) == utf8, "Refuse to transcode a file onto itself");
+
+    thrown = false;
+    try
+    {
+        (void)UnicodeConvAtlStd::TranscodeFile(source.string() + ".missing", target, options);
+    }
+    catch (const std::system_error&)
+    {
+        thrown = true;
+    }
+    Check(thrown, "Report missing source files");
+
+    std::filesystem::remove(source);
+    std::filesystem::remove(target);
+}
+
+
+// Converted at compile time
+constexpr auto kUtf8Literal = UNICODECONVATLSTD_UTF8_LITERAL(u"Kanji: \x5B66\x751F, \xD83D\xDE00");
+constexpr auto kUtf16Literal = UNICODECONVATLSTD_UTF16_LITERAL("Kanji: \xE5\xAD\xA6\xE7\x94\x9F, \xF0\x9F\x98\x80");
+
+static_assert(std::string_view(kUtf8Literal.data(), kUtf8Literal.size())
+              == "Kanji: \xE5\xAD\xA6\xE7\x94\x9F, \xF0\x9F\x98\x80");
+static_assert(std::u16string_view(kUtf16Literal.data(), kUtf16Literal.size())
+              == u"Kanji: \x5B66\x751F, \xD83D\xDE00");
+static_assert(UNICODECONVATLSTD_UTF8_LITERAL(u"").empty());
+
+// (Invalid literals, e.g. UNICODECONVATLSTD_UTF8_LITERAL(u"\xD800"), don't compile)
+
+
+void TestCompileTimeLiterals()
+{
+    const std::u16string utf16 = u"Kanji: \x5B66\x751F, \xD83D\xDE00";
+    Check(std::string_view(kUtf8Literal.data(), kUtf8Literal.size()) == UnicodeConvAtlStd::Utf16ToUtf8(utf16)
+          && std::u16string_view(kUtf16Literal.data(), kUtf16Literal.size()) == utf16,
+          "Convert literals at compile time");
+
+#if defined(__cpp_consteval) && defined(__cpp_nontype_template_args) && (__cpp_nontype_template_args >= 201911L)
+    using namespace UnicodeConvAtlStd::Literals;
+
+    constexpr auto utf8 = u"\x00E9t\x00E9"_utf8;
+    constexpr auto utf16FromU8 = u8"\u00E9t\u00E9"_utf16;
+    Check(std::string_view(utf8.data(), utf8.size()) == "\xC3\xA9t\xC3\xA9"
+          && std::u16string_view(utf16FromU8.data(), utf16FromU8.size()) == u"\x00E9t\x00E9",
+          "Convert literals with the _utf8 and _utf16 literal operators");
+#endif
+
+    // At run time, invalid text throws
+    char16_t invalid[] = u"ab\xDC00";
+    bool thrown = false;
+    try
+    {
+        (void)UnicodeConvAtlStd::Utf8LengthOfLiteral(invalid);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorOffset() == 2
+                  && ex.GetErrorKind() == UnicodeConvAtlStd::ConversionErrorKind::LoneLowSurrogate);
+    }
+    Check(thrown, "Literal conversions of invalid text throw at run time");
+}
+
+
+void TestEngineMatchesScalarUtf8ToUtf16()
+{
+    std::mt19937 random(2023);
+    bool validMatch = true;
+    bool invalidMatch = true;
+
+    for (int i = 0; i < 4000; i++)
+    {
+        const size_t length = std::uniform_int_distribution<size_t>(0, 200)(random);
+        const int* classRange = kRandomClassRanges[(i / 4) % 4];
+        std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(
+            MakeRandomUtf16(random, length, classRange[0], classRange[1]));
+
+        // Long ASCII runs, to exercise the widest blocks
+        if (i % 4 == 0)
+        {
+            utf8.insert(utf8.length() / 2, std::string(70, 'x'));
+        }
+        validMatch = validMatch && SameAsScalarUtf8ToUtf16(utf8);
+
+        // Corrupt a random char
+        if (!utf8.empty())
+        {
+            const size_t position = std::uniform_int_distribution<size_t>(0, utf8.length() - 1)(random);
+            utf8[position] = static_cast<char>(std::uniform_int_distribution<int>(0x80, 0xFF)(random));
+            invalidMatch = invalidMatch && SameAsScalarUtf8ToUtf16(utf8);
+        }
+    }
+
+    // Encoded surrogates and overlong forms inside runs of 3-char sequences
+    const std::string run = UnicodeConvAtlStd::Utf16ToUtf8(std::u16string(40, u'\x5B66'));
+    for (const char* bad : { "\xED\xA0\x80", "\xE0\x9F\xBF", "\xC1\xBF\x41" })
+    {
+        for (size_t position = 0; position + 3 <= run.length(); position += 3)
+        {
+            std::string utf8 = run;
+            utf8.replace(position, 3, bad);
+            invalidMatch = invalidMatch && SameAsScalarUtf8ToUtf16(utf8);
+        }
+    }
+
+    Check(validMatch, "Engine matches scalar reference on valid UTF-8");
+    Check(invalidMatch, "Engine matches scalar reference on invalid UTF-8");
+}
+
+
+void TestEngineMatchesScalarUtf16ToUtf8()
+{
+    std::mt19937 random(2023);
+    bool validMatch = true;
+    bool invalidMatch = true;
+
+    for (int i = 0; i < 4000; i++)
+    {
+        const size_t length = std::uniform_int_distribution<size_t>(0, 200)(random);
+        const int* classRange = kRandomClassRanges[(i / 4) % 4];
+        std::u16string utf16 = MakeRandomUtf16(random, length, classRange[0], classRange[1]);
+
+        // Long ASCII and BMP runs, to exercise the widest blocks
+        if (i % 4 == 0)
+        {
+            utf16.insert(utf16.length() / 2, std::u16string(70, u'x'));
+        }
+        else if (i % 4 == 1)
+        {
+            utf16.insert(utf16.length() / 2, MakeRandomUtf16(random, 70, 0, 8));
+        }
+        validMatch = validMatch && SameAsScalarUtf16ToUtf8(utf16);
+
+        // Replace a random code unit with a surrogate, likely unpaired
+        if (!utf16.empty())
+        {
+            const size_t position = std::uniform_int_distribution<size_t>(0, utf16.length() - 1)(random);
+            utf16[position] = static_cast<char16_t>(std::uniform_int_distribution<int>(0xD800, 0xDFFF)(random));
+            invalidMatch = invalidMatch && SameAsScalarUtf16ToUtf8(utf16);
+        }
+    }
+
+    Check(validMatch, "Engine matches scalar reference on valid UTF-16");
+    Check(invalidMatch, "Engine matches scalar reference on invalid UTF-16");
+}
+
+
+void TestAsciiPrefixes()
+{
+    // ASCII strings of every length around the word and short string sizes,
+    // with a non-ASCII code point (2 or 3 UTF-8 chars) at every position
+    bool match = true;
+    for (size_t length = 0; length <= 80; length++)
+    {
+        const std::u16string ascii(length, u'a');
+        match = match
+            && UnicodeConvAtlStd::Utf16ToUtf8(ascii) == std::string(length, 'a')
+            && UnicodeConvAtlStd::Utf8ToUtf16(std::string(length, 'a')) == ascii;
+
+        for (size_t position = 0; position < length; position++)
+        {
+            for (char16_t nonAscii : { u'\x00E9', u'\x5B66' })
+            {
+                std::u16string utf16 = ascii;
+                utf16[position] = nonAscii;
+                match = match
+                    && SameAsScalarUtf16ToUtf8(utf16)
+                    && UnicodeConvAtlStd::Utf8ToUtf16(UnicodeConvAtlStd::Utf16ToUtf8(utf16)) == utf16;
+            }
+        }
+    }
+
+    Check(match, "Leading ASCII code units of every length");
+}
+
+
+// Convert UTF-16 to UTF-8 through caller-provided buffers of the given capacity,
+// resuming after each TargetTooSmall; check that nothing is written past
+// the capacity
+bool ConvertUtf16ToUtf8InPieces(std::u16string_view utf16, size_t capacity, std::string& utf8)
+{
+    constexpr char kGuard = '\x5A';
+
+    utf8.clear();
+    std::string buffer(capacity + 16, kGuard);
+    for (;;)
+    {
+        const UnicodeConvAtlStd::ConversionResult result =
+            UnicodeConvAtlStd::ConvertUtf16ToUtf8(utf16, buffer.data(), capacity);
+        if (result.unitsWritten > capacity
+            || buffer.find_first_not_of(kGuard, capacity) != std::string::npos)
+        {
+            return false;
+        }
+
+        utf8.append(buffer, 0, result.unitsWritten);
+        utf16.remove_prefix(result.unitsRead);
+
+        if (result.status != UnicodeConvAtlStd::ConversionStatus::TargetTooSmall)
+        {
+            return result.status == UnicodeConvAtlStd::ConversionStatus::Ok && utf16.empty();
+        }
+    }
+}
+
+
+// Same as above, from UTF-8 to UTF-16
+bool ConvertUtf8ToUtf16InPieces(std::string_view utf8, size_t capacity, std::u16string& utf16)
+{
+    constexpr char16_t kGuard = u'\x5A5A';
+
+    utf16.clear();
+    std::u16string buffer(capacity + 16, kGuard);
+    for (;;)
+    {
+        const UnicodeConvAtlStd::ConversionResult result =
+            UnicodeConvAtlStd::ConvertUtf8ToUtf16(utf8, buffer.data(), capacity);
+        if (result.unitsWritten > capacity
+            || buffer.find_first_not_of(kGuard, capacity) != std::u16string::npos)
+        {
+            return false;
+        }
+
+        utf16.append(buffer, 0, result.unitsWritten);
+        utf8.remove_prefix(result.unitsRead);
+
+        if (result.status != UnicodeConvAtlStd::ConversionStatus::TargetTooSmall)
+        {
+            return result.status == UnicodeConvAtlStd::ConversionStatus::Ok && utf8.empty();
+        }
+    }
+}
+
+
+void TestCallerProvidedBuffers()
+{
+    using UnicodeConvAtlStd::ConversionStatus;
+
+    std::mt19937 random(2023);
+    bool utf16ToUtf8Match = true;
+    bool utf8ToUtf16Match = true;
+
+    for (int i = 0; i < 400; i++)
+    {
+        const size_t length = std::uniform_int_distribution<size_t>(0, 300)(random);
+        const std::u16string utf16 = MakeRandomUtf16(random, length);
+        const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+
+        // Buffers from too small for a single code point to large enough for all
+        for (size_t capacity : { size_t{ 4 }, size_t{ 5 }, size_t{ 37 }, utf8.length(), utf16.length() * 3 + 1 })
+        {
+            std::string pieces8;
+            utf16ToUtf8Match = utf16ToUtf8Match
+                && ConvertUtf16ToUtf8InPieces(utf16, capacity, pieces8)
+                && pieces8 == utf8;
+
+            std::u16string pieces16;
+            utf8ToUtf16Match = utf8ToUtf16Match
+                && ConvertUtf8ToUtf16InPieces(utf8, (capacity + 1) / 2, pieces16)
+                && pieces16 == utf16;
+        }
+    }
+
+    Check(utf16ToUtf8Match, "UTF-16 to UTF-8 into caller-provided buffers");
+    Check(utf8ToUtf16Match, "UTF-8 to UTF-16 into caller-provided buffers");
+
+    // A code point that doesn't fit isn't split
+    char utf8Buffer[3];
+    const auto tooSmall8 = UnicodeConvAtlStd::ConvertUtf16ToUtf8(u"ab\xD83D\xDE00", utf8Buffer, 3);
+    char16_t utf16Buffer[2];
+    const auto tooSmall16 = UnicodeConvAtlStd::ConvertUtf8ToUtf16("a\xF0\x9F\x98\x80", utf16Buffer, 2);
+    Check(tooSmall8.status == ConversionStatus::TargetTooSmall
+          && tooSmall8.unitsRead == 2 && tooSmall8.unitsWritten == 2
+          && tooSmall16.status == ConversionStatus::TargetTooSmall
+          && tooSmall16.unitsRead == 1 && tooSmall16.unitsWritten == 1,
+          "Code points that don't fit in caller-provided buffers");
+
+    // Invalid input is reported at its offset, even with room left
+    char largeUtf8Buffer[64];
+    const auto invalid16 = UnicodeConvAtlStd::ConvertUtf16ToUtf8(u"abc\xDC00xyz", largeUtf8Buffer, 64);
+    char16_t largeUtf16Buffer[64];
+    const auto invalid8 = UnicodeConvAtlStd::ConvertUtf8ToUtf16("abc\xC0\xAFxyz", largeUtf16Buffer, 64);
+    Check(invalid16.status == ConversionStatus::InvalidInput && invalid16.unitsRead == 3
+          && invalid8.status == ConversionStatus::InvalidInput && invalid8.unitsRead == 3,
+          "Invalid input into caller-provided buffers");
+
+#if defined(__cpp_lib_span)
+    char spanBuffer[16];
+    const auto spanResult = UnicodeConvAtlStd::ConvertUtf16ToUtf8(u"Kanji \x5B66", std::span<char>(spanBuffer));
+    Check(spanResult.status == ConversionStatus::Ok
+          && std::string_view(spanBuffer, spanResult.unitsWritten) == "Kanji \xE5\xAD\xA6",
+          "Conversion into std::span");
+#endif
+}
+
+
+void TestValidation()
+{
+    using UnicodeConvAtlStd::FindInvalidUtf16;
+    using UnicodeConvAtlStd::FindInvalidUtf8;
+
+    // Long enough for the vectorized kernels, with the error past the first blocks
+    const std::string text(100, 'x');
+    const std::u16string text16(100, u'x');
+
+    Check(UnicodeConvAtlStd::IsValidUtf8("") && UnicodeConvAtlStd::IsValidUtf16(u""), "Validate empty strings");
+    Check(UnicodeConvAtlStd::IsValidUtf8(text + "A\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80" + text),
+          "Validate UTF-8 of 1 to 4 chars");
+    Check(UnicodeConvAtlStd::IsValidUtf16(text16 + u"A\x00E9\x20AC\xD83D\xDE00" + text16),
+          "Validate UTF-16 surrogate pair");
+
+    Check(FindInvalidUtf8(text + "\xC0\xAF" + text) == 100, "Find overlong UTF-8 encoding");
+    Check(FindInvalidUtf8(text + "\xED\xA0\x80" + text) == 100, "Find encoded surrogate");
+    Check(FindInvalidUtf8(text + "\xF4\x90\x80\x80") == 100, "Find code point beyond U+10FFFF");
+    Check(FindInvalidUtf8(text + "\xE5\xAD") == 100, "Find truncated UTF-8 sequence at the end");
+    Check(FindInvalidUtf8(text + "\xE5\xAD" + text) == 100, "Find truncated UTF-8 sequence");
+    Check(FindInvalidUtf8(text + "\x80") == 100, "Find stray continuation byte");
+
+    Check(FindInvalidUtf16(text16 + u"\xD800") == 100, "Find lone high surrogate at the end");
+    Check(FindInvalidUtf16(text16 + u"\xD800" + text16) == 100, "Find lone high surrogate");
+    Check(FindInvalidUtf16(text16 + u"\xDC00" + text16) == 100, "Find lone low surrogate");
+    Check(FindInvalidUtf16(u"\xDC00" + text16) == 0, "Find lone low surrogate at the start");
+}
+
+
+void TestLengthQueries()
+{
+    using UnicodeConvAtlStd::Utf16LengthOf;
+    using UnicodeConvAtlStd::Utf8LengthOf;
+
+    Check(Utf8LengthOf(u"") == 0 && Utf16LengthOf("") == 0, "Length of empty strings");
+
+    // Long enough for the vectorized kernels to flush their partial counts
+    std::u16string utf16;
+    for (int i = 0; i < 50000; i++)
+    {
+        utf16 += u"A\x00E9\x20AC\xD83D\xDE00";
+    }
+    const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+
+    Check(Utf8LengthOf(utf16) == utf8.length(), "UTF-8 length of UTF-16 string");
+    Check(Utf16LengthOf(utf8) == utf16.length(), "UTF-16 length of UTF-8 string");
+    Check(Utf16LengthOf(utf8.substr(0, utf8.length() - 4) + "\xE5\xAD\x97") == utf16.length() - 1,
+          "UTF-16 length with a 3-char sequence at the end");
+
+    // Errors are found at the same offset as the conversions
+    const auto utf16Error = UnicodeConvAtlStd::Details::MeasureUtf16ToUtf8(u"abc\xD800xyz", 7);
+    Check(utf16Error.status == UnicodeConvAtlStd::ConversionStatus::InvalidInput && utf16Error.unitsRead == 3,
+          "Length of UTF-16 with lone high surrogate");
+    const auto utf8Error = UnicodeConvAtlStd::Details::MeasureUtf8ToUtf16("abc\xE5\xAD", 5);
+    Check(utf8Error.status == UnicodeConvAtlStd::ConversionStatus::InvalidInput && utf8Error.unitsRead == 3,
+          "Length of truncated UTF-8");
+
+    bool thrown = false;
+    try
+    {
+        (void)Utf16LengthOf(utf8 + "\xC0\xAF");
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetConversionType() == UnicodeConvAtlStd::UnicodeConversionException::ConversionType::FromUtf8ToUtf16);
+    }
+    Check(thrown, "Length of invalid UTF-8 throws");
+}
+
+
+void TestAppendToExistingStrings()
+{
+    std::string utf8 = "Kanji:";
+    utf8.reserve(256);
+    const char* const utf8Data = utf8.data();
+    UnicodeConvAtlStd::AppendUtf8(utf8, u" \x5B66");
+    UnicodeConvAtlStd::AppendUtf8(utf8, u"");
+    UnicodeConvAtlStd::AppendUtf8(utf8, u" ok");
+    Check(utf8 == "Kanji: \xE5\xAD\xA6 ok", "Append UTF-8 conversions");
+    Check(utf8.data() == utf8Data, "Append UTF-8 conversions reusing the capacity");
+
+    std::u16string utf16 = u"Kanji:";
+    utf16.reserve(256);
+    const char16_t* const utf16Data = utf16.data();
+    UnicodeConvAtlStd::AppendUtf16(utf16, " \xE5\xAD\xA6");
+    UnicodeConvAtlStd::AppendUtf16(utf16, "");
+    UnicodeConvAtlStd::AppendUtf16(utf16, " ok");
+    Check(utf16 == u"Kanji: \x5B66 ok", "Append UTF-16 conversions");
+    Check(utf16.data() == utf16Data, "Append UTF-16 conversions reusing the capacity");
+
+    // On invalid input, the destination must be left as it was
+    bool thrown = false;
+    try
+    {
+        UnicodeConvAtlStd::AppendUtf8(utf8, u"abc\xD800");
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException&)
+    {
+        thrown = true;
+    }
+    Check(thrown && utf8 == "Kanji: \xE5\xAD\xA6 ok", "Append invalid UTF-16 leaves the destination unchanged");
+
+    thrown = false;
+    try
+    {
+        UnicodeConvAtlStd::AppendUtf16(utf16, "abc\xC0\xAF");
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException&)
+    {
+        thrown = true;
+    }
+    Check(thrown && utf16 == u"Kanji: \x5B66 ok", "Append invalid UTF-8 leaves the destination unchanged");
+}
+
+
+void TestStreamingFragments()
+{
+    // All the UTF-8 sequence lengths, and a surrogate pair
+    std::u16string utf16;
+    for (int i = 0; i < 20; i++)
+    {
+        utf16 += u"A\x00E9\x20AC\xD83D\xDE00 ";
+    }
+    const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+
+    // Every fragment size splits some sequences and surrogate pairs
+    bool utf8Match = true;
+    bool utf16Match = true;
+    for (size_t fragmentLength = 1; fragmentLength <= 9; fragmentLength++)
+    {
+        UnicodeConvAtlStd::Utf8ToUtf16Stream utf8Stream;
+        std::u16string utf16Output;
+        for (size_t i = 0; i < utf8.length(); i += fragmentLength)
+        {
+            utf8Stream.Feed(std::string_view(utf8).substr(i, fragmentLength), utf16Output);
+        }
+        utf8Stream.Finish();
+        utf8Match = utf8Match && (utf16Output == utf16);
+
+        UnicodeConvAtlStd::Utf16ToUtf8Stream utf16Stream;
+        std::string utf8Output;
+        for (size_t i = 0; i < utf16.length(); i += fragmentLength)
+        {
+            utf16Stream.Feed(std::u16string_view(utf16).substr(i, fragmentLength), utf8Output);
+        }
+        utf16Stream.Finish();
+        utf16Match = utf16Match && (utf8Output == utf8);
+    }
+    Check(utf8Match, "Stream UTF-8 fragments to UTF-16");
+    Check(utf16Match, "Stream UTF-16 fragments to UTF-8");
+
+    using UnicodeConvAtlStd::ConversionErrorKind;
+
+    // Truncated sequences at the end of the input
+    UnicodeConvAtlStd::Utf8ToUtf16Stream utf8Stream;
+    std::u16string utf16Output;
+    utf8Stream.Feed("abc\xE5\xAD", utf16Output);
+    bool thrown = false;
+    try
+    {
+        utf8Stream.Finish();
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorOffset() == 3 && ex.GetErrorKind() == ConversionErrorKind::TruncatedSequence);
+    }
+    Check(thrown && utf16Output == u"abc" && !utf8Stream.HasPendingInput(),
+          "Stream truncated UTF-8 sequence at the end");
+
+    UnicodeConvAtlStd::Utf16ToUtf8Stream utf16Stream;
+    std::string utf8Output;
+    utf16Stream.Feed(u"abc\xD83D", utf8Output);
+    thrown = false;
+    try
+    {
+        utf16Stream.Finish();
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorOffset() == 3 && ex.GetErrorKind() == ConversionErrorKind::LoneHighSurrogate);
+    }
+    Check(thrown && utf8Output == "abc" && !utf16Stream.HasPendingInput(),
+          "Stream truncated surrogate pair at the end");
+
+    // Invalid sequences split across fragments: the output of the failed
+    // fragment is discarded, and the error offset counts from the start
+    // of the input
+    utf16Output.clear();
+    utf8Stream.Feed("ab", utf16Output);
+    utf8Stream.Feed("c\xE5", utf16Output);
+    thrown = false;
+    try
+    {
+        utf8Stream.Feed("Axyz", utf16Output);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorOffset() == 3 && ex.GetErrorKind() == ConversionErrorKind::TruncatedSequence);
+    }
+    Check(thrown && utf16Output == u"abc", "Stream invalid UTF-8 sequence across fragments");
+
+    // Chars at the end of a fragment that can't start a valid sequence
+    // are reported by that fragment, not kept for the next one
+    utf16Output.clear();
+    thrown = false;
+    try
+    {
+        utf8Stream.Feed("ab\xFF", utf16Output);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorOffset() == 2 && ex.GetErrorKind() == ConversionErrorKind::InvalidByte);
+    }
+    Check(thrown && utf16Output.empty() && !utf8Stream.HasPendingInput(),
+          "Stream invalid UTF-8 byte at the end of a fragment");
+
+    utf8Stream.Feed("a\xED", utf16Output);
+    thrown = false;
+    try
+    {
+        utf8Stream.Feed("\xA0", utf16Output);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorOffset() == 1 && ex.GetErrorKind() == ConversionErrorKind::SurrogateInUtf8);
+    }
+    Check(thrown && utf16Output == u"a" && !utf8Stream.HasPendingInput(),
+          "Stream invalid UTF-8 sequence start across fragments");
+
+    utf8Output.clear();
+    utf16Stream.Feed(u"ab", utf8Output);
+    utf16Stream.Feed(u"c\xD83D", utf8Output);
+    thrown = false;
+    try
+    {
+        utf16Stream.Feed(u"xyz", utf8Output);
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorOffset() == 3 && ex.GetErrorKind() == ConversionErrorKind::LoneHighSurrogate);
+    }
+    Check(thrown && utf8Output == "abc", "Stream lone high surrogate across fragments");
+}
+
+
+void TestStreambufAdapters()
+{
+    std::mt19937 random(2023);
+    const std::u16string utf16 = MakeRandomUtf16(random, 5000);
+    const std::string utf8 = UnicodeConvAtlStd::Utf16ToUtf8(utf16);
+
+    // Writes of every length, with a small buffer: the writes and the buffer
+    // split surrogate pairs
+    std::ostringstream sink;
+    UnicodeConvAtlStd::Utf8EncodingStreambuf<> encoder(*sink.rdbuf(), 7);
+    std::basic_ostream<char16_t> output(&encoder);
+    for (size_t i = 0, length = 1; i < utf16.length(); i += length, length = length % 20 + 1)
+    {
+        const std::u16string_view text = std::u16string_view(utf16).substr(i, length);
+        output.write(text.data(), static_cast<std::streamsize>(text.length()));
+    }
+    output.put(u'!');
+    output.flush();
+    Check(output.good() && encoder.Finish() && sink.str() == utf8 + "!",
+          "Encode UTF-16 written to a stream buffer as UTF-8");
+
+    // The reverse, reading a code unit or a block at a time
+    std::istringstream source(utf8);
+    UnicodeConvAtlStd::Utf8DecodingStreambuf<> decoder(*source.rdbuf(), 5);
+    std::basic_istream<char16_t> input(&decoder);
+    std::u16string decoded(1, static_cast<char16_t>(input.get()));
+    char16_t block[100];
+    while (input.read(block, 100) || input.gcount() > 0)
+    {
+        decoded.append(block, static_cast<size_t>(input.gcount()));
+    }
+    Check(input.eof() && !input.bad() && decoded == utf16,
+          "Decode UTF-8 read from a stream buffer as UTF-16");
+
+    // Invalid text sets badbit
+    std::ostringstream invalidSink;
+    UnicodeConvAtlStd::Utf8EncodingStreambuf<> invalidEncoder(*invalidSink.rdbuf());
+    std::basic_ostream<char16_t> invalidOutput(&invalidEncoder);
+    invalidOutput.write(u"abc\xDC00", 4);
+    invalidOutput.flush();
+    Check(invalidOutput.bad(), "Encoding invalid UTF-16 sets badbit");
+
+    std::istringstream invalidSource("abc\xE5\xAD");
+    UnicodeConvAtlStd::Utf8DecodingStreambuf<> invalidDecoder(*invalidSource.rdbuf());
+    std::basic_istream<char16_t> invalidInput(&invalidDecoder);
+    invalidInput.read(block, 100);
+    Check(invalidInput.bad(), "Decoding truncated UTF-8 sets badbit");
+
+    // A high surrogate at the end is reported by Finish()
+    std::ostringstream truncatedSink;
+    UnicodeConvAtlStd::Utf8EncodingStreambuf<> truncatedEncoder(*truncatedSink.rdbuf());
+    std::basic_ostream<char16_t>(&truncatedEncoder).write(u"abc\xD83D", 4);
+    bool thrown = false;
+    try
+    {
+        (void)truncatedEncoder.Finish();
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorOffset() == 3
+                  && ex.GetErrorKind() == UnicodeConvAtlStd::ConversionErrorKind::LoneHighSurrogate);
+    }
+    Check(thrown && truncatedSink.str() == "abc", "Finish() reports a high surrogate at the end");
+
+    // The valid text before an error is written, and Finish() reports
+    // the error again after the stream set badbit
+    std::ostringstream loneSurrogateSink;
+    UnicodeConvAtlStd::Utf8EncodingStreambuf<> loneSurrogateEncoder(*loneSurrogateSink.rdbuf());
+    std::basic_ostream<char16_t> loneSurrogateOutput(&loneSurrogateEncoder);
+    loneSurrogateOutput.write(u"abc\xDC00xyz", 7);
+    loneSurrogateOutput.flush();
+    thrown = false;
+    try
+    {
+        (void)loneSurrogateEncoder.Finish();
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorOffset() == 3
+                  && ex.GetErrorKind() == UnicodeConvAtlStd::ConversionErrorKind::LoneLowSurrogate);
+    }
+    Check(loneSurrogateOutput.bad() && thrown && loneSurrogateSink.str() == "abc",
+          "Finish() reports an error already signaled to the stream");
+
+    // The same across writes, and with a high surrogate left by a write
+    std::ostringstream splitSink;
+    UnicodeConvAtlStd::Utf8EncodingStreambuf<> splitEncoder(*splitSink.rdbuf(), 2);
+    std::basic_ostream<char16_t> splitOutput(&splitEncoder);
+    splitOutput.write(u"ab\xD83D", 3);
+    splitOutput.write(u"\xDE00" u"cd\xD83Dx", 5);
+    thrown = false;
+    try
+    {
+        (void)splitEncoder.Finish();
+    }
+    catch (const UnicodeConvAtlStd::UnicodeConversionException& ex)
+    {
+        thrown = (ex.GetErrorOffset() == 6
+                  && ex.GetErrorKind() == UnicodeConvAtlStd::ConversionErrorKind::LoneHighSurrogate);
+    }
+    Check(splitOutput.bad() && thrown && splitSink.str() == "ab\xF0\x9F\x98\x80" "cd",
+          "Write the valid text before an error across writes");
+}
+
+
+void TestKernelTierOverride()
+{
+    using UnicodeConvAtlStd::KernelTier;
+
+    const KernelTier supportedTier = UnicodeConvAtlStd::GetSupportedKernelTier();
+
+    Check(UnicodeConvAtlStd::SetKernelTier(KernelTier::Scalar) == KernelTier::Scalar
+          && UnicodeConvAtlStd::GetKernelTier() == KernelTier::Scalar,
+          "Force the scalar kernel tier");
+    Check(UnicodeConvAtlStd::SetKernelTier(KernelTier::Avx512) == supportedTier
+          && UnicodeConvAtlStd::GetKernelTier() == supportedTier,
+          "Unsupported kernel tiers are lowered to the supported one");
+}
+
+
+// Run the conversion engine tests with every kernel tier the processor supports
+void TestEveryKernelTier()
+{
+    using UnicodeConvAtlStd::KernelTier;
+
+    const int supportedTier = static_cast<int>(UnicodeConvAtlStd::GetSupportedKernelTier());
+    for (int tier = 0; tier <= supportedTier; tier++)
+    {
+        UnicodeConvAtlStd::SetKernelTier(static_cast<KernelTier>(tier));
+        std::cout << "\n  Kernel tier: "
+                  << UnicodeConvAtlStd::GetKernelTierName(UnicodeConvAtlStd::GetKernelTier()) << '\n';
+
+        TestAsciiPrefixes();
+        TestCallerProvidedBuffers();
+        TestValidation();
+        TestLengthQueries();
+        TestErrorPolicy();
+        TestEngineMatchesScalarUtf8ToUtf16();
+        TestEngineMatchesScalarUtf16ToUtf8();
+    }
+
+    UnicodeConvAtlStd::SetKernelTier(static_cast<KernelTier>(supportedTier));
+}
+
+
+void TestUnicodeConversions()
+{
+    std::cout << "*** Test Portable Unicode UTF-16/UTF-8 Transcoding Core *** \n"
+              << "    ================================================== \n\n";
+
+    TestEmptyStrings();
+    TestStringsWithJapaneseKanji();
+    TestAllEncodingLengths();
+    TestInvalidUtf16();
+    TestInvalidUtf8();
+    TestNonThrowingConversions();
+    TestErrorDetails();
+    TestErrorPolicy();
+    TestOtherStringTypes();
+    TestSlicesOfLargerBuffers();
+    TestAllocators();
+    TestBatchConversions();
+    TestParallelConversions();
+    TestFileTranscoding();
+    TestCompileTimeLiterals();
+    TestAppendToExistingStrings();
+    TestStreamingFragments();
+    TestStreambufAdapters();
+    TestKernelTierOverride();
+    TestEveryKernelTier();
+}
+
+
+int main()
+{
+    // Run the tests
+    TestUnicodeConversions();
+
+    return g_failedCount;
+}
@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////
+// TranscodeFile.cpp : Command line tool to transcode text files
+// between UTF-8 and UTF-16
+// by Giovanni Dicanio <giovanni.dicanio AT gmail.com>
+//
+// This file depends on the C++ Standard Library, and on the Windows API
+// or on POSIX, e.g.:
+//
+//      g++ -std=c++17 -O2 -march=native TranscodeFile.cpp -o TranscodeFile
+//
+// Usage:
+//
+//      TranscodeFile [--from ENCODING] [--to ENCODING] [--bom] SOURCE TARGET
+//
+// ENCODING is utf8, utf16le or utf16be. --from is the encoding of sources
+// without a BOM (default: utf16le); --to is the encoding of the target
+// (default: utf8), which gets a BOM with --bom.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include "UnicodeConvFile.hpp"       // File transcoding
+
+#include <cstdio>                    // For console output
+#include <cstring>                   // std::strcmp
+#include <exception>                 // std::exception
+
+
+// Parse an encoding name of the command line
+bool ParseEncoding(const char* name, UnicodeConvAtlStd::FileEncoding& encoding)
+{
+    using UnicodeConvAtlStd::FileEncoding;
+
+    if (std::strcmp(name, "utf8") == 0)
+    {
+        encoding = FileEncoding::Utf8;
+    }
+    else if (std::strcmp(name, "utf16le") == 0)
+    {
+        encoding = FileEncoding::Utf16LE;
+    }
+    else if (std::strcmp(name, "utf16be") == 0)
+    {
+        encoding = FileEncoding::Utf16BE;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+
+int PrintUsage()
+{
+    std::fprintf(stderr,
+                 "Usage: TranscodeFile [--from ENCODING] [--to ENCODING] [--bom] SOURCE TARGET\n"
+                 "\n"
+                 "  --from ENCODING   Encoding of sources without a BOM (default: utf16le)\n"
+                 "  --to ENCODING     Encoding of the target (default: utf8)\n"
+                 "  --bom             Start the target with a BOM\n"
+                 "\n"
+                 "ENCODING is utf8, utf16le or utf16be.\n");
+    return 2;
+}
+
+
+int main(int argc, char* argv[])
+{
+    UnicodeConvAtlStd::FileTranscodeOptions options;
+    const char* paths[2] = {};
+    int pathCount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--from") == 0 && i + 1 < argc)
+        {
+            if (!ParseEncoding(argv[++i], options.sourceEncoding))
+            {
+                return PrintUsage();
+            }
+        }
+        else if (std::strcmp(argv[i], "--to") == 0 && i + 1 < argc)
+        {
+            if (!ParseEncoding(argv[++i], options.targetEncoding))
+            {
+                return PrintUsage();
+            }
+        }
+        else if (std::strcmp(argv[i], "--bom") == 0)
+        {
+            options.writeBom = true;
+        }
+        else if (argv[i][0] != '-' && pathCount < 2)
+        {
+            paths[pathCount++] = argv[i];
+        }
+        else
+        {
+            return PrintUsage();
+        }
+    }
+    if (pathCount != 2)
+    {
+        return PrintUsage();
+    }
+
+    try
+    {
+        const UnicodeConvAtlStd::FileTranscodeResult result =
+            UnicodeConvAtlStd::TranscodeFile(paths[0], paths[1], options);
+
+        std::printf("%s (%s%s): %llu bytes -> %s (%s%s): %llu bytes\n"
+                    "%.3f s, %.1f MB/s\n",
+                    paths[0], UnicodeConvAtlStd::GetFileEncodingName(result.sourceEncoding),
+                    result.sourceHasBom ? ", BOM" : "", static_cast<unsigned long long>(result.bytesRead),
+                    paths[1], UnicodeConvAtlStd::GetFileEncodingName(options.targetEncoding),
+                    options.writeBom ? ", BOM" : "", static_cast<unsigned long long>(result.bytesWritten),
+                    result.seconds, result.GetThroughput());
+    }
+    catch (const std::exception& ex)
+    {
+        std::fprintf(stderr, "Error: %s\n", ex.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -15,8 +15,13 @@
 // This is a header-only C++ file that implements a couple of functions
 // to simply and conveniently convert Unicode text between UTF-16 and UTF-8.
 //
+// These functions are thin CString adapters over the portable
+// transcoding core implemented in UnicodeConvCore.hpp.
+//
 // CString is used to store UTF-16-encoded text.
-// std::string is used to store UTF-8-encoded text.
+// std::string is used to store UTF-8-encoded text;
+// UTF-8 input is taken as std::string_view, so std::string, string literals
+// and slices of larger buffers convert without a temporary std::string.
 //
 // The exported functions are:
 //
@@ -24,7 +29,53 @@
 //        std::string ToUtf8(CString const& utf16)
 //
 //      * Convert from UTF-8 to UTF-16:
-//        CString ToUtf16(std::string const& utf8)
+//        CString ToUtf16(std::string_view utf8)
+//
+//      * Convert a slice of a larger buffer, given as a pointer and a length:
+//        std::string ToUtf8(const wchar_t* utf16, size_t utf16Length)
+//        CString ToUtf16(const char* utf8, size_t utf8Length)
+//
+//      * Convert into another UTF-8 string type (e.g. C++20 std::u8string),
+//        or from any contiguous container or view of UTF-8 code units:
+//        Utf8String ToUtf8<Utf8String>(CString const& utf16)
+//        CString ToUtf16(Utf8Text const& utf8)
+//        (the portable core also converts between std::wstring,
+//        std::u16string, std::u8string..., see UnicodeConvCore.hpp)
+//
+//      * Convert into a UTF-8 string allocated by the given allocator
+//        (e.g. an arena allocator), or from a std::pmr::memory_resource:
+//        std::basic_string<..., Allocator> ToUtf8(CString const& utf16, Allocator const& allocator)
+//        std::pmr::string ToUtf8(CString const& utf16, std::pmr::memory_resource* resource)
+//
+//      * Convert replacing invalid input with U+FFFD, instead of throwing:
+//        std::string ToUtf8(CString const& utf16, ErrorPolicy errorPolicy,
+//                           size_t* replacementCount = nullptr)
+//        CString ToUtf16(std::string_view utf8, ErrorPolicy errorPolicy,
+//                        size_t* replacementCount = nullptr)
+//
+//      * Convert without throwing on invalid input:
+//        ConversionExpected<std::string> TryToUtf8(CString const& utf16)
+//        ConversionExpected<CString> TryToUtf16(std::string_view utf8)
+//
+//      * Append to an existing string, reusing its capacity:
+//        void AppendUtf8(std::string& utf8, CString const& utf16)
+//        void AppendUtf16(CString& utf16, std::string_view utf8)
+//
+//      * Convert a batch of CStrings into one contiguous std::string plus offsets:
+//        Utf8Batch ToUtf8Batch(std::span<const CString> strings)
+//        (and an overload taking a pointer and a count, also before C++20)
+//
+//      * Validate a CString without converting it:
+//        bool IsValidUtf16(CString const& utf16)
+//        size_t FindInvalidUtf16(CString const& utf16)   (npos if valid)
+//
+//      * Query the length of the UTF-8 conversion, without converting:
+//        size_t Utf8LengthOf(CString const& utf16)
+//
+// Invalid input is signaled throwing UnicodeConversionException
+// (the Try functions return a ConversionError instead).
+// UTF-8 input longer than INT_MAX chars is accepted, as long as its
+// UTF-16 conversion fits a CString (std::overflow_error otherwise).
 //
 // These functions live under the UnicodeConvAtlStd namespace.
 //
@@ -68,9 +119,13 @@
 #include <atldef.h>     // ATLASSERT
 #include <atlstr.h>     // CString
 
+#include "UnicodeConvCore.hpp"  // Portable transcoding core
+
 #include <limits>       // std::numeric_limits
-#include <stdexcept>    // std::runtime_error, std::overflow_error
+#include <stdexcept>    // std::overflow_error
 #include <string>       // std::string
+#include <string_view>  // std::string_view, std::u16string_view
+#include <type_traits>  // std::enable_if_t, std::is_same_v
 
 
 //==============================================================================
@@ -86,69 +141,116 @@
 #error UnicodeConvAtlStd.hpp requires Unicode mode.
 #endif
 
+//
+// The conversions are implemented by the portable core on char16_t buffers.
+// On Windows, wchar_t is a 16-bit type storing UTF-16 code units, too;
+// and the core error codes match the Win32 ones.
+//
+static_assert(sizeof(wchar_t) == sizeof(char16_t),
+              "UnicodeConvAtlStd.hpp requires 16-bit wchar_t.");
+static_assert(std::is_same_v<DWORD, UnicodeConvAtlStd::ErrorCode>,
+              "UnicodeConvAtlStd::ErrorCode must match DWORD.");
+static_assert(UnicodeConvAtlStd::kErrorNoUnicodeTranslation == ERROR_NO_UNICODE_TRANSLATION,
+              "UnicodeConvAtlStd::kErrorNoUnicodeTranslation must match the Win32 error code.");
+
 
 namespace UnicodeConvAtlStd {
 
+namespace Details
+{
+
 //------------------------------------------------------------------------------
-// Represents an error during Unicode conversions
+// Append the UTF-16 conversion of UTF-8 text to a CString.
+//
+// The CString length is an int, but the UTF-8 input can be longer
+// (e.g. 3 GB of CJK text is 1G UTF-16 code units): the core converts the
+// input in chunks that are sure to fit the room left in the CString,
+// without splitting UTF-8 sequences, so any input whose conversion fits
+// is accepted. Inputs that fit anyway are converted in a single call.
+//
+// The status is TargetTooSmall if the output is longer than maxUtf16Length,
+// and InvalidInput on invalid input (unitsRead is then the offset of the error);
+// in both cases, utf16 is left as it was.
+// If replacementCount is not null, invalid input is replaced with U+FFFD
+// instead, adding the number of replacements there.
 //------------------------------------------------------------------------------
-class UnicodeConversionException
-    : public std::runtime_error
+[[nodiscard]] inline ConversionResult TryAppendUtf8ToCString(
+    CString& utf16,
+    std::string_view utf8,
+    int maxUtf16Length = (std::numeric_limits<int>::max)(),
+    std::size_t* replacementCount = nullptr)
 {
-public:
+    const int oldLength = utf16.GetLength();
+    ATLASSERT(oldLength <= maxUtf16Length);
+
+    // Make room after the current content for the worst case
+    // (one UTF-16 code unit per UTF-8 char), as far as the CString allows.
+    // CString grows its buffer geometrically, and keeps the existing text,
+    // so a sequence of appends doesn't reallocate at every call.
+    const std::size_t room = static_cast<std::size_t>(maxUtf16Length - oldLength);
+    const int capacity = static_cast<int>((utf8.length() < room) ? utf8.length() : room);
+    wchar_t* utf16Buffer = utf16.GetBuffer(oldLength + capacity);
+    ATLASSERT(utf16Buffer != nullptr);
 
-    enum class ConversionType
-    {
-        FromUtf16ToUtf8,
-        FromUtf8ToUtf16
-    };
-
-    UnicodeConversionException(DWORD errorCode, ConversionType conversionType, const char* message)
-        : std::runtime_error(message),
-        m_errorCode(errorCode),
-        m_conversionType(conversionType)
+    // Do the actual conversion from UTF-8 to UTF-16, using the portable core.
+    // As with MB_ERR_INVALID_CHARS, fail if an invalid UTF-8 sequence is encountered,
+    // unless asked to replace it.
+    char16_t* const dst = reinterpret_cast<char16_t*>(utf16Buffer + oldLength);
+    const ConversionResult result = (replacementCount == nullptr)
+        ? ConvertUtf8ToUtf16Bounded(utf8.data(), utf8.length(), dst, static_cast<std::size_t>(capacity))
+        : ConvertUtf8ToUtf16Replacing(utf8.data(), utf8.length(), dst, static_cast<std::size_t>(capacity),
+                                      *replacementCount);
+    if (result.status != ConversionStatus::Ok)
     {
+        // Restore the original content
+        utf16.ReleaseBuffer(oldLength);
+        return result;
     }
 
-    UnicodeConversionException(DWORD errorCode, ConversionType conversionType, const std::string& message)
-        : std::runtime_error(message),
-        m_errorCode(errorCode),
-        m_conversionType(conversionType)
-    {
-    }
+    // Don't forget to call ReleaseBuffer on the CString object after calling GetBuffer!
+    utf16.ReleaseBuffer(oldLength + static_cast<int>(result.unitsWritten));
+    utf16Buffer = nullptr;
+
+    return result;
+}
+
 
-    [[nodiscard]] DWORD GetErrorCode() const noexcept
+//------------------------------------------------------------------------------
+// Append the UTF-16 conversion of UTF-8 text to a CString,
+// as TryAppendUtf8ToCString.
+// Throws std::overflow_error if the output is longer than maxUtf16Length,
+// and UnicodeConversionException on invalid input;
+// in both cases, utf16 is left as it was.
+//------------------------------------------------------------------------------
+inline void AppendUtf8ToCString(
+    CString& utf16,
+    std::string_view utf8,
+    int maxUtf16Length = (std::numeric_limits<int>::max)(),
+    std::size_t* replacementCount = nullptr)
+{
+    const ConversionResult result = TryAppendUtf8ToCString(utf16, utf8, maxUtf16Length, replacementCount);
+    if (result.status == ConversionStatus::TargetTooSmall)
     {
-        return m_errorCode;
+        throw std::overflow_error("The UTF-16 output is too long to fit into a CString.");
     }
-
-    [[nodiscard]] ConversionType GetConversionType() const noexcept
+    if (result.status != ConversionStatus::Ok)
     {
-        return m_conversionType;
+        ThrowConversionError(DescribeUtf8Error(utf8.data(), utf8.length(), result.unitsRead));
     }
-
-private:
-    DWORD m_errorCode;
-    ConversionType m_conversionType;
-};
+}
 
 
-namespace Details
-{
-
 //------------------------------------------------------------------------------
-// Helper function to safely convert a size_t value to int.
-// If size_t is too large, throws a std::overflow_error exception.
+// Release the unused tail of the worst-case allocation of a CString,
+// if it's large (e.g. CJK text takes 3 UTF-8 chars per UTF-16 code unit)
 //------------------------------------------------------------------------------
-inline [[nodiscard]] int SafeSizeToInt(size_t sizeValue)
+inline void FreeExtraIfWasteful(CString& utf16)
 {
-    constexpr int kIntMax = (std::numeric_limits<int>::max)();
-    if (sizeValue > static_cast<size_t>(kIntMax))
+    const int utf16Length = utf16.GetLength();
+    if (utf16.GetAllocLength() - utf16Length > utf16Length / 2)
     {
-        throw std::overflow_error("size_t value is too big to fit into an int.");
+        utf16.FreeExtra();
     }
-
-    return static_cast<int>(sizeValue);
 }
 
 } // namespace Details
@@ -167,133 +269,329 @@ inline [[nodiscard]] std::string ToUtf8(CString const& utf16)
         return std::string{};
     }
 
-    // Safely fail if an invalid UTF-16 character sequence is encountered
-    constexpr DWORD kFlags = WC_ERR_INVALID_CHARS;
+    // View the CString wchar_ts as UTF-16 char16_t code units
+    const std::u16string_view utf16View(
+        reinterpret_cast<const char16_t*>(utf16.GetString()),
+        static_cast<size_t>(utf16.GetLength()));
 
-    const int utf16Length = utf16.GetLength();
+    // Let the portable core do the actual conversion from UTF-16 to UTF-8
+    return Utf16ToUtf8(utf16View);
+}
 
-    // Get the length, in chars, of the resulting UTF-8 string
-    const int utf8Length = ::WideCharToMultiByte(
-        CP_UTF8,            // convert to UTF-8
-        kFlags,             // conversion flags
-        utf16,              // source UTF-16 string
-        utf16Length,        // length of source UTF-16 string, in wchar_ts
-        nullptr,            // unused - no conversion required in this step
-        0,                  // request size of destination buffer, in chars
-        nullptr, nullptr    // unused
-    );
-    if (utf8Length == 0)
-    {
-        // Conversion error: capture error code and throw
-        const DWORD errorCode = ::GetLastError();
-        throw UnicodeConversionException(
-            errorCode,
-            UnicodeConversionException::ConversionType::FromUtf16ToUtf8,
-            "Can't get result UTF-8 string length (WideCharToMultiByte failed).");
-    }
 
-    // Make room in the destination string for the converted bits
-    std::string utf8(utf8Length, ' ');
-    char* utf8Buffer = utf8.data();
-    ATLASSERT(utf8Buffer != nullptr);
-
-    // Do the actual conversion from UTF-16 to UTF-8
-    int result = ::WideCharToMultiByte(
-        CP_UTF8,            // convert to UTF-8
-        kFlags,             // conversion flags
-        utf16,              // source UTF-16 string
-        utf16Length,        // length of source UTF-16 string, in wchar_ts
-        utf8Buffer,         // pointer to destination buffer
-        utf8Length,         // size of destination buffer, in chars
-        nullptr, nullptr    // unused
-    );
-    if (result == 0)
+//------------------------------------------------------------------------------
+// Convert from UTF-8 std::string_view to UTF-16 CString.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+inline [[nodiscard]] CString ToUtf16(std::string_view utf8)
+{
+    // Special case of empty input string
+    if (utf8.empty())
     {
-        // Conversion error: capture error code and throw
-        const DWORD errorCode = ::GetLastError();
-        throw UnicodeConversionException(
-            errorCode,
-            UnicodeConversionException::ConversionType::FromUtf16ToUtf8,
-            "Can't convert from UTF-16 to UTF-8 string (WideCharToMultiByte failed).");
+        // Empty input --> return empty output string
+        return CString{};
     }
 
-    return utf8;
+    // The destination string is allocated for the worst case:
+    // a UTF-8 string can't have more UTF-16 code units than it has chars.
+    // So the conversion can be done in a single pass,
+    // without first querying the length of the resulting UTF-16 string.
+    CString utf16;
+    Details::AppendUtf8ToCString(utf16, utf8);
+    Details::FreeExtraIfWasteful(utf16);
+
+    return utf16;
 }
 
 
 //------------------------------------------------------------------------------
-// Convert from UTF-8 std::string to UTF-16 CString.
+// Convert from UTF-16 text, given as a pointer and a length in wchar_ts
+// (e.g. a slice of a larger buffer), to UTF-8 std::string,
+// without copying it into a CString first.
 // Signal errors throwing UnicodeConversionException.
 //------------------------------------------------------------------------------
-inline [[nodiscard]] CString ToUtf16(std::string const& utf8)
+inline [[nodiscard]] std::string ToUtf8(const wchar_t* utf16, size_t utf16Length)
 {
-    // Special case of empty input string
-    if (utf8.empty())
+    // View the wchar_ts as UTF-16 char16_t code units
+    const std::u16string_view utf16View(reinterpret_cast<const char16_t*>(utf16), utf16Length);
+
+    return Utf16ToUtf8(utf16View);
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 text, given as a pointer and a length in chars
+// (e.g. a slice of a memory-mapped file or network buffer), to UTF-16 CString.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+inline [[nodiscard]] CString ToUtf16(const char* utf8, size_t utf8Length)
+{
+    return ToUtf16(std::string_view(utf8, utf8Length));
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 CString to UTF-8, directly into the given string type
+// (e.g. ToUtf8<std::u8string>(utf16) in C++20).
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+template <typename Utf8String>
+inline [[nodiscard]] Utf8String ToUtf8(CString const& utf16)
+{
+    // View the CString wchar_ts as UTF-16 char16_t code units
+    const std::u16string_view utf16View(
+        reinterpret_cast<const char16_t*>(utf16.GetString()),
+        static_cast<size_t>(utf16.GetLength()));
+
+    return Utf16ToUtf8<Utf8String>(utf16View);
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 CString to UTF-8, into a string allocated by the given
+// allocator (e.g. an arena allocator, or a std::pmr::polymorphic_allocator):
+// the string type is the std::basic_string of the allocator value_type.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+template <typename Allocator,
+          std::enable_if_t<Details::kIsUtf8CodeUnit<typename Allocator::value_type>, int> = 0>
+inline [[nodiscard]] Details::AllocatorString<Allocator> ToUtf8(CString const& utf16, const Allocator& allocator)
+{
+    // View the CString wchar_ts as UTF-16 char16_t code units
+    const std::u16string_view utf16View(
+        reinterpret_cast<const char16_t*>(utf16.GetString()),
+        static_cast<size_t>(utf16.GetLength()));
+
+    return Utf16ToUtf8(utf16View, allocator);
+}
+
+
+#if defined(__cpp_lib_memory_resource)
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 CString to UTF-8 std::pmr::string, allocated from
+// the given memory resource (e.g. a per-request monotonic_buffer_resource).
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+inline [[nodiscard]] std::pmr::string ToUtf8(CString const& utf16, std::pmr::memory_resource* resource)
+{
+    return ToUtf8(utf16, std::pmr::polymorphic_allocator<char>(resource));
+}
+
+#endif // __cpp_lib_memory_resource
+
+
+//------------------------------------------------------------------------------
+// Convert to UTF-16 CString from any contiguous container or view
+// of UTF-8 code units (std::string_view, C++20 std::u8string, std::vector<char>...),
+// with no intermediate std::string copy.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+template <typename Utf8Text,
+          std::enable_if_t<Details::kIsUtf8Text<Utf8Text>, int> = 0>
+inline [[nodiscard]] CString ToUtf16(const Utf8Text& utf8)
+{
+    CString utf16;
+    Details::AppendUtf8ToCString(utf16, Details::AsUtf8View(utf8));
+    Details::FreeExtraIfWasteful(utf16);
+
+    return utf16;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 CString to UTF-8 std::string,
+// with the given policy for invalid input.
+// With ErrorPolicy::Replace, invalid input doesn't throw; if replacementCount
+// is not null, it receives the number of U+FFFD substituted for it.
+//------------------------------------------------------------------------------
+inline [[nodiscard]] std::string ToUtf8(
+    CString const& utf16, ErrorPolicy errorPolicy, size_t* replacementCount = nullptr)
+{
+    // View the CString wchar_ts as UTF-16 char16_t code units
+    const std::u16string_view utf16View(
+        reinterpret_cast<const char16_t*>(utf16.GetString()),
+        static_cast<size_t>(utf16.GetLength()));
+
+    return Utf16ToUtf8(utf16View, errorPolicy, replacementCount);
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 std::string_view to UTF-16 CString,
+// with the given policy for invalid input, as the ToUtf8 overload above
+//------------------------------------------------------------------------------
+inline [[nodiscard]] CString ToUtf16(
+    std::string_view utf8, ErrorPolicy errorPolicy, size_t* replacementCount = nullptr)
+{
+    size_t replacements = 0;
+    CString utf16;
+    Details::AppendUtf8ToCString(utf16, utf8, (std::numeric_limits<int>::max)(),
+                                 (errorPolicy == ErrorPolicy::Replace) ? &replacements : nullptr);
+    Details::FreeExtraIfWasteful(utf16);
+
+    if (replacementCount != nullptr)
     {
-        // Empty input --> return empty output string
-        return CString{};
+        *replacementCount = replacements;
     }
+    return utf16;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 CString to UTF-8 std::string,
+// without throwing on invalid input: return a ConversionError instead.
+// (std::expected in C++23, see UnicodeConvCore.hpp.)
+//------------------------------------------------------------------------------
+inline [[nodiscard]] ConversionExpected<std::string> TryToUtf8(CString const& utf16)
+{
+    // View the CString wchar_ts as UTF-16 char16_t code units
+    const std::u16string_view utf16View(
+        reinterpret_cast<const char16_t*>(utf16.GetString()),
+        static_cast<size_t>(utf16.GetLength()));
+
+    return TryUtf16ToUtf8(utf16View);
+}
 
-    // Safely fail if an invalid UTF-8 character sequence is encountered
-    constexpr DWORD kFlags = MB_ERR_INVALID_CHARS;
-
-    const int utf8Length = Details::SafeSizeToInt(utf8.length());
-
-    // Get the size of the destination UTF-16 string
-    const int utf16Length = ::MultiByteToWideChar(
-        CP_UTF8,       // source string is in UTF-8
-        kFlags,        // conversion flags
-        utf8.data(),   // source UTF-8 string pointer
-        utf8Length,    // length of the source UTF-8 string, in chars
-        nullptr,       // unused - no conversion done in this step
-        0              // request size of destination buffer, in wchar_ts
-    );
-    if (utf16Length == 0)
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 std::string_view to UTF-16 CString,
+// without throwing on invalid input: return a ConversionError instead.
+// Its status is TargetTooSmall if the output is too long for a CString.
+// Invalid input is found before allocating, so that error path allocates nothing.
+//------------------------------------------------------------------------------
+inline [[nodiscard]] ConversionExpected<CString> TryToUtf16(std::string_view utf8)
+{
+    // Validate first; this also gives the exact length of the output
+    const ConversionResult measured = Details::MeasureUtf8ToUtf16(utf8.data(), utf8.length());
+    if (measured.status != ConversionStatus::Ok)
     {
-        // Conversion error: capture error code and throw
-        const DWORD errorCode = ::GetLastError();
-        throw UnicodeConversionException(
-            errorCode,
-            UnicodeConversionException::ConversionType::FromUtf8ToUtf16,
-            "Can't get result UTF-16 string length (MultiByteToWideChar failed).");
+        return Details::MakeConversionError<CString>(
+            Details::DescribeUtf8Error(utf8.data(), utf8.length(), measured.unitsRead));
     }
 
-    // Make room in the destination string for the converted bits
+    // Limiting the CString to the exact length allocates no worst-case tail
+    constexpr std::size_t kMaxCStringLength = static_cast<std::size_t>((std::numeric_limits<int>::max)());
+    const int maxUtf16Length = static_cast<int>(
+        (measured.unitsWritten < kMaxCStringLength) ? measured.unitsWritten : kMaxCStringLength);
+
     CString utf16;
-    wchar_t* utf16Buffer = utf16.GetBuffer(utf16Length);
-    ATLASSERT(utf16Buffer != nullptr);
+    const ConversionResult result = Details::TryAppendUtf8ToCString(utf16, utf8, maxUtf16Length);
+    if (result.status != ConversionStatus::Ok)
+    {
+        return Details::MakeConversionError<CString>(
+            { result.status, UnicodeConversionException::ConversionType::FromUtf8ToUtf16,
+              result.unitsRead, ConversionErrorKind::None });
+    }
+
+    return utf16;
+}
 
-    // Do the actual conversion from UTF-8 to UTF-16
-    int result = ::MultiByteToWideChar(
-        CP_UTF8,       // source string is in UTF-8
-        kFlags,        // conversion flags
-        utf8.data(),   // source UTF-8 string pointer
-        utf8Length,    // length of source UTF-8 string, in chars
-        utf16Buffer,   // pointer to destination buffer
-        utf16Length    // size of destination buffer, in wchar_ts
-    );
-    if (result == 0)
+
+//------------------------------------------------------------------------------
+// Append the UTF-8 conversion of a UTF-16 CString to a std::string,
+// growing it in place: repeated appends reuse its capacity.
+// Signal errors throwing UnicodeConversionException;
+// in that case, utf8 is left as it was.
+//------------------------------------------------------------------------------
+inline void AppendUtf8(std::string& utf8, CString const& utf16)
+{
+    // View the CString wchar_ts as UTF-16 char16_t code units
+    const std::u16string_view utf16View(
+        reinterpret_cast<const char16_t*>(utf16.GetString()),
+        static_cast<size_t>(utf16.GetLength()));
+
+    AppendUtf8(utf8, utf16View);
+}
+
+
+//------------------------------------------------------------------------------
+// Append the UTF-16 conversion of UTF-8 std::string_view text to a CString,
+// growing it in place: repeated appends reuse its capacity.
+// Signal errors throwing UnicodeConversionException;
+// in that case, utf16 is left as it was.
+//------------------------------------------------------------------------------
+inline void AppendUtf16(CString& utf16, std::string_view utf8)
+{
+    // Special case of empty input string: nothing to append
+    if (utf8.empty())
     {
-        // Conversion error: capture error code and throw
-        const DWORD errorCode = ::GetLastError();
-        throw UnicodeConversionException(
-            errorCode,
-            UnicodeConversionException::ConversionType::FromUtf8ToUtf16,
-            "Can't convert from UTF-8 to UTF-16 string (MultiByteToWideChar failed).");
+        return;
     }
 
-    // Don't forget to call ReleaseBuffer on the CString object after calling GetBuffer!
-    utf16.ReleaseBuffer(utf16Length);
+    Details::AppendUtf8ToCString(utf16, utf8);
+}
 
-    // It is good coding practice to clear the CString buffer pointer
-    // that was returned by CString::GetBuffer after a matching call
-    // to CString::ReleaseBuffer.
-    // However, in this case we just return the result string
-    // from the function, so we can skip that line:
-    //
-    // utf16Buffer = nullptr;
 
-    return utf16;
+//------------------------------------------------------------------------------
+// Convert a batch of UTF-16 CStrings (e.g. a column of names or keys)
+// to UTF-8, into a single contiguous std::string plus the offset
+// of each converted string in it (Arrow-style), allocated once.
+// Signal errors throwing UnicodeConversionException; the error offset
+// is in the batch, as if its strings were concatenated.
+//------------------------------------------------------------------------------
+inline [[nodiscard]] Utf8Batch ToUtf8Batch(const CString* strings, size_t count)
+{
+    return Details::Utf16ToUtf8Batch(count, [strings](size_t i)
+    {
+        // View the CString wchar_ts as UTF-16 char16_t code units
+        return std::u16string_view(
+            reinterpret_cast<const char16_t*>(strings[i].GetString()),
+            static_cast<size_t>(strings[i].GetLength()));
+    });
+}
+
+
+#if defined(__cpp_lib_span)
+
+//------------------------------------------------------------------------------
+// std::span version of the batch conversion above
+//------------------------------------------------------------------------------
+inline [[nodiscard]] Utf8Batch ToUtf8Batch(std::span<const CString> strings)
+{
+    return ToUtf8Batch(strings.data(), strings.size());
+}
+
+#endif // __cpp_lib_span
+
+
+//------------------------------------------------------------------------------
+// Check if a CString is valid UTF-16 (no unpaired surrogates),
+// without converting it.
+// (UTF-8 std::strings are checked with IsValidUtf8 of the portable core.)
+//------------------------------------------------------------------------------
+inline [[nodiscard]] bool IsValidUtf16(CString const& utf16) noexcept
+{
+    return IsValidUtf16(std::u16string_view(
+        reinterpret_cast<const char16_t*>(utf16.GetString()),
+        static_cast<size_t>(utf16.GetLength())));
+}
+
+
+//------------------------------------------------------------------------------
+// Return the offset of the first unpaired surrogate in a CString,
+// or std::u16string_view::npos if it is valid UTF-16
+//------------------------------------------------------------------------------
+inline [[nodiscard]] size_t FindInvalidUtf16(CString const& utf16) noexcept
+{
+    return FindInvalidUtf16(std::u16string_view(
+        reinterpret_cast<const char16_t*>(utf16.GetString()),
+        static_cast<size_t>(utf16.GetLength())));
+}
+
+
+//------------------------------------------------------------------------------
+// Return the length, in chars, of the UTF-8 conversion of a CString,
+// without converting it.
+// (The UTF-16 length of UTF-8 std::strings is returned by Utf16LengthOf
+// of the portable core.)
+// Signal errors throwing UnicodeConversionException, like ToUtf8.
+//------------------------------------------------------------------------------
+inline [[nodiscard]] size_t Utf8LengthOf(CString const& utf16)
+{
+    return Utf8LengthOf(std::u16string_view(
+        reinterpret_cast<const char16_t*>(utf16.GetString()),
+        static_cast<size_t>(utf16.GetLength())));
 }
 
 } // namespace UnicodeConvAtlStd
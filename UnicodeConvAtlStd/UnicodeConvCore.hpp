@@ -0,0 +1,2345 @@
+#ifndef GIOVANNI_DICANIO_UNICODECONVCORE_HPP_INCLUDED
+#define GIOVANNI_DICANIO_UNICODECONVCORE_HPP_INCLUDED
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Portable Unicode UTF-16/UTF-8 transcoding core
+//
+//                  Copyright (C) by Giovanni Dicanio
+//                    <giovanni.dicanio AT gmail.com>
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+//------------------------------------------------------------------------------
+// This is a header-only C++ file that implements the portable engine
+// behind the CString/std::string conversion functions.
+//
+// It depends only on the C++ Standard Library, so it can be built,
+// tested and benchmarked on non-Windows platforms, too.
+//
+// UTF-16 text is represented as char16_t code units.
+// UTF-8 text is represented as char code units.
+// The templated overloads also take and return other code unit types:
+// wchar_t where it is 16-bit (as on Windows) for UTF-16, and C++20 char8_t for UTF-8.
+//
+// The exported functions are:
+//
+//      * Convert from UTF-16 to UTF-8:
+//        std::string Utf16ToUtf8(std::u16string_view utf16)
+//
+//      * Convert from UTF-8 to UTF-16:
+//        std::u16string Utf8ToUtf16(std::string_view utf8)
+//
+//      * Convert a slice of a larger buffer, given as a pointer and a length:
+//        std::string Utf16ToUtf8(const char16_t* utf16, size_t utf16Length)
+//        std::u16string Utf8ToUtf16(const char* utf8, size_t utf8Length)
+//
+//      * Convert any contiguous container or view of code units
+//        (std::wstring, std::u8string, std::vector<char16_t>, std::span...)
+//        into the given string type (std::u8string, std::wstring, ...):
+//        Utf8String Utf16ToUtf8<Utf8String = std::string>(Utf16Text const& utf16)
+//        Utf16String Utf8ToUtf16<Utf16String = std::u16string>(Utf8Text const& utf8)
+//
+//      * Convert into strings allocated by the given allocator
+//        (e.g. an arena allocator), or from a std::pmr::memory_resource:
+//        std::basic_string<..., Allocator> Utf16ToUtf8(Utf16Text const& utf16, Allocator const& allocator)
+//        std::basic_string<..., Allocator> Utf8ToUtf16(Utf8Text const& utf8, Allocator const& allocator)
+//        std::pmr::string Utf16ToUtf8(Utf16Text const& utf16, std::pmr::memory_resource* resource)
+//        std::pmr::u16string Utf8ToUtf16(Utf8Text const& utf8, std::pmr::memory_resource* resource)
+//
+//      * Convert replacing invalid input with U+FFFD, instead of throwing:
+//        std::string Utf16ToUtf8(std::u16string_view utf16, ErrorPolicy errorPolicy,
+//                                size_t* replacementCount = nullptr)
+//        std::u16string Utf8ToUtf16(std::string_view utf8, ErrorPolicy errorPolicy,
+//                                   size_t* replacementCount = nullptr)
+//
+//      * Convert without throwing on invalid input (std::expected in C++23):
+//        ConversionExpected<std::string> TryUtf16ToUtf8(std::u16string_view utf16)
+//        ConversionExpected<std::u16string> TryUtf8ToUtf16(std::string_view utf8)
+//
+//      * Append to an existing string, reusing its capacity:
+//        void AppendUtf8(std::string& utf8, std::u16string_view utf16)
+//        void AppendUtf16(std::u16string& utf16, std::string_view utf8)
+//
+//      * Convert a batch of strings into one contiguous string plus offsets (Arrow-style):
+//        Utf8Batch Utf16ToUtf8Batch(std::span<const std::u16string_view> strings)
+//        Utf16Batch Utf8ToUtf16Batch(std::span<const std::string_view> strings)
+//        (and overloads taking a pointer and a count, also before C++20)
+//
+//      * Validate without converting:
+//        bool IsValidUtf8(std::string_view utf8)
+//        bool IsValidUtf16(std::u16string_view utf16)
+//        size_t FindInvalidUtf8(std::string_view utf8)         (npos if valid)
+//        size_t FindInvalidUtf16(std::u16string_view utf16)    (npos if valid)
+//
+//      * Query the length of a conversion, without converting:
+//        size_t Utf8LengthOf(std::u16string_view utf16)
+//        size_t Utf16LengthOf(std::string_view utf8)
+//
+//      * Convert into a caller-provided buffer, without allocating:
+//        ConversionResult ConvertUtf16ToUtf8(std::u16string_view utf16, std::span<char> utf8)
+//        ConversionResult ConvertUtf8ToUtf16(std::string_view utf8, std::span<char16_t> utf16)
+//        (and overloads taking a pointer and a capacity, also before C++20)
+//
+// These functions live under the UnicodeConvAtlStd namespace.
+// Invalid input is rejected with the same strict rules as
+// WC_ERR_INVALID_CHARS/MB_ERR_INVALID_CHARS: the functions returning strings
+// throw UnicodeConversionException (the Try ones return a ConversionError),
+// the others return an InvalidInput status. Exceptions and errors report
+// the offset of the first invalid input code unit, and a ConversionErrorKind.
+//
+// Conversions run in a single pass: the destination is allocated
+// for the worst case, filled once, and then trimmed to the actual length.
+//
+// On x86-64, vectorized kernels are selected at run time for the processor
+// (see UnicodeConvSimd.hpp). To force a lower instruction set tier, call:
+//
+//        KernelTier SetKernelTier(KernelTier tier)
+//
+// or set the UNICODECONVATLSTD_KERNEL_TIER environment variable.
+//
+//------------------------------------------------------------------------------
+//
+// The MIT License(MIT)
+//
+// Copyright(c) 2010-2023 by Giovanni Dicanio
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//------------------------------------------------------------------------------
+
+
+//==============================================================================
+//                              Includes
+//==============================================================================
+
+#include <cstddef>      // std::size_t
+#include <cstdint>      // std::uint64_t
+#include <cstdlib>      // std::abort
+#include <cstring>      // std::memcpy
+#include <iterator>     // std::data, std::size
+#include <memory>       // std::allocator
+#include <stdexcept>    // std::runtime_error
+#include <string>       // std::string, std::u16string
+#include <string_view>  // std::string_view, std::u16string_view
+#include <type_traits>  // std::enable_if_t, std::is_same_v
+#include <utility>      // std::declval, std::move
+#include <vector>       // std::vector
+
+#if __has_include(<version>)
+#include <version>      // __cpp_lib_span, __cpp_lib_string_resize_and_overwrite, __cpp_lib_expected,
+                        // __cpp_lib_memory_resource
+#endif
+#if defined(__cpp_lib_span)
+#include <span>         // std::span
+#endif
+#if defined(__cpp_lib_expected)
+#include <expected>     // std::expected
+#endif
+#if defined(__cpp_lib_memory_resource)
+#include <memory_resource>  // std::pmr::memory_resource, std::pmr::string
+#endif
+
+#include "UnicodeConvSimd.hpp"  // Vectorized kernels
+
+
+//==============================================================================
+//                              Implementation
+//==============================================================================
+
+namespace UnicodeConvAtlStd {
+
+//------------------------------------------------------------------------------
+// Type of the error codes stored in UnicodeConversionException.
+// This is the same type as the Win32 DWORD.
+//------------------------------------------------------------------------------
+using ErrorCode = unsigned long;
+
+//------------------------------------------------------------------------------
+// Error code for invalid input sequences.
+// This has the same value as the Win32 ERROR_NO_UNICODE_TRANSLATION
+// that the Win32 conversion APIs report in this case.
+//------------------------------------------------------------------------------
+inline constexpr ErrorCode kErrorNoUnicodeTranslation = 1113;
+
+
+//------------------------------------------------------------------------------
+// Kind of invalid input found by a conversion
+//------------------------------------------------------------------------------
+enum class ConversionErrorKind
+{
+    None,               // Not an invalid input error, or unknown
+
+    // UTF-8 input
+    TruncatedSequence,  // A lead char not followed by enough continuation chars
+    OverlongEncoding,   // A code point encoded with more chars than needed
+    SurrogateInUtf8,    // An encoded surrogate code point (U+D800..U+DFFF)
+    CodePointTooLarge,  // A code point beyond U+10FFFF
+    InvalidByte,        // A continuation char without a lead, or 0xF8..0xFF
+
+    // UTF-16 input
+    LoneHighSurrogate,  // A high surrogate not followed by a low surrogate
+    LoneLowSurrogate    // A low surrogate not preceded by a high surrogate
+};
+
+
+//------------------------------------------------------------------------------
+// Return a short description of a kind of invalid input
+//------------------------------------------------------------------------------
+[[nodiscard]] inline const char* GetConversionErrorKindName(ConversionErrorKind kind) noexcept
+{
+    switch (kind)
+    {
+    case ConversionErrorKind::None:              return "unknown error";
+    case ConversionErrorKind::TruncatedSequence: return "truncated sequence";
+    case ConversionErrorKind::OverlongEncoding:  return "overlong encoding";
+    case ConversionErrorKind::SurrogateInUtf8:   return "encoded surrogate";
+    case ConversionErrorKind::CodePointTooLarge: return "code point beyond U+10FFFF";
+    case ConversionErrorKind::InvalidByte:       return "invalid byte";
+    case ConversionErrorKind::LoneHighSurrogate: return "lone high surrogate";
+    case ConversionErrorKind::LoneLowSurrogate:  return "lone low surrogate";
+    }
+    return "unknown error";
+}
+
+
+//------------------------------------------------------------------------------
+// Represents an error during Unicode conversions
+//------------------------------------------------------------------------------
+class UnicodeConversionException
+    : public std::runtime_error
+{
+public:
+
+    enum class ConversionType
+    {
+        FromUtf16ToUtf8,
+        FromUtf8ToUtf16,
+
+        // Validated copies of text files between the byte orders
+        // of UTF-16, or of UTF-8 (see UnicodeConvFile.hpp)
+        FromUtf16ToUtf16,
+        FromUtf8ToUtf8
+    };
+
+    UnicodeConversionException(ErrorCode errorCode, ConversionType conversionType, const char* message)
+        : std::runtime_error(message),
+        m_errorCode(errorCode),
+        m_conversionType(conversionType)
+    {
+    }
+
+    UnicodeConversionException(ErrorCode errorCode, ConversionType conversionType, const std::string& message)
+        : std::runtime_error(message),
+        m_errorCode(errorCode),
+        m_conversionType(conversionType)
+    {
+    }
+
+    UnicodeConversionException(ErrorCode errorCode, ConversionType conversionType, const std::string& message,
+                               std::size_t errorOffset, ConversionErrorKind errorKind)
+        : std::runtime_error(message),
+        m_errorCode(errorCode),
+        m_conversionType(conversionType),
+        m_errorOffset(errorOffset),
+        m_errorKind(errorKind)
+    {
+    }
+
+    [[nodiscard]] ErrorCode GetErrorCode() const noexcept
+    {
+        return m_errorCode;
+    }
+
+    [[nodiscard]] ConversionType GetConversionType() const noexcept
+    {
+        return m_conversionType;
+    }
+
+    // Offset of the first invalid code unit in the input
+    // (meaningful only if GetErrorKind() is not None)
+    [[nodiscard]] std::size_t GetErrorOffset() const noexcept
+    {
+        return m_errorOffset;
+    }
+
+    [[nodiscard]] ConversionErrorKind GetErrorKind() const noexcept
+    {
+        return m_errorKind;
+    }
+
+private:
+    ErrorCode m_errorCode;
+    ConversionType m_conversionType;
+    std::size_t m_errorOffset = 0;
+    ConversionErrorKind m_errorKind = ConversionErrorKind::None;
+};
+
+
+//------------------------------------------------------------------------------
+// Outcome of a conversion into a buffer
+//------------------------------------------------------------------------------
+enum class ConversionStatus
+{
+    Ok,
+    InvalidInput,
+    TargetTooSmall
+};
+
+struct ConversionResult
+{
+    ConversionStatus status;
+
+    // Number of input code units consumed.
+    // With InvalidInput, this is the offset of the first invalid input code unit.
+    // With TargetTooSmall, the input was converted up to here: the conversion
+    // can be resumed from this offset with more room.
+    std::size_t unitsRead;
+
+    // Number of output code units written
+    std::size_t unitsWritten;
+};
+
+
+//------------------------------------------------------------------------------
+// What the conversions do with invalid input
+//------------------------------------------------------------------------------
+enum class ErrorPolicy
+{
+    // Reject it, as WC_ERR_INVALID_CHARS/MB_ERR_INVALID_CHARS
+    Strict,
+
+    // Replace each invalid sequence (in UTF-8, each maximal subpart of a
+    // sequence, as in the WHATWG Encoding Standard), and each unpaired
+    // surrogate, with U+FFFD REPLACEMENT CHARACTER
+    Replace
+};
+
+
+//------------------------------------------------------------------------------
+// Error of the non-throwing conversions.
+// It's a plain value: reporting it doesn't allocate memory.
+//------------------------------------------------------------------------------
+struct ConversionError
+{
+    // InvalidInput, or TargetTooSmall if the output is too long
+    // for the destination string type
+    ConversionStatus status;
+
+    UnicodeConversionException::ConversionType conversionType;
+
+    // With InvalidInput, the offset of the first invalid input code unit,
+    // and what is wrong there
+    std::size_t offset;
+    ConversionErrorKind kind;
+};
+
+
+//------------------------------------------------------------------------------
+// Outcome of the non-throwing conversions: the converted string,
+// or a ConversionError.
+// This is std::expected when available (C++23); otherwise, a minimal class
+// with the part of its interface that doesn't throw: has_value(),
+// operator bool, operator*, operator-> and error().
+//------------------------------------------------------------------------------
+#if defined(__cpp_lib_expected)
+
+template <typename T>
+using ConversionExpected = std::expected<T, ConversionError>;
+
+#else
+
+template <typename T>
+class ConversionExpected
+{
+public:
+
+    ConversionExpected(const T& value)
+        : m_value(value),
+        m_error(),
+        m_hasValue(true)
+    {
+    }
+
+    ConversionExpected(T&& value) noexcept
+        : m_value(std::move(value)),
+        m_error(),
+        m_hasValue(true)
+    {
+    }
+
+    explicit ConversionExpected(const ConversionError& error) noexcept
+        : m_value(),
+        m_error(error),
+        m_hasValue(false)
+    {
+    }
+
+    [[nodiscard]] bool has_value() const noexcept
+    {
+        return m_hasValue;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_hasValue;
+    }
+
+    // These require has_value()
+    [[nodiscard]] T& operator*() & noexcept { return m_value; }
+    [[nodiscard]] const T& operator*() const& noexcept { return m_value; }
+    [[nodiscard]] T&& operator*() && noexcept { return std::move(m_value); }
+    [[nodiscard]] T* operator->() noexcept { return &m_value; }
+    [[nodiscard]] const T* operator->() const noexcept { return &m_value; }
+
+    // This requires !has_value()
+    [[nodiscard]] const ConversionError& error() const noexcept
+    {
+        return m_error;
+    }
+
+private:
+    T m_value;
+    ConversionError m_error;
+    bool m_hasValue;
+};
+
+#endif // __cpp_lib_expected
+
+
+//------------------------------------------------------------------------------
+// Result of a batch conversion (Arrow-style): the conversions of all
+// the strings, back to back in a single string, and their offsets in it.
+// String i is data[offsets[i], offsets[i + 1]).
+//------------------------------------------------------------------------------
+template <typename StringType>
+struct ConversionBatch
+{
+    using CodeUnit = typename StringType::value_type;
+
+    // The converted strings, back to back
+    StringType data;
+
+    // Offset of each converted string in data, plus the final length of data
+    std::vector<std::size_t> offsets;
+
+    // Number of strings in the batch
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    // View string 'index' of the batch
+    [[nodiscard]] std::basic_string_view<CodeUnit> operator[](std::size_t index) const noexcept
+    {
+        return std::basic_string_view<CodeUnit>(data.data() + offsets[index], offsets[index + 1] - offsets[index]);
+    }
+};
+
+using Utf8Batch = ConversionBatch<std::string>;
+using Utf16Batch = ConversionBatch<std::u16string>;
+
+
+namespace Details
+{
+
+//------------------------------------------------------------------------------
+// Worst-case number of UTF-8 chars produced by a single UTF-16 code unit.
+// BMP code points (1 wchar_t) take at most 3 chars; supplementary code points
+// (2 wchar_ts, i.e. a surrogate pair) take 4 chars, so 3 per unit is an
+// upper bound in every case.
+//------------------------------------------------------------------------------
+inline constexpr std::size_t kMaxUtf8CharsPerUtf16Unit = 3;
+
+
+//------------------------------------------------------------------------------
+// Convert the leading ASCII code units of UTF-16 text to UTF-8, checking 4 code units
+// per 64-bit word. Stops at the first non-ASCII code unit, and returns
+// the number of code units converted (each one to a single char).
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t ConvertAsciiPrefixUtf16ToUtf8(
+    const char16_t* src, std::size_t srcLength, char* dst) noexcept
+{
+    constexpr std::uint64_t kNonAsciiBits = 0xFF80FF80FF80FF80ULL;
+
+    std::size_t read = 0;
+
+    // Copy each word to a local block first: the compiler can then narrow it
+    // in registers, without worrying that dst could alias src
+    while (srcLength - read >= 4)
+    {
+        char16_t block[4];
+        std::memcpy(block, src + read, sizeof(block));
+
+        std::uint64_t word = 0;
+        std::memcpy(&word, block, sizeof(word));
+        if ((word & kNonAsciiBits) != 0)
+        {
+            break;
+        }
+
+        for (std::size_t i = 0; i < 4; i++)
+        {
+            dst[read + i] = static_cast<char>(block[i]);
+        }
+        read += 4;
+    }
+
+    while (read < srcLength && src[read] < 0x80)
+    {
+        dst[read] = static_cast<char>(src[read]);
+        read++;
+    }
+
+    return read;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert the leading ASCII chars of UTF-8 text to UTF-16, checking 8 chars
+// per 64-bit word. Stops at the first non-ASCII char, and returns
+// the number of chars converted (each one to a single code unit).
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t ConvertAsciiPrefixUtf8ToUtf16(
+    const char* src, std::size_t srcLength, char16_t* dst) noexcept
+{
+    constexpr std::uint64_t kNonAsciiBits = 0x8080808080808080ULL;
+
+    std::size_t read = 0;
+
+    while (srcLength - read >= 8)
+    {
+        unsigned char block[8];
+        std::memcpy(block, src + read, sizeof(block));
+
+        std::uint64_t word = 0;
+        std::memcpy(&word, block, sizeof(word));
+        if ((word & kNonAsciiBits) != 0)
+        {
+            break;
+        }
+
+        for (std::size_t i = 0; i < 8; i++)
+        {
+            dst[read + i] = block[i];
+        }
+        read += 8;
+    }
+
+    while (read < srcLength && static_cast<unsigned char>(src[read]) < 0x80)
+    {
+        dst[read] = static_cast<unsigned char>(src[read]);
+        read++;
+    }
+
+    return read;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert UTF-16 to UTF-8 in a single pass.
+// The destination buffer must have room for at least
+// kMaxUtf8CharsPerUtf16Unit * srcLength chars.
+// Unpaired surrogates are rejected, as with WC_ERR_INVALID_CHARS.
+// If readLimit is specified, the conversion stops at the first code point
+// boundary at or after that many code units.
+//------------------------------------------------------------------------------
+[[nodiscard]] constexpr ConversionResult ConvertUtf16ToUtf8Scalar(
+    const char16_t* src, std::size_t srcLength, char* dst,
+    std::size_t readLimit = static_cast<std::size_t>(-1)) noexcept
+{
+    std::size_t read = 0;
+    char* out = dst;
+
+    if (readLimit > srcLength)
+    {
+        readLimit = srcLength;
+    }
+
+    while (read < readLimit)
+    {
+        const char32_t unit = src[read];
+
+        if (unit < 0x80)
+        {
+            *out++ = static_cast<char>(unit);
+            read++;
+        }
+        else if (unit < 0x800)
+        {
+            *out++ = static_cast<char>(0xC0 | (unit >> 6));
+            *out++ = static_cast<char>(0x80 | (unit & 0x3F));
+            read++;
+        }
+        else if (unit < 0xD800 || unit > 0xDFFF)
+        {
+            *out++ = static_cast<char>(0xE0 | (unit >> 12));
+            *out++ = static_cast<char>(0x80 | ((unit >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (unit & 0x3F));
+            read++;
+        }
+        else
+        {
+            // A high surrogate must be immediately followed by a low surrogate
+            if (unit > 0xDBFF
+                || read + 1 == srcLength
+                || (src[read + 1] & 0xFC00) != 0xDC00)
+            {
+                return { ConversionStatus::InvalidInput, read,
+                         static_cast<std::size_t>(out - dst) };
+            }
+
+            const char32_t codePoint = 0x10000
+                + ((unit - 0xD800) << 10)
+                + (static_cast<char32_t>(src[read + 1]) - 0xDC00);
+
+            *out++ = static_cast<char>(0xF0 | (codePoint >> 18));
+            *out++ = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            *out++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+            read += 2;
+        }
+    }
+
+    return { ConversionStatus::Ok, read, static_cast<std::size_t>(out - dst) };
+}
+
+
+//------------------------------------------------------------------------------
+// Decode the UTF-8 sequence starting at src[0], with 'available' chars
+// (at least 1) left in the input.
+// Returns the length of the sequence in chars, storing the decoded
+// code point in codePoint, or 0 if the sequence is invalid.
+// Overlong forms, encoded surrogates, code points beyond U+10FFFF
+// and truncated sequences are rejected, as with MB_ERR_INVALID_CHARS.
+//------------------------------------------------------------------------------
+[[nodiscard]] constexpr std::size_t DecodeUtf8Sequence(
+    const char* src, std::size_t available, char32_t& codePoint) noexcept
+{
+    const auto lead = static_cast<unsigned char>(src[0]);
+
+    std::size_t length = 0;
+    char32_t minCodePoint = 0;
+    if (lead < 0x80)
+    {
+        codePoint = lead;
+        return 1;
+    }
+    else if ((lead & 0xE0) == 0xC0)
+    {
+        length = 2;
+        minCodePoint = 0x80;
+        codePoint = lead & 0x1F;
+    }
+    else if ((lead & 0xF0) == 0xE0)
+    {
+        length = 3;
+        minCodePoint = 0x800;
+        codePoint = lead & 0x0F;
+    }
+    else if ((lead & 0xF8) == 0xF0)
+    {
+        length = 4;
+        minCodePoint = 0x10000;
+        codePoint = lead & 0x07;
+    }
+    else
+    {
+        // Continuation byte or invalid lead byte
+        return 0;
+    }
+
+    if (available < length)
+    {
+        return 0;
+    }
+
+    for (std::size_t i = 1; i < length; i++)
+    {
+        const auto trail = static_cast<unsigned char>(src[i]);
+        if ((trail & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+        codePoint = (codePoint << 6) | (trail & 0x3F);
+    }
+
+    if (codePoint < minCodePoint
+        || codePoint > 0x10FFFF
+        || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+    {
+        return 0;
+    }
+
+    return length;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert UTF-8 to UTF-16 in a single pass.
+// The destination buffer must have room for at least srcLength char16_ts:
+// a UTF-8 string never has more UTF-16 code units than it has chars.
+// If readLimit is specified, the conversion stops at the first sequence
+// boundary at or after that many chars.
+//------------------------------------------------------------------------------
+[[nodiscard]] constexpr ConversionResult ConvertUtf8ToUtf16Scalar(
+    const char* src, std::size_t srcLength, char16_t* dst,
+    std::size_t readLimit = static_cast<std::size_t>(-1)) noexcept
+{
+    std::size_t read = 0;
+    char16_t* out = dst;
+
+    if (readLimit > srcLength)
+    {
+        readLimit = srcLength;
+    }
+
+    while (read < readLimit)
+    {
+        const auto lead = static_cast<unsigned char>(src[read]);
+        if (lead < 0x80)
+        {
+            *out++ = lead;
+            read++;
+            continue;
+        }
+
+        char32_t codePoint = 0;
+        const std::size_t length = DecodeUtf8Sequence(src + read, srcLength - read, codePoint);
+        if (length == 0)
+        {
+            return { ConversionStatus::InvalidInput, read,
+                     static_cast<std::size_t>(out - dst) };
+        }
+
+        if (codePoint < 0x10000)
+        {
+            *out++ = static_cast<char16_t>(codePoint);
+        }
+        else
+        {
+            codePoint -= 0x10000;
+            *out++ = static_cast<char16_t>(0xD800 + (codePoint >> 10));
+            *out++ = static_cast<char16_t>(0xDC00 + (codePoint & 0x3FF));
+        }
+        read += length;
+    }
+
+    return { ConversionStatus::Ok, read, static_cast<std::size_t>(out - dst) };
+}
+
+
+//------------------------------------------------------------------------------
+// Drive a conversion: let the vectorized kernel convert as much as it can,
+// then let the scalar code convert (or reject) what the kernel couldn't,
+// and repeat.
+//------------------------------------------------------------------------------
+template <typename SrcChar, typename DstChar, typename Kernel, typename Scalar>
+[[nodiscard]] inline ConversionResult RunConversionEngine(
+    const SrcChar* src, std::size_t srcLength, DstChar* dst,
+    Kernel kernel, Scalar scalar) noexcept
+{
+    // Number of code units the scalar code converts after the vectorized kernel
+    // stopped on a block it can't handle, before giving the kernel another try.
+    // The stride grows while the kernel keeps failing to make progress
+    // (e.g. on text it has no vectorized path for), to limit the retry overhead.
+    constexpr std::size_t kMinScalarStride = 16;
+    constexpr std::size_t kMaxScalarStride = 1024;
+    std::size_t scalarStride = kMinScalarStride;
+
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    while (read < srcLength)
+    {
+        const KernelProgress progress = kernel(src + read, srcLength - read, dst + written);
+        read += progress.unitsRead;
+        written += progress.unitsWritten;
+
+        if (read == srcLength)
+        {
+            break;
+        }
+
+        if (progress.unitsRead < kMinScalarStride)
+        {
+            scalarStride = (scalarStride < kMaxScalarStride) ? scalarStride * 2 : kMaxScalarStride;
+        }
+        else
+        {
+            scalarStride = kMinScalarStride;
+        }
+
+        const ConversionResult result = scalar(src + read, srcLength - read, dst + written, scalarStride);
+        read += result.unitsRead;
+        written += result.unitsWritten;
+
+        if (result.status != ConversionStatus::Ok)
+        {
+            return { result.status, read, written };
+        }
+    }
+
+    return { ConversionStatus::Ok, read, written };
+}
+
+
+//------------------------------------------------------------------------------
+// The conversion engine entry points convert the leading ASCII code units
+// word at a time: for short strings (e.g. identifiers), that's usually
+// the whole conversion. Past this many code units, long ASCII runs are left
+// to the vectorized kernels, if any, as they are faster on them.
+//------------------------------------------------------------------------------
+inline constexpr std::size_t kMaxAsciiPrefixBeforeKernel = 64;
+
+
+//------------------------------------------------------------------------------
+// Conversion engine entry points, using the kernels of the selected tier.
+// The destination buffer sizing requirements are the same as for the
+// scalar functions above.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionResult ConvertUtf16ToUtf8(
+    const char16_t* src, std::size_t srcLength, char* dst) noexcept
+{
+    const auto kernel = GetKernelTable().utf16ToUtf8;
+
+    const std::size_t asciiLength = ConvertAsciiPrefixUtf16ToUtf8(
+        src,
+        (kernel != nullptr && srcLength > kMaxAsciiPrefixBeforeKernel) ? kMaxAsciiPrefixBeforeKernel : srcLength,
+        dst);
+    if (asciiLength == srcLength)
+    {
+        return { ConversionStatus::Ok, asciiLength, asciiLength };
+    }
+
+    const ConversionResult result = (kernel == nullptr)
+        ? ConvertUtf16ToUtf8Scalar(src + asciiLength, srcLength - asciiLength, dst + asciiLength)
+        : RunConversionEngine(src + asciiLength, srcLength - asciiLength, dst + asciiLength,
+                              kernel, ConvertUtf16ToUtf8Scalar);
+
+    return { result.status, asciiLength + result.unitsRead, asciiLength + result.unitsWritten };
+}
+
+[[nodiscard]] inline ConversionResult ConvertUtf8ToUtf16(
+    const char* src, std::size_t srcLength, char16_t* dst) noexcept
+{
+    const auto kernel = GetKernelTable().utf8ToUtf16;
+
+    const std::size_t asciiLength = ConvertAsciiPrefixUtf8ToUtf16(
+        src,
+        (kernel != nullptr && srcLength > kMaxAsciiPrefixBeforeKernel) ? kMaxAsciiPrefixBeforeKernel : srcLength,
+        dst);
+    if (asciiLength == srcLength)
+    {
+        return { ConversionStatus::Ok, asciiLength, asciiLength };
+    }
+
+    const ConversionResult result = (kernel == nullptr)
+        ? ConvertUtf8ToUtf16Scalar(src + asciiLength, srcLength - asciiLength, dst + asciiLength)
+        : RunConversionEngine(src + asciiLength, srcLength - asciiLength, dst + asciiLength,
+                              kernel, ConvertUtf8ToUtf16Scalar);
+
+    return { result.status, asciiLength + result.unitsRead, asciiLength + result.unitsWritten };
+}
+
+
+//------------------------------------------------------------------------------
+// Return the largest length, not above chunkLength, at which UTF-16 text
+// can be split without separating a surrogate pair
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t Utf16ChunkBoundary(
+    const char16_t* src, std::size_t srcLength, std::size_t chunkLength) noexcept
+{
+    if (chunkLength >= srcLength)
+    {
+        return srcLength;
+    }
+
+    if (chunkLength > 0 && (src[chunkLength - 1] & 0xFC00) == 0xD800)
+    {
+        return chunkLength - 1;
+    }
+
+    return chunkLength;
+}
+
+
+//------------------------------------------------------------------------------
+// Return the number of chars at the end of UTF-8 text that start
+// a sequence which is not complete (0 to 3)
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t Utf8IncompleteTailLength(
+    const char* src, std::size_t srcLength) noexcept
+{
+    // Find the lead of the last sequence:
+    // sequences are at most 4 chars long
+    for (std::size_t back = 1; back <= 3 && back <= srcLength; back++)
+    {
+        const auto ch = static_cast<unsigned char>(src[srcLength - back]);
+        if ((ch & 0xC0) == 0x80)
+        {
+            continue;
+        }
+
+        const std::size_t sequenceLength = (ch >= 0xF0) ? 4 : (ch >= 0xE0) ? 3 : (ch >= 0xC0) ? 2 : 1;
+        return (sequenceLength > back) ? back : 0;
+    }
+
+    // Complete, or not a valid sequence anyway: let the conversion report it
+    return 0;
+}
+
+
+//------------------------------------------------------------------------------
+// Return true if the chars of an incomplete UTF-8 sequence (a lead,
+// and at most 2 continuation chars) can still be completed into a valid one:
+// a lead that can't start a sequence, or a second char out of the range
+// allowed by the lead, is invalid whatever follows
+//------------------------------------------------------------------------------
+[[nodiscard]] inline bool Utf8SequenceCanBeCompleted(
+    const char* src, std::size_t srcLength) noexcept
+{
+    const auto lead = static_cast<unsigned char>(src[0]);
+    if (lead < 0xC2 || lead > 0xF4)
+    {
+        return false;
+    }
+
+    if (srcLength > 1)
+    {
+        const auto second = static_cast<unsigned char>(src[1]);
+        const unsigned char lowest = (lead == 0xE0) ? 0xA0 : (lead == 0xF0) ? 0x90 : 0x80;
+        const unsigned char highest = (lead == 0xED) ? 0x9F : (lead == 0xF4) ? 0x8F : 0xBF;
+        if (second < lowest || second > highest)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
+// Return the largest length, not above chunkLength, at which UTF-8 text
+// can be split without separating the chars of a sequence
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t Utf8ChunkBoundary(
+    const char* src, std::size_t srcLength, std::size_t chunkLength) noexcept
+{
+    if (chunkLength >= srcLength)
+    {
+        return srcLength;
+    }
+
+    return chunkLength - Utf8IncompleteTailLength(src, chunkLength);
+}
+
+
+//------------------------------------------------------------------------------
+// Convert UTF-16 to UTF-8 into a destination buffer of limited capacity.
+// Converts whole code points as long as they fit; if some input is left,
+// the status is TargetTooSmall.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionResult ConvertUtf16ToUtf8Bounded(
+    const char16_t* src, std::size_t srcLength, char* dst, std::size_t dstCapacity) noexcept
+{
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    // Convert chunks that are sure to fit, even in the worst case
+    for (;;)
+    {
+        const std::size_t chunkLength = Utf16ChunkBoundary(
+            src + read, srcLength - read, (dstCapacity - written) / kMaxUtf8CharsPerUtf16Unit);
+        if (chunkLength == 0)
+        {
+            break;
+        }
+
+        const ConversionResult result = ConvertUtf16ToUtf8(src + read, chunkLength, dst + written);
+        read += result.unitsRead;
+        written += result.unitsWritten;
+
+        if (result.status != ConversionStatus::Ok || read == srcLength)
+        {
+            return { result.status, read, written };
+        }
+    }
+
+    // Then convert one code point at a time, while it fits
+    while (read < srcLength)
+    {
+        char codePointChars[4];
+        const ConversionResult result = ConvertUtf16ToUtf8Scalar(
+            src + read, srcLength - read, codePointChars, 1);
+        if (result.status != ConversionStatus::Ok)
+        {
+            return { result.status, read, written };
+        }
+        if (result.unitsWritten > dstCapacity - written)
+        {
+            return { ConversionStatus::TargetTooSmall, read, written };
+        }
+
+        std::memcpy(dst + written, codePointChars, result.unitsWritten);
+        read += result.unitsRead;
+        written += result.unitsWritten;
+    }
+
+    return { ConversionStatus::Ok, read, written };
+}
+
+
+//------------------------------------------------------------------------------
+// Convert UTF-8 to UTF-16 into a destination buffer of limited capacity.
+// Converts whole code points as long as they fit; if some input is left,
+// the status is TargetTooSmall.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionResult ConvertUtf8ToUtf16Bounded(
+    const char* src, std::size_t srcLength, char16_t* dst, std::size_t dstCapacity) noexcept
+{
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    // Convert chunks that are sure to fit, even in the worst case
+    for (;;)
+    {
+        const std::size_t chunkLength = Utf8ChunkBoundary(
+            src + read, srcLength - read, dstCapacity - written);
+        if (chunkLength == 0)
+        {
+            break;
+        }
+
+        const ConversionResult result = ConvertUtf8ToUtf16(src + read, chunkLength, dst + written);
+        read += result.unitsRead;
+        written += result.unitsWritten;
+
+        if (result.status != ConversionStatus::Ok || read == srcLength)
+        {
+            return { result.status, read, written };
+        }
+    }
+
+    // Then convert one code point at a time, while it fits
+    while (read < srcLength)
+    {
+        char16_t codePointUnits[2];
+        const ConversionResult result = ConvertUtf8ToUtf16Scalar(
+            src + read, srcLength - read, codePointUnits, 1);
+        if (result.status != ConversionStatus::Ok)
+        {
+            return { result.status, read, written };
+        }
+        if (result.unitsWritten > dstCapacity - written)
+        {
+            return { ConversionStatus::TargetTooSmall, read, written };
+        }
+
+        std::memcpy(dst + written, codePointUnits, result.unitsWritten * sizeof(char16_t));
+        read += result.unitsRead;
+        written += result.unitsWritten;
+    }
+
+    return { ConversionStatus::Ok, read, written };
+}
+
+
+//------------------------------------------------------------------------------
+// Return the length of the maximal subpart of the invalid UTF-8 sequence
+// starting at src[0], with 'available' chars (at least 1) left in the input:
+// the longest prefix of a valid sequence it starts with, or 1 char.
+// Each maximal subpart is replaced by a single U+FFFD.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t Utf8MaximalSubpartLength(const char* src, std::size_t available) noexcept
+{
+    const auto lead = static_cast<unsigned char>(src[0]);
+
+    // The range of the second char depends on the lead,
+    // to exclude overlong forms, surrogates and code points beyond U+10FFFF
+    std::size_t sequenceLength = 0;
+    unsigned char secondMin = 0x80;
+    unsigned char secondMax = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF)
+    {
+        sequenceLength = 2;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        sequenceLength = 3;
+        secondMin = (lead == 0xE0) ? 0xA0 : 0x80;
+        secondMax = (lead == 0xED) ? 0x9F : 0xBF;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        sequenceLength = 4;
+        secondMin = (lead == 0xF0) ? 0x90 : 0x80;
+        secondMax = (lead == 0xF4) ? 0x8F : 0xBF;
+    }
+    else
+    {
+        return 1;
+    }
+
+    std::size_t length = 1;
+    while (length < sequenceLength && length < available)
+    {
+        const auto ch = static_cast<unsigned char>(src[length]);
+        if (ch < ((length == 1) ? secondMin : 0x80) || ch > ((length == 1) ? secondMax : 0xBF))
+        {
+            break;
+        }
+        length++;
+    }
+
+    return length;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert UTF-8 to UTF-16 into a destination buffer of limited capacity,
+// replacing invalid input with U+FFFD, and adding the number
+// of replacements to replacementCount.
+// Valid runs are converted by the strict (vectorized) conversion, which stops
+// at each error: the status is Ok, or TargetTooSmall as in the Bounded one.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionResult ConvertUtf8ToUtf16Replacing(
+    const char* src, std::size_t srcLength, char16_t* dst, std::size_t dstCapacity,
+    std::size_t& replacementCount) noexcept
+{
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    for (;;)
+    {
+        const ConversionResult result = ConvertUtf8ToUtf16Bounded(
+            src + read, srcLength - read, dst + written, dstCapacity - written);
+        read += result.unitsRead;
+        written += result.unitsWritten;
+
+        if (result.status != ConversionStatus::InvalidInput)
+        {
+            return { result.status, read, written };
+        }
+        if (written == dstCapacity)
+        {
+            return { ConversionStatus::TargetTooSmall, read, written };
+        }
+
+        dst[written++] = u'\xFFFD';
+        read += Utf8MaximalSubpartLength(src + read, srcLength - read);
+        replacementCount++;
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Convert UTF-16 to UTF-8 into a destination buffer of limited capacity,
+// replacing each unpaired surrogate with U+FFFD, as ConvertUtf8ToUtf16Replacing
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionResult ConvertUtf16ToUtf8Replacing(
+    const char16_t* src, std::size_t srcLength, char* dst, std::size_t dstCapacity,
+    std::size_t& replacementCount) noexcept
+{
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    for (;;)
+    {
+        const ConversionResult result = ConvertUtf16ToUtf8Bounded(
+            src + read, srcLength - read, dst + written, dstCapacity - written);
+        read += result.unitsRead;
+        written += result.unitsWritten;
+
+        if (result.status != ConversionStatus::InvalidInput)
+        {
+            return { result.status, read, written };
+        }
+        if (dstCapacity - written < 3)
+        {
+            return { ConversionStatus::TargetTooSmall, read, written };
+        }
+
+        // U+FFFD in UTF-8
+        dst[written++] = static_cast<char>(0xEF);
+        dst[written++] = static_cast<char>(0xBF);
+        dst[written++] = static_cast<char>(0xBD);
+        read++;
+        replacementCount++;
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Return the offset of the first invalid UTF-8 sequence, or srcLength
+// if the text is valid, with the same rules as the conversions
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t FindUtf8ErrorScalar(const char* src, std::size_t srcLength) noexcept
+{
+    std::size_t read = 0;
+    while (read < srcLength)
+    {
+        if (static_cast<unsigned char>(src[read]) < 0x80)
+        {
+            read++;
+            continue;
+        }
+
+        char32_t codePoint = 0;
+        const std::size_t length = DecodeUtf8Sequence(src + read, srcLength - read, codePoint);
+        if (length == 0)
+        {
+            return read;
+        }
+        read += length;
+    }
+
+    return srcLength;
+}
+
+
+//------------------------------------------------------------------------------
+// Return the offset of the first unpaired surrogate, or srcLength
+// if the text is valid UTF-16
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t FindUtf16ErrorScalar(const char16_t* src, std::size_t srcLength) noexcept
+{
+    std::size_t read = 0;
+    while (read < srcLength)
+    {
+        const char16_t unit = src[read];
+        if ((unit & 0xF800) != 0xD800)
+        {
+            read++;
+            continue;
+        }
+
+        if (unit > 0xDBFF
+            || read + 1 == srcLength
+            || (src[read + 1] & 0xFC00) != 0xDC00)
+        {
+            return read;
+        }
+        read += 2;
+    }
+
+    return srcLength;
+}
+
+
+//------------------------------------------------------------------------------
+// Validation entry points, using the kernels of the selected tier:
+// return the offset of the first error, or srcLength if the text is valid
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t FindUtf8Error(const char* src, std::size_t srcLength) noexcept
+{
+    std::size_t valid = 0;
+
+    const auto kernel = GetKernelTable().validateUtf8;
+    if (kernel != nullptr)
+    {
+        // Back off to the start of the last sequence, if it was left incomplete
+        valid = kernel(src, srcLength).unitsRead;
+        valid -= Utf8IncompleteTailLength(src, valid);
+    }
+
+    return valid + FindUtf8ErrorScalar(src + valid, srcLength - valid);
+}
+
+[[nodiscard]] inline std::size_t FindUtf16Error(const char16_t* src, std::size_t srcLength) noexcept
+{
+    std::size_t valid = 0;
+
+    const auto kernel = GetKernelTable().validateUtf16;
+    if (kernel != nullptr)
+    {
+        // Back off to the start of the last surrogate pair, if it was cut
+        valid = kernel(src, srcLength).unitsRead;
+        if (valid > 0 && (src[valid - 1] & 0xFC00) == 0xD800)
+        {
+            valid--;
+        }
+    }
+
+    return valid + FindUtf16ErrorScalar(src + valid, srcLength - valid);
+}
+
+
+//------------------------------------------------------------------------------
+// Return the length of the UTF-16 conversion of UTF-8 text, in unitsWritten,
+// validating it like FindUtf8ErrorScalar, without converting it
+//------------------------------------------------------------------------------
+[[nodiscard]] constexpr ConversionResult MeasureUtf8ToUtf16Scalar(const char* src, std::size_t srcLength) noexcept
+{
+    std::size_t read = 0;
+    std::size_t length = 0;
+    while (read < srcLength)
+    {
+        if (static_cast<unsigned char>(src[read]) < 0x80)
+        {
+            read++;
+            length++;
+            continue;
+        }
+
+        char32_t codePoint = 0;
+        const std::size_t sequenceLength = DecodeUtf8Sequence(src + read, srcLength - read, codePoint);
+        if (sequenceLength == 0)
+        {
+            return { ConversionStatus::InvalidInput, read, length };
+        }
+        read += sequenceLength;
+        length += (codePoint > 0xFFFF) ? 2 : 1;
+    }
+
+    return { ConversionStatus::Ok, read, length };
+}
+
+
+//------------------------------------------------------------------------------
+// Return the length of the UTF-8 conversion of UTF-16 text, in unitsWritten,
+// validating it like FindUtf16ErrorScalar, without converting it
+//------------------------------------------------------------------------------
+[[nodiscard]] constexpr ConversionResult MeasureUtf16ToUtf8Scalar(const char16_t* src, std::size_t srcLength) noexcept
+{
+    std::size_t read = 0;
+    std::size_t length = 0;
+    while (read < srcLength)
+    {
+        const char16_t unit = src[read];
+        if ((unit & 0xF800) != 0xD800)
+        {
+            read++;
+            length += (unit < 0x80) ? 1 : (unit < 0x800) ? 2 : 3;
+            continue;
+        }
+
+        if (unit > 0xDBFF
+            || read + 1 == srcLength
+            || (src[read + 1] & 0xFC00) != 0xDC00)
+        {
+            return { ConversionStatus::InvalidInput, read, length };
+        }
+        read += 2;
+        length += 4;
+    }
+
+    return { ConversionStatus::Ok, read, length };
+}
+
+
+//------------------------------------------------------------------------------
+// Length query entry points, using the kernels of the selected tier.
+// On invalid input, the status is InvalidInput and unitsRead is the offset
+// of the first error; unitsWritten is the length of the conversion
+// of the valid text before it.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionResult MeasureUtf8ToUtf16(const char* src, std::size_t srcLength) noexcept
+{
+    KernelProgress progress = { 0, 0 };
+
+    const auto kernel = GetKernelTable().measureUtf8ToUtf16;
+    if (kernel != nullptr)
+    {
+        // Back off to the start of the last sequence, if it was left incomplete:
+        // its lead was counted, twice if it starts a surrogate pair
+        progress = kernel(src, srcLength);
+        const std::size_t tailLength = Utf8IncompleteTailLength(src, progress.unitsRead);
+        if (tailLength > 0)
+        {
+            progress.unitsRead -= tailLength;
+            progress.unitsWritten -= (static_cast<unsigned char>(src[progress.unitsRead]) >= 0xF0) ? 2 : 1;
+        }
+    }
+
+    const ConversionResult rest = MeasureUtf8ToUtf16Scalar(src + progress.unitsRead, srcLength - progress.unitsRead);
+    return { rest.status, progress.unitsRead + rest.unitsRead, progress.unitsWritten + rest.unitsWritten };
+}
+
+[[nodiscard]] inline ConversionResult MeasureUtf16ToUtf8(const char16_t* src, std::size_t srcLength) noexcept
+{
+    KernelProgress progress = { 0, 0 };
+
+    const auto kernel = GetKernelTable().measureUtf16ToUtf8;
+    if (kernel != nullptr)
+    {
+        // Back off to the start of the last surrogate pair, if it was cut:
+        // its high surrogate was counted as 2 chars
+        progress = kernel(src, srcLength);
+        if (progress.unitsRead > 0 && (src[progress.unitsRead - 1] & 0xFC00) == 0xD800)
+        {
+            progress.unitsRead--;
+            progress.unitsWritten -= 2;
+        }
+    }
+
+    const ConversionResult rest = MeasureUtf16ToUtf8Scalar(src + progress.unitsRead, srcLength - progress.unitsRead);
+    return { rest.status, progress.unitsRead + rest.unitsRead, progress.unitsWritten + rest.unitsWritten };
+}
+
+
+//------------------------------------------------------------------------------
+// Return what is wrong with the invalid UTF-8 sequence starting at src[0],
+// with 'available' chars (at least 1) left in the input
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionErrorKind ClassifyUtf8Error(const char* src, std::size_t available) noexcept
+{
+    const auto lead = static_cast<unsigned char>(src[0]);
+    if ((lead & 0xC0) == 0x80 || lead >= 0xF8)
+    {
+        return ConversionErrorKind::InvalidByte;
+    }
+    if (lead == 0xC0 || lead == 0xC1)
+    {
+        return ConversionErrorKind::OverlongEncoding;
+    }
+    if (lead >= 0xF5)
+    {
+        return ConversionErrorKind::CodePointTooLarge;
+    }
+
+    // The second char tells if 3 and 4-char sequences are out of range
+    if (available > 1 && (static_cast<unsigned char>(src[1]) & 0xC0) == 0x80)
+    {
+        const auto second = static_cast<unsigned char>(src[1]);
+        if ((lead == 0xE0 && second < 0xA0) || (lead == 0xF0 && second < 0x90))
+        {
+            return ConversionErrorKind::OverlongEncoding;
+        }
+        if (lead == 0xED && second >= 0xA0)
+        {
+            return ConversionErrorKind::SurrogateInUtf8;
+        }
+        if (lead == 0xF4 && second >= 0x90)
+        {
+            return ConversionErrorKind::CodePointTooLarge;
+        }
+    }
+
+    // Otherwise, a continuation char is missing
+    return ConversionErrorKind::TruncatedSequence;
+}
+
+
+//------------------------------------------------------------------------------
+// Describe the invalid input found by a conversion at src[offset].
+// This runs only after a conversion failed: the conversions themselves
+// just stop at the first error.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionError DescribeUtf8Error(
+    const char* src, std::size_t srcLength, std::size_t offset) noexcept
+{
+    return { ConversionStatus::InvalidInput, UnicodeConversionException::ConversionType::FromUtf8ToUtf16,
+             offset, ClassifyUtf8Error(src + offset, srcLength - offset) };
+}
+
+[[nodiscard]] inline ConversionError DescribeUtf16Error(const char16_t* src, std::size_t offset) noexcept
+{
+    return { ConversionStatus::InvalidInput, UnicodeConversionException::ConversionType::FromUtf16ToUtf8,
+             offset, ((src[offset] & 0xFC00) == 0xD800) ? ConversionErrorKind::LoneHighSurrogate
+                                                        : ConversionErrorKind::LoneLowSurrogate };
+}
+
+
+//------------------------------------------------------------------------------
+// Throw a UnicodeConversionException for invalid input.
+// In builds without exceptions, abort instead: there, invalid input
+// must be handled with the Try functions.
+//------------------------------------------------------------------------------
+[[noreturn]] inline void ThrowConversionError(const ConversionError& error)
+{
+#if !defined(__cpp_exceptions) && !defined(_CPPUNWIND)
+    static_cast<void>(error);
+    std::abort();
+#else
+    using ConversionType = UnicodeConversionException::ConversionType;
+    const bool isUtf16Input = (error.conversionType == ConversionType::FromUtf16ToUtf8)
+        || (error.conversionType == ConversionType::FromUtf16ToUtf16);
+    const bool isUtf16Output = (error.conversionType == ConversionType::FromUtf8ToUtf16)
+        || (error.conversionType == ConversionType::FromUtf16ToUtf16);
+    const std::string inputName = isUtf16Input ? "UTF-16" : "UTF-8";
+    const std::string outputName = isUtf16Output ? "UTF-16" : "UTF-8";
+
+    throw UnicodeConversionException(
+        kErrorNoUnicodeTranslation,
+        error.conversionType,
+        "Can't convert from " + inputName + " to " + outputName + " string (invalid " + inputName + " input: "
+            + GetConversionErrorKindName(error.kind) + " at offset " + std::to_string(error.offset) + ").",
+        error.offset,
+        error.kind);
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+// Return a ConversionExpected holding an error
+//------------------------------------------------------------------------------
+template <typename T>
+[[nodiscard]] ConversionExpected<T> MakeConversionError(const ConversionError& error) noexcept
+{
+#if defined(__cpp_lib_expected)
+    return std::unexpected(error);
+#else
+    return ConversionExpected<T>(error);
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+// Code unit types of UTF-16 and UTF-8 text.
+// wchar_t holds UTF-16 only where it is 16-bit (e.g. on Windows, not on Linux).
+//------------------------------------------------------------------------------
+template <typename CharType>
+inline constexpr bool kIsUtf16CodeUnit = std::is_same_v<CharType, char16_t>
+    || (std::is_same_v<CharType, wchar_t> && sizeof(wchar_t) == sizeof(char16_t));
+
+template <typename CharType>
+inline constexpr bool kIsUtf8CodeUnit = std::is_same_v<CharType, char>
+#if defined(__cpp_char8_t)
+    || std::is_same_v<CharType, char8_t>
+#endif
+    ;
+
+
+//------------------------------------------------------------------------------
+// Code unit type of a contiguous container or view of text (std::basic_string,
+// std::basic_string_view, std::vector, std::array, std::span...), or void.
+// Arrays are left out: they are string literals, whose size would count
+// the terminating NUL; they convert to the string_view overloads instead.
+//------------------------------------------------------------------------------
+template <typename Text, typename = void>
+struct TextCodeUnit
+{
+    using type = void;
+};
+
+template <typename Text>
+struct TextCodeUnit<Text, std::void_t<decltype(std::data(std::declval<const Text&>())),
+                                      decltype(std::size(std::declval<const Text&>()))>>
+{
+    using type = std::conditional_t<
+        std::is_array_v<Text>,
+        void,
+        std::remove_cv_t<std::remove_pointer_t<decltype(std::data(std::declval<const Text&>()))>>>;
+};
+
+template <typename Text>
+inline constexpr bool kIsUtf16Text = kIsUtf16CodeUnit<typename TextCodeUnit<Text>::type>;
+
+template <typename Text>
+inline constexpr bool kIsUtf8Text = kIsUtf8CodeUnit<typename TextCodeUnit<Text>::type>;
+
+
+//------------------------------------------------------------------------------
+// View a contiguous container of UTF-16 or UTF-8 code units
+// as the code units of the conversion engine
+//------------------------------------------------------------------------------
+template <typename Utf16Text>
+[[nodiscard]] std::u16string_view AsUtf16View(const Utf16Text& utf16) noexcept
+{
+    return std::u16string_view(reinterpret_cast<const char16_t*>(std::data(utf16)), std::size(utf16));
+}
+
+template <typename Utf8Text>
+[[nodiscard]] std::string_view AsUtf8View(const Utf8Text& utf8) noexcept
+{
+    return std::string_view(reinterpret_cast<const char*>(std::data(utf8)), std::size(utf8));
+}
+
+
+//------------------------------------------------------------------------------
+// Release the unused tail of an over-allocated string when it is large
+// compared to the actual content.
+// Strings with other allocators than std::allocator are left as they are:
+// arenas (e.g. std::pmr::monotonic_buffer_resource) don't reuse released
+// memory, so a reallocation would only add to the waste.
+//------------------------------------------------------------------------------
+template <typename StringType>
+inline void ShrinkIfWasteful(StringType& str)
+{
+    using CodeUnit = typename StringType::value_type;
+    if constexpr (std::is_same_v<typename StringType::allocator_type, std::allocator<CodeUnit>>)
+    {
+        // Small strings are not worth a reallocation
+        constexpr std::size_t kMinWaste = 64;
+
+        const std::size_t waste = str.capacity() - str.size();
+        if (waste > kMinWaste && waste > str.size() / 2)
+        {
+            str.shrink_to_fit();
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Resize a string to 'count' code units, and let 'writer' fill the new tail:
+// writer(data, count) returns the final length of the string.
+// With C++23 resize_and_overwrite, the new tail is not initialized first:
+// the output is written only once, and the pages of an over-allocated
+// worst-case tail that the conversion doesn't reach are never touched.
+// Otherwise, resize() fills the new tail before the conversion overwrites it.
+//------------------------------------------------------------------------------
+template <typename StringType, typename Writer>
+inline void ResizeAndOverwrite(StringType& str, std::size_t count, Writer writer)
+{
+#if defined(__cpp_lib_string_resize_and_overwrite)
+    str.resize_and_overwrite(count, writer);
+#else
+    str.resize(count);
+    str.resize(writer(str.data(), count));
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+// Single-pass UTF-16 to UTF-8 conversion appended to a std::string
+// (or another std::basic_string of UTF-8 code units):
+// grow it for the worst case, convert once, trim to the actual length
+// (keeping the capacity, for further appends).
+// On failure, utf8 is restored to its original length.
+// If replacementCount is not null, invalid input is replaced with U+FFFD
+// (which fits the same worst case), counting the replacements there.
+//------------------------------------------------------------------------------
+template <typename Utf8String>
+[[nodiscard]] ConversionResult AppendUtf16ToUtf8SinglePass(
+    std::u16string_view utf16, Utf8String& utf8, std::size_t* replacementCount = nullptr)
+{
+    static_assert(kIsUtf8CodeUnit<typename Utf8String::value_type>,
+                  "The output string must hold UTF-8 code units (char or char8_t)");
+
+    const std::size_t oldLength = utf8.length();
+
+    // Short strings are often pure ASCII (e.g. identifiers), which converts
+    // to the same length: try that first, growing the destination only by
+    // the input length, to spare the worst-case allocation (or fit in the
+    // small string buffer)
+    constexpr std::size_t kMaxShortLength = 64;
+
+    std::size_t asciiLength = 0;
+    if (utf16.length() <= kMaxShortLength)
+    {
+        ResizeAndOverwrite(utf8, oldLength + utf16.length(), [&](auto* data, std::size_t)
+        {
+            asciiLength = ConvertAsciiPrefixUtf16ToUtf8(
+                utf16.data(), utf16.length(), reinterpret_cast<char*>(data) + oldLength);
+            return oldLength + asciiLength;
+        });
+        if (asciiLength == utf16.length())
+        {
+            return { ConversionStatus::Ok, asciiLength, asciiLength };
+        }
+    }
+
+    ConversionResult result{};
+    ResizeAndOverwrite(
+        utf8,
+        oldLength + asciiLength + (utf16.length() - asciiLength) * kMaxUtf8CharsPerUtf16Unit,
+        [&](auto* data, std::size_t)
+        {
+            const std::size_t srcLength = utf16.length() - asciiLength;
+            char* const dst = reinterpret_cast<char*>(data) + oldLength + asciiLength;
+            result = (replacementCount == nullptr)
+                ? ConvertUtf16ToUtf8(utf16.data() + asciiLength, srcLength, dst)
+                : ConvertUtf16ToUtf8Replacing(utf16.data() + asciiLength, srcLength, dst,
+                                              srcLength * kMaxUtf8CharsPerUtf16Unit, *replacementCount);
+            result.unitsRead += asciiLength;
+            result.unitsWritten += asciiLength;
+            return (result.status == ConversionStatus::Ok) ? oldLength + result.unitsWritten : oldLength;
+        });
+
+    return result;
+}
+
+
+//------------------------------------------------------------------------------
+// Single-pass UTF-8 to UTF-16 conversion appended to a std::u16string
+// (or another std::basic_string of UTF-16 code units):
+// grow it by one char16_t per input char, convert once, trim to the actual
+// length (keeping the capacity, for further appends).
+// On failure, utf16 is restored to its original length.
+// If replacementCount is not null, invalid input is replaced with U+FFFD
+// (which fits the same worst case), counting the replacements there.
+//------------------------------------------------------------------------------
+template <typename Utf16String>
+[[nodiscard]] ConversionResult AppendUtf8ToUtf16SinglePass(
+    std::string_view utf8, Utf16String& utf16, std::size_t* replacementCount = nullptr)
+{
+    static_assert(kIsUtf16CodeUnit<typename Utf16String::value_type>,
+                  "The output string must hold UTF-16 code units (char16_t, or 16-bit wchar_t)");
+
+    const std::size_t oldLength = utf16.length();
+
+    ConversionResult result{};
+    ResizeAndOverwrite(utf16, oldLength + utf8.length(), [&](auto* data, std::size_t)
+    {
+        char16_t* const dst = reinterpret_cast<char16_t*>(data) + oldLength;
+        result = (replacementCount == nullptr)
+            ? ConvertUtf8ToUtf16(utf8.data(), utf8.length(), dst)
+            : ConvertUtf8ToUtf16Replacing(utf8.data(), utf8.length(), dst,
+                                          utf8.length(), *replacementCount);
+        return (result.status == ConversionStatus::Ok) ? oldLength + result.unitsWritten : oldLength;
+    });
+
+    return result;
+}
+
+
+//------------------------------------------------------------------------------
+// Single-pass UTF-16 to UTF-8 conversion into a std::string
+// (or another std::basic_string of UTF-8 code units):
+// allocate for the worst case, convert once, trim.
+// On failure, the content of utf8 is unspecified.
+// replacementCount is as in AppendUtf16ToUtf8SinglePass.
+//------------------------------------------------------------------------------
+template <typename Utf8String>
+[[nodiscard]] ConversionResult Utf16ToUtf8SinglePass(
+    std::u16string_view utf16, Utf8String& utf8, std::size_t* replacementCount = nullptr)
+{
+    utf8.clear();
+    const ConversionResult result = AppendUtf16ToUtf8SinglePass(utf16, utf8, replacementCount);
+    if (result.status == ConversionStatus::Ok)
+    {
+        ShrinkIfWasteful(utf8);
+    }
+
+    return result;
+}
+
+
+//------------------------------------------------------------------------------
+// Single-pass UTF-8 to UTF-16 conversion into a std::u16string
+// (or another std::basic_string of UTF-16 code units):
+// allocate one char16_t per input char, convert once, trim.
+// On failure, the content of utf16 is unspecified.
+// replacementCount is as in AppendUtf8ToUtf16SinglePass.
+//------------------------------------------------------------------------------
+template <typename Utf16String>
+[[nodiscard]] ConversionResult Utf8ToUtf16SinglePass(
+    std::string_view utf8, Utf16String& utf16, std::size_t* replacementCount = nullptr)
+{
+    utf16.clear();
+    const ConversionResult result = AppendUtf8ToUtf16SinglePass(utf8, utf16, replacementCount);
+    if (result.status == ConversionStatus::Ok)
+    {
+        ShrinkIfWasteful(utf16);
+    }
+
+    return result;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 to UTF-8 into an empty string of any UTF-8 string type
+// (whose allocator has been chosen by the caller).
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+template <typename Utf8String>
+void Utf16ToUtf8String(std::u16string_view utf16, Utf8String& utf8)
+{
+    const ConversionResult result = Utf16ToUtf8SinglePass(utf16, utf8);
+    if (result.status != ConversionStatus::Ok)
+    {
+        ThrowConversionError(DescribeUtf16Error(utf16.data(), result.unitsRead));
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 to UTF-16 into an empty string of any UTF-16 string type,
+// as Utf16ToUtf8String
+//------------------------------------------------------------------------------
+template <typename Utf16String>
+void Utf8ToUtf16String(std::string_view utf8, Utf16String& utf16)
+{
+    const ConversionResult result = Utf8ToUtf16SinglePass(utf8, utf16);
+    if (result.status != ConversionStatus::Ok)
+    {
+        ThrowConversionError(DescribeUtf8Error(utf8.data(), utf8.length(), result.unitsRead));
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// String type of the given code unit type, allocated by the given allocator
+//------------------------------------------------------------------------------
+template <typename Allocator>
+using AllocatorString = std::basic_string<
+    typename Allocator::value_type, std::char_traits<typename Allocator::value_type>, Allocator>;
+
+
+//------------------------------------------------------------------------------
+// Convert a batch of strings into a single string, allocated once for
+// the worst case of the whole batch, and trimmed at the end.
+// getString(i) returns string i of the batch as the input view type.
+// Each string is converted by the (vectorized) conversion engine,
+// as a separate piece of text: e.g. a surrogate pair can't span two strings.
+// Signal errors throwing UnicodeConversionException, with the offset
+// of the error in the batch as if its strings were concatenated.
+//------------------------------------------------------------------------------
+template <typename Batch, typename GetString, typename Convert, typename Describe>
+[[nodiscard]] Batch ConvertBatch(
+    std::size_t count, GetString getString, std::size_t maxOutputPerInputUnit, Convert convert, Describe describe)
+{
+    Batch batch;
+    batch.offsets.resize(count + 1);
+
+    std::size_t totalLength = 0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        totalLength += getString(i).length();
+    }
+
+    // The conversion errors are thrown after the output string is resized
+    bool failed = false;
+    ConversionError error{};
+
+    ResizeAndOverwrite(batch.data, totalLength * maxOutputPerInputUnit, [&](auto* data, std::size_t)
+    {
+        std::size_t inputOffset = 0;
+        std::size_t written = 0;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const auto input = getString(i);
+            const ConversionResult result = convert(input.data(), input.length(), data + written);
+            if (result.status != ConversionStatus::Ok)
+            {
+                failed = true;
+                error = describe(input, result.unitsRead);
+                error.offset += inputOffset;
+                return std::size_t{ 0 };
+            }
+
+            batch.offsets[i] = written;
+            written += result.unitsWritten;
+            inputOffset += input.length();
+        }
+        batch.offsets[count] = written;
+        return written;
+    });
+
+    if (failed)
+    {
+        ThrowConversionError(error);
+    }
+    ShrinkIfWasteful(batch.data);
+
+    return batch;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert a batch of UTF-16 strings to UTF-8, as ConvertBatch
+//------------------------------------------------------------------------------
+template <typename GetString>
+[[nodiscard]] Utf8Batch Utf16ToUtf8Batch(std::size_t count, GetString getString)
+{
+    return ConvertBatch<Utf8Batch>(
+        count, getString, kMaxUtf8CharsPerUtf16Unit,
+        [](const char16_t* src, std::size_t srcLength, char* dst) noexcept
+        {
+            return ConvertUtf16ToUtf8(src, srcLength, dst);
+        },
+        [](std::u16string_view utf16, std::size_t offset)
+        {
+            return DescribeUtf16Error(utf16.data(), offset);
+        });
+}
+
+
+//------------------------------------------------------------------------------
+// Convert a batch of UTF-8 strings to UTF-16, as ConvertBatch
+//------------------------------------------------------------------------------
+template <typename GetString>
+[[nodiscard]] Utf16Batch Utf8ToUtf16Batch(std::size_t count, GetString getString)
+{
+    return ConvertBatch<Utf16Batch>(
+        count, getString, 1,
+        [](const char* src, std::size_t srcLength, char16_t* dst) noexcept
+        {
+            return ConvertUtf8ToUtf16(src, srcLength, dst);
+        },
+        [](std::string_view utf8, std::size_t offset)
+        {
+            return DescribeUtf8Error(utf8.data(), utf8.length(), offset);
+        });
+}
+
+} // namespace Details
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 to UTF-8, from any contiguous container or view
+// of UTF-16 code units (std::u16string, std::wstring on Windows,
+// std::vector<char16_t>, std::span...) directly into the given string type
+// (std::string, C++20 std::u8string, or another std::basic_string of char
+// or char8_t), with no intermediate copies.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+template <typename Utf8String = std::string,
+          typename Utf16Text,
+          std::enable_if_t<Details::kIsUtf16Text<Utf16Text>, int> = 0>
+[[nodiscard]] Utf8String Utf16ToUtf8(const Utf16Text& utf16)
+{
+    Utf8String utf8;
+    Details::Utf16ToUtf8String(Details::AsUtf16View(utf16), utf8);
+    return utf8;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 to UTF-16, from any contiguous container or view
+// of UTF-8 code units (std::string, C++20 std::u8string, std::vector<char>...)
+// directly into the given string type (std::u16string, std::wstring on Windows,
+// or another std::basic_string of UTF-16 code units), with no intermediate copies.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+template <typename Utf16String = std::u16string,
+          typename Utf8Text,
+          std::enable_if_t<Details::kIsUtf8Text<Utf8Text>, int> = 0>
+[[nodiscard]] Utf16String Utf8ToUtf16(const Utf8Text& utf8)
+{
+    Utf16String utf16;
+    Details::Utf8ToUtf16String(Details::AsUtf8View(utf8), utf16);
+    return utf16;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 to UTF-8, as above, into a string allocated by the given
+// allocator (e.g. an arena allocator, or a std::pmr::polymorphic_allocator):
+// the string type is the std::basic_string of the allocator value_type
+// (char, or C++20 char8_t).
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+template <typename Utf16Text,
+          typename Allocator,
+          std::enable_if_t<Details::kIsUtf16Text<Utf16Text>
+                               && Details::kIsUtf8CodeUnit<typename Allocator::value_type>, int> = 0>
+[[nodiscard]] Details::AllocatorString<Allocator> Utf16ToUtf8(const Utf16Text& utf16, const Allocator& allocator)
+{
+    Details::AllocatorString<Allocator> utf8(allocator);
+    Details::Utf16ToUtf8String(Details::AsUtf16View(utf16), utf8);
+    return utf8;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 to UTF-16, as above, into a string allocated by the given
+// allocator: the string type is the std::basic_string of the allocator
+// value_type (char16_t, or 16-bit wchar_t).
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+template <typename Utf8Text,
+          typename Allocator,
+          std::enable_if_t<Details::kIsUtf8Text<Utf8Text>
+                               && Details::kIsUtf16CodeUnit<typename Allocator::value_type>, int> = 0>
+[[nodiscard]] Details::AllocatorString<Allocator> Utf8ToUtf16(const Utf8Text& utf8, const Allocator& allocator)
+{
+    Details::AllocatorString<Allocator> utf16(allocator);
+    Details::Utf8ToUtf16String(Details::AsUtf8View(utf8), utf16);
+    return utf16;
+}
+
+
+#if defined(__cpp_lib_memory_resource)
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 to UTF-8 std::pmr::string, allocated from the given
+// memory resource (e.g. a per-request std::pmr::monotonic_buffer_resource,
+// to release all the conversions at once).
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+template <typename Utf16Text,
+          std::enable_if_t<Details::kIsUtf16Text<Utf16Text>, int> = 0>
+[[nodiscard]] std::pmr::string Utf16ToUtf8(const Utf16Text& utf16, std::pmr::memory_resource* resource)
+{
+    return Utf16ToUtf8(utf16, std::pmr::polymorphic_allocator<char>(resource));
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 to UTF-16 std::pmr::u16string, allocated from the given
+// memory resource, as above
+//------------------------------------------------------------------------------
+template <typename Utf8Text,
+          std::enable_if_t<Details::kIsUtf8Text<Utf8Text>, int> = 0>
+[[nodiscard]] std::pmr::u16string Utf8ToUtf16(const Utf8Text& utf8, std::pmr::memory_resource* resource)
+{
+    return Utf8ToUtf16(utf8, std::pmr::polymorphic_allocator<char16_t>(resource));
+}
+
+#endif // __cpp_lib_memory_resource
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 std::u16string_view to UTF-8 std::string.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::string Utf16ToUtf8(std::u16string_view utf16)
+{
+    return Utf16ToUtf8<std::string>(utf16);
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 std::string_view to UTF-16 std::u16string.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::u16string Utf8ToUtf16(std::string_view utf8)
+{
+    return Utf8ToUtf16<std::u16string>(utf8);
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 text, given as a pointer and a length in code units
+// (e.g. a slice of a larger buffer), to UTF-8 std::string.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::string Utf16ToUtf8(const char16_t* utf16, std::size_t utf16Length)
+{
+    return Utf16ToUtf8(std::u16string_view(utf16, utf16Length));
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 text, given as a pointer and a length in chars
+// (e.g. a slice of a memory-mapped file or network buffer), to UTF-16 std::u16string.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::u16string Utf8ToUtf16(const char* utf8, std::size_t utf8Length)
+{
+    return Utf8ToUtf16(std::string_view(utf8, utf8Length));
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 std::u16string_view to UTF-8 std::string,
+// with the given policy for invalid input.
+// With ErrorPolicy::Replace, invalid input doesn't throw; if replacementCount
+// is not null, it receives the number of U+FFFD substituted for it.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::string Utf16ToUtf8(
+    std::u16string_view utf16, ErrorPolicy errorPolicy, std::size_t* replacementCount = nullptr)
+{
+    std::size_t replacements = 0;
+    std::string utf8;
+    if (errorPolicy == ErrorPolicy::Strict)
+    {
+        utf8 = Utf16ToUtf8(utf16);
+    }
+    else
+    {
+        (void)Details::Utf16ToUtf8SinglePass(utf16, utf8, &replacements);
+    }
+
+    if (replacementCount != nullptr)
+    {
+        *replacementCount = replacements;
+    }
+    return utf8;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 std::string_view to UTF-16 std::u16string,
+// with the given policy for invalid input, as the Utf16ToUtf8 overload above
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::u16string Utf8ToUtf16(
+    std::string_view utf8, ErrorPolicy errorPolicy, std::size_t* replacementCount = nullptr)
+{
+    std::size_t replacements = 0;
+    std::u16string utf16;
+    if (errorPolicy == ErrorPolicy::Strict)
+    {
+        utf16 = Utf8ToUtf16(utf8);
+    }
+    else
+    {
+        (void)Details::Utf8ToUtf16SinglePass(utf8, utf16, &replacements);
+    }
+
+    if (replacementCount != nullptr)
+    {
+        *replacementCount = replacements;
+    }
+    return utf16;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 std::u16string_view to UTF-8 std::string,
+// without throwing on invalid input: return a ConversionError instead
+// (std::bad_alloc is still thrown if memory runs out).
+// Invalid input is found before allocating, so the error path allocates nothing.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionExpected<std::string> TryUtf16ToUtf8(std::u16string_view utf16)
+{
+    // Validate first; this also gives the exact length of the output
+    const ConversionResult measured = Details::MeasureUtf16ToUtf8(utf16.data(), utf16.length());
+    if (measured.status != ConversionStatus::Ok)
+    {
+        return Details::MakeConversionError<std::string>(
+            Details::DescribeUtf16Error(utf16.data(), measured.unitsRead));
+    }
+
+    std::string utf8;
+    Details::ResizeAndOverwrite(utf8, measured.unitsWritten, [&](auto* data, std::size_t length)
+    {
+        return Details::ConvertUtf16ToUtf8Bounded(utf16.data(), utf16.length(), data, length).unitsWritten;
+    });
+
+    return utf8;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 std::string_view to UTF-16 std::u16string,
+// without throwing on invalid input: return a ConversionError instead
+// (std::bad_alloc is still thrown if memory runs out).
+// Invalid input is found before allocating, so the error path allocates nothing.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionExpected<std::u16string> TryUtf8ToUtf16(std::string_view utf8)
+{
+    // Validate first; this also gives the exact length of the output
+    const ConversionResult measured = Details::MeasureUtf8ToUtf16(utf8.data(), utf8.length());
+    if (measured.status != ConversionStatus::Ok)
+    {
+        return Details::MakeConversionError<std::u16string>(
+            Details::DescribeUtf8Error(utf8.data(), utf8.length(), measured.unitsRead));
+    }
+
+    std::u16string utf16;
+    Details::ResizeAndOverwrite(utf16, measured.unitsWritten, [&](auto* data, std::size_t length)
+    {
+        return Details::ConvertUtf8ToUtf16Bounded(utf8.data(), utf8.length(), data, length).unitsWritten;
+    });
+
+    return utf16;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Append the UTF-8 conversion of UTF-16 text to a std::string,
+// growing it in place: repeated appends reuse its capacity.
+// Signal errors throwing UnicodeConversionException;
+// in that case, utf8 is left as it was.
+//------------------------------------------------------------------------------
+inline void AppendUtf8(std::string& utf8, std::u16string_view utf16)
+{
+    const ConversionResult result = Details::AppendUtf16ToUtf8SinglePass(utf16, utf8);
+    if (result.status != ConversionStatus::Ok)
+    {
+        Details::ThrowConversionError(Details::DescribeUtf16Error(utf16.data(), result.unitsRead));
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Append the UTF-16 conversion of UTF-8 text to a std::u16string,
+// growing it in place: repeated appends reuse its capacity.
+// Signal errors throwing UnicodeConversionException;
+// in that case, utf16 is left as it was.
+//------------------------------------------------------------------------------
+inline void AppendUtf16(std::u16string& utf16, std::string_view utf8)
+{
+    const ConversionResult result = Details::AppendUtf8ToUtf16SinglePass(utf8, utf16);
+    if (result.status != ConversionStatus::Ok)
+    {
+        Details::ThrowConversionError(Details::DescribeUtf8Error(utf8.data(), utf8.length(), result.unitsRead));
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Convert a batch of UTF-16 strings (e.g. a column of names or keys)
+// to UTF-8, into a single contiguous string plus the offset of each
+// converted string in it (Arrow-style): one allocation for the whole batch,
+// instead of one per string.
+// Signal errors throwing UnicodeConversionException; the error offset
+// is in the batch, as if its strings were concatenated.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline Utf8Batch Utf16ToUtf8Batch(const std::u16string_view* strings, std::size_t count)
+{
+    return Details::Utf16ToUtf8Batch(count, [strings](std::size_t i) { return strings[i]; });
+}
+
+
+//------------------------------------------------------------------------------
+// Convert a batch of UTF-8 strings to UTF-16, into a single contiguous
+// string plus the offset of each converted string in it, as Utf16ToUtf8Batch
+//------------------------------------------------------------------------------
+[[nodiscard]] inline Utf16Batch Utf8ToUtf16Batch(const std::string_view* strings, std::size_t count)
+{
+    return Details::Utf8ToUtf16Batch(count, [strings](std::size_t i) { return strings[i]; });
+}
+
+
+#if defined(__cpp_lib_span)
+
+//------------------------------------------------------------------------------
+// std::span versions of the batch conversions above
+//------------------------------------------------------------------------------
+[[nodiscard]] inline Utf8Batch Utf16ToUtf8Batch(std::span<const std::u16string_view> strings)
+{
+    return Utf16ToUtf8Batch(strings.data(), strings.size());
+}
+
+[[nodiscard]] inline Utf16Batch Utf8ToUtf16Batch(std::span<const std::string_view> strings)
+{
+    return Utf8ToUtf16Batch(strings.data(), strings.size());
+}
+
+#endif // __cpp_lib_span
+
+
+//------------------------------------------------------------------------------
+// Check if UTF-8 text is valid, with the same rules as the conversions,
+// without converting it
+//------------------------------------------------------------------------------
+[[nodiscard]] inline bool IsValidUtf8(std::string_view utf8) noexcept
+{
+    return Details::FindUtf8Error(utf8.data(), utf8.length()) == utf8.length();
+}
+
+
+//------------------------------------------------------------------------------
+// Check if UTF-16 text is valid (no unpaired surrogates),
+// without converting it
+//------------------------------------------------------------------------------
+[[nodiscard]] inline bool IsValidUtf16(std::u16string_view utf16) noexcept
+{
+    return Details::FindUtf16Error(utf16.data(), utf16.length()) == utf16.length();
+}
+
+
+//------------------------------------------------------------------------------
+// Return the offset of the first invalid UTF-8 sequence,
+// or std::string_view::npos if the text is valid
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t FindInvalidUtf8(std::string_view utf8) noexcept
+{
+    const std::size_t offset = Details::FindUtf8Error(utf8.data(), utf8.length());
+    return (offset == utf8.length()) ? std::string_view::npos : offset;
+}
+
+
+//------------------------------------------------------------------------------
+// Return the offset of the first unpaired surrogate,
+// or std::u16string_view::npos if the text is valid
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t FindInvalidUtf16(std::u16string_view utf16) noexcept
+{
+    const std::size_t offset = Details::FindUtf16Error(utf16.data(), utf16.length());
+    return (offset == utf16.length()) ? std::u16string_view::npos : offset;
+}
+
+
+//------------------------------------------------------------------------------
+// Return the length, in chars, of the UTF-8 conversion of UTF-16 text,
+// without converting it nor allocating memory.
+// Signal errors throwing UnicodeConversionException, like Utf16ToUtf8.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t Utf8LengthOf(std::u16string_view utf16)
+{
+    const ConversionResult result = Details::MeasureUtf16ToUtf8(utf16.data(), utf16.length());
+    if (result.status != ConversionStatus::Ok)
+    {
+        Details::ThrowConversionError(Details::DescribeUtf16Error(utf16.data(), result.unitsRead));
+    }
+
+    return result.unitsWritten;
+}
+
+
+//------------------------------------------------------------------------------
+// Return the length, in char16_t code units, of the UTF-16 conversion
+// of UTF-8 text, without converting it nor allocating memory.
+// Signal errors throwing UnicodeConversionException, like Utf8ToUtf16.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t Utf16LengthOf(std::string_view utf8)
+{
+    const ConversionResult result = Details::MeasureUtf8ToUtf16(utf8.data(), utf8.length());
+    if (result.status != ConversionStatus::Ok)
+    {
+        Details::ThrowConversionError(Details::DescribeUtf8Error(utf8.data(), utf8.length(), result.unitsRead));
+    }
+
+    return result.unitsWritten;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 to UTF-8 into a caller-provided buffer,
+// without allocating memory.
+// Whole code points are converted as long as they fit: if the buffer is
+// too small, the status is TargetTooSmall, and the conversion can be resumed
+// from the returned unitsRead offset.
+// Invalid input is reported with the InvalidInput status.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionResult ConvertUtf16ToUtf8(
+    std::u16string_view utf16, char* utf8, std::size_t utf8Capacity) noexcept
+{
+    return Details::ConvertUtf16ToUtf8Bounded(utf16.data(), utf16.length(), utf8, utf8Capacity);
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 to UTF-16 into a caller-provided buffer,
+// without allocating memory.
+// Whole code points are converted as long as they fit: if the buffer is
+// too small, the status is TargetTooSmall, and the conversion can be resumed
+// from the returned unitsRead offset.
+// Invalid input is reported with the InvalidInput status.
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionResult ConvertUtf8ToUtf16(
+    std::string_view utf8, char16_t* utf16, std::size_t utf16Capacity) noexcept
+{
+    return Details::ConvertUtf8ToUtf16Bounded(utf8.data(), utf8.length(), utf16, utf16Capacity);
+}
+
+
+#if defined(__cpp_lib_span)
+
+//------------------------------------------------------------------------------
+// std::span versions of the caller-provided buffer conversions above
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionResult ConvertUtf16ToUtf8(
+    std::u16string_view utf16, std::span<char> utf8) noexcept
+{
+    return Details::ConvertUtf16ToUtf8Bounded(utf16.data(), utf16.size(), utf8.data(), utf8.size());
+}
+
+[[nodiscard]] inline ConversionResult ConvertUtf8ToUtf16(
+    std::string_view utf8, std::span<char16_t> utf16) noexcept
+{
+    return Details::ConvertUtf8ToUtf16Bounded(utf8.data(), utf8.size(), utf16.data(), utf16.size());
+}
+
+#endif // __cpp_lib_span
+
+} // namespace UnicodeConvAtlStd
+
+
+#endif // GIOVANNI_DICANIO_UNICODECONVCORE_HPP_INCLUDED
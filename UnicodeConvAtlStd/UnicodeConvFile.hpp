@@ -0,0 +1,915 @@
+#ifndef GIOVANNI_DICANIO_UNICODECONVFILE_HPP_INCLUDED
+#define GIOVANNI_DICANIO_UNICODECONVFILE_HPP_INCLUDED
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Transcoding of text files between UTF-8 and UTF-16, via memory mapping
+//
+//                  Copyright (C) by Giovanni Dicanio
+//                    <giovanni.dicanio AT gmail.com>
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+//------------------------------------------------------------------------------
+// This is a header-only C++ file that implements the transcoding of large
+// text files, e.g. UTF-16LE exports of Windows tools to UTF-8.
+//
+// The exported function is:
+//
+//      FileTranscodeResult TranscodeFile(const std::filesystem::path& source,
+//                                        const std::filesystem::path& target,
+//                                        const FileTranscodeOptions& options = {})
+//
+// The source file is memory mapped a view at a time, and converted
+// in chunks into an aligned output buffer, written to the target file
+// in large multiples of 4 KB: the memory used doesn't depend on the size
+// of the files.
+//
+// A BOM at the start of the source selects its encoding (UTF-8, UTF-16LE
+// or UTF-16BE), and is not converted; without a BOM, the encoding is the one
+// in the options. The target gets a BOM only if the options ask for it.
+//
+// Invalid text is signaled throwing UnicodeConversionException, as in
+// UnicodeConvCore.hpp, with the error offset in code units of the source
+// text (after the BOM); I/O errors throw std::system_error.
+// In both cases, the target file is left as it was: the text is written
+// to a temporary file next to it, which replaces it only once complete.
+//
+// These functions live under the UnicodeConvAtlStd namespace.
+// They depend on the C++ Standard Library, and on the Windows API
+// or on POSIX (mmap) for the file access.
+//
+//
+// The MIT License(MIT)
+//
+// Copyright(c) 2010-2023 by Giovanni Dicanio
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//------------------------------------------------------------------------------
+
+
+//==============================================================================
+//                              Includes
+//==============================================================================
+
+#include <algorithm>    // std::min, std::max
+#include <chrono>       // std::chrono::steady_clock
+#include <cstddef>      // std::size_t
+#include <cstdint>      // std::uint16_t, std::uint64_t
+#include <cstdlib>      // std::abort
+#include <cstring>      // std::memcpy, std::memmove, std::memcmp
+#include <filesystem>   // std::filesystem::path, std::filesystem::rename
+#include <string>       // std::to_string
+#include <string_view>  // std::string_view
+#include <new>          // std::align_val_t
+#include <system_error> // std::system_error, std::errc
+#include <vector>       // std::vector
+
+#if defined(_WIN32)
+#include <Windows.h>    // Windows file mapping API
+#else
+#include <errno.h>      // errno
+#include <fcntl.h>      // open
+#include <sys/mman.h>   // mmap
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // read, write, close
+#endif
+
+#include "UnicodeConvCore.hpp"  // Portable transcoding core
+
+
+//==============================================================================
+//                              Implementation
+//==============================================================================
+
+namespace UnicodeConvAtlStd {
+
+//------------------------------------------------------------------------------
+// Encodings of text files
+//------------------------------------------------------------------------------
+enum class FileEncoding
+{
+    Utf8,
+    Utf16LE,
+    Utf16BE
+};
+
+//------------------------------------------------------------------------------
+// Return a displayable name of the given encoding, e.g. "UTF-16LE"
+//------------------------------------------------------------------------------
+[[nodiscard]] inline const char* GetFileEncodingName(FileEncoding encoding) noexcept
+{
+    switch (encoding)
+    {
+    case FileEncoding::Utf8:    return "UTF-8";
+    case FileEncoding::Utf16LE: return "UTF-16LE";
+    case FileEncoding::Utf16BE: return "UTF-16BE";
+    }
+    return "unknown";
+}
+
+
+// Default length of the views of the source file mapped at a time, in bytes
+inline constexpr std::size_t kDefaultFileMappingLength = std::size_t{ 64 } << 20;
+
+// Default length of the output buffer, in bytes
+inline constexpr std::size_t kDefaultFileBufferLength = std::size_t{ 4 } << 20;
+
+
+//------------------------------------------------------------------------------
+// Options of TranscodeFile()
+//------------------------------------------------------------------------------
+struct FileTranscodeOptions
+{
+    // Encoding of sources without a BOM
+    FileEncoding sourceEncoding = FileEncoding::Utf16LE;
+
+    FileEncoding targetEncoding = FileEncoding::Utf8;
+
+    // Start the target with a BOM?
+    bool writeBom = false;
+
+    // Length of the views of the source mapped at a time
+    // (at least 2 MB), and of the output buffer (at least 64 KB):
+    // together, they bound the memory used
+    std::size_t mappingLength = kDefaultFileMappingLength;
+    std::size_t bufferLength = kDefaultFileBufferLength;
+};
+
+//------------------------------------------------------------------------------
+// Outcome of TranscodeFile()
+//------------------------------------------------------------------------------
+struct FileTranscodeResult
+{
+    // Encoding of the source, as found from its BOM or from the options
+    FileEncoding sourceEncoding;
+    bool sourceHasBom;
+
+    // Sizes of the files, including the BOMs
+    std::uint64_t bytesRead;
+    std::uint64_t bytesWritten;
+
+    double seconds;
+
+    //--------------------------------------------------------------------------
+    // Return the throughput, in MB/s of source data
+    //--------------------------------------------------------------------------
+    [[nodiscard]] double GetThroughput() const noexcept
+    {
+        return (seconds > 0) ? static_cast<double>(bytesRead) / (seconds * 1e6) : 0.0;
+    }
+};
+
+
+namespace Details
+{
+
+// Alignment of the offsets of the mapped views
+// (a multiple of the page size, and of the Windows allocation granularity)
+inline constexpr std::uint64_t kFileMappingAlignment = std::uint64_t{ 1 } << 20;
+
+// Alignment of the output buffer, and of the lengths of the writes
+inline constexpr std::size_t kFileWriteAlignment = 4096;
+
+
+//------------------------------------------------------------------------------
+// Return the error of the last failed file operation
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::error_code GetLastFileError() noexcept
+{
+#if defined(_WIN32)
+    return std::error_code(static_cast<int>(::GetLastError()), std::system_category());
+#else
+    return std::error_code(errno, std::generic_category());
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+// Throw a std::system_error for a failed file operation.
+// In builds without exceptions, abort instead.
+//------------------------------------------------------------------------------
+[[noreturn]] inline void ThrowFileError(const std::error_code& error, const char* what)
+{
+#if !defined(__cpp_exceptions) && !defined(_CPPUNWIND)
+    static_cast<void>(error);
+    static_cast<void>(what);
+    std::abort();
+#else
+    throw std::system_error(error, what);
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+// Read-only file, mapped in memory a view at a time
+//------------------------------------------------------------------------------
+class MappedFile
+{
+public:
+
+    explicit MappedFile(const std::filesystem::path& path)
+    {
+#if defined(_WIN32)
+        m_file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+        {
+            ThrowFileError(GetLastFileError(), "Can't open the source file");
+        }
+
+        LARGE_INTEGER size;
+        if (!::GetFileSizeEx(m_file, &size))
+        {
+            const std::error_code error = GetLastFileError();
+            Close();
+            ThrowFileError(error, "Can't get the size of the source file");
+        }
+        m_size = static_cast<std::uint64_t>(size.QuadPart);
+
+        // Empty files can't be mapped (and don't need to)
+        if (m_size > 0)
+        {
+            m_mapping = ::CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m_mapping == nullptr)
+            {
+                const std::error_code error = GetLastFileError();
+                Close();
+                ThrowFileError(error, "Can't map the source file");
+            }
+        }
+#else
+        m_file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (m_file < 0)
+        {
+            ThrowFileError(GetLastFileError(), "Can't open the source file");
+        }
+
+        struct stat status;
+        if (::fstat(m_file, &status) != 0)
+        {
+            const std::error_code error = GetLastFileError();
+            Close();
+            ThrowFileError(error, "Can't get the size of the source file");
+        }
+        m_size = static_cast<std::uint64_t>(status.st_size);
+#endif
+    }
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    // Ban copy
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    [[nodiscard]] std::uint64_t GetSize() const noexcept
+    {
+        return m_size;
+    }
+
+    //--------------------------------------------------------------------------
+    // Map the given range of the file, replacing the previous view.
+    // The offset must be a multiple of kFileMappingAlignment.
+    //--------------------------------------------------------------------------
+    [[nodiscard]] const unsigned char* MapView(std::uint64_t offset, std::size_t length)
+    {
+        UnmapView();
+
+#if defined(_WIN32)
+        m_view = ::MapViewOfFile(m_mapping, FILE_MAP_READ,
+                                 static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), length);
+        if (m_view == nullptr)
+        {
+            ThrowFileError(GetLastFileError(), "Can't map a view of the source file");
+        }
+#else
+        void* view = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, m_file, static_cast<off_t>(offset));
+        if (view == MAP_FAILED)
+        {
+            ThrowFileError(GetLastFileError(), "Can't map a view of the source file");
+        }
+        m_view = view;
+        m_viewLength = length;
+
+        // The view is read once, front to back
+        (void)::posix_madvise(m_view, m_viewLength, POSIX_MADV_SEQUENTIAL);
+#endif
+
+        return static_cast<const unsigned char*>(m_view);
+    }
+
+private:
+
+#if defined(_WIN32)
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    int m_file = -1;
+    std::size_t m_viewLength = 0;
+#endif
+    void* m_view = nullptr;
+    std::uint64_t m_size = 0;
+
+    void UnmapView() noexcept
+    {
+        if (m_view != nullptr)
+        {
+#if defined(_WIN32)
+            ::UnmapViewOfFile(m_view);
+#else
+            ::munmap(m_view, m_viewLength);
+#endif
+            m_view = nullptr;
+        }
+    }
+
+    void Close() noexcept
+    {
+        UnmapView();
+
+#if defined(_WIN32)
+        if (m_mapping != nullptr)
+        {
+            ::CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            ::CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (m_file >= 0)
+        {
+            ::close(m_file);
+            m_file = -1;
+        }
+#endif
+    }
+};
+
+
+//------------------------------------------------------------------------------
+// Write-only target file. The text is written to a new temporary file
+// in the directory of the target, which replaces the target only when
+// MoveToTarget() is called: otherwise, the temporary file is removed,
+// and an existing target is left as it was.
+//------------------------------------------------------------------------------
+class OutputFile
+{
+public:
+
+    explicit OutputFile(const std::filesystem::path& target)
+        : m_target(target)
+    {
+        // Find a name not taken yet, next to the target
+        constexpr unsigned int kMaxAttempts = 100;
+        for (unsigned int attempt = 0; ; attempt++)
+        {
+            m_path = target;
+            m_path += ".transcoding" + std::to_string(attempt) + ".tmp";
+
+#if defined(_WIN32)
+            m_file = ::CreateFileW(m_path.c_str(), GENERIC_WRITE, 0, nullptr,
+                                   CREATE_NEW, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (m_file != INVALID_HANDLE_VALUE)
+            {
+                break;
+            }
+            if (::GetLastError() != ERROR_FILE_EXISTS || attempt + 1 == kMaxAttempts)
+            {
+                ThrowFileError(GetLastFileError(), "Can't create the target file");
+            }
+#else
+            m_file = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+            if (m_file >= 0)
+            {
+                break;
+            }
+            if (errno != EEXIST || attempt + 1 == kMaxAttempts)
+            {
+                ThrowFileError(GetLastFileError(), "Can't create the target file");
+            }
+#endif
+        }
+    }
+
+    ~OutputFile()
+    {
+        (void)Close();
+        if (!m_isMoved)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(m_path, ignored);
+        }
+    }
+
+    // Ban copy
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    //--------------------------------------------------------------------------
+    // Write all the given bytes
+    //--------------------------------------------------------------------------
+    void Write(const unsigned char* data, std::size_t length)
+    {
+        while (length > 0)
+        {
+#if defined(_WIN32)
+            DWORD written = 0;
+            const DWORD toWrite = static_cast<DWORD>((std::min<std::size_t>)(length, std::size_t{ 1 } << 30));
+            if (!::WriteFile(m_file, data, toWrite, &written, nullptr))
+            {
+                ThrowFileError(GetLastFileError(), "Can't write the target file");
+            }
+#else
+            const ssize_t written = ::write(m_file, data, length);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                ThrowFileError(GetLastFileError(), "Can't write the target file");
+            }
+#endif
+            data += written;
+            length -= static_cast<std::size_t>(written);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Close the complete file, and move it over the target
+    //--------------------------------------------------------------------------
+    void MoveToTarget()
+    {
+        if (!Close())
+        {
+            ThrowFileError(GetLastFileError(), "Can't write the target file");
+        }
+
+        std::error_code error;
+        std::filesystem::rename(m_path, m_target, error);
+        if (error)
+        {
+            ThrowFileError(error, "Can't replace the target file");
+        }
+        m_isMoved = true;
+    }
+
+private:
+
+    std::filesystem::path m_target;
+    std::filesystem::path m_path;
+#if defined(_WIN32)
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+#else
+    int m_file = -1;
+#endif
+    bool m_isMoved = false;
+
+    // Close the file, if still open: return false if that failed
+    // (e.g. the last writes couldn't be completed)
+    bool Close() noexcept
+    {
+#if defined(_WIN32)
+        if (m_file == INVALID_HANDLE_VALUE)
+        {
+            return true;
+        }
+        const bool isClosed = (::CloseHandle(m_file) != 0);
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_file < 0)
+        {
+            return true;
+        }
+        const bool isClosed = (::close(m_file) == 0);
+        m_file = -1;
+#endif
+        return isClosed;
+    }
+};
+
+
+//------------------------------------------------------------------------------
+// Output buffer aligned for the writes, flushed to the target file
+// a multiple of kFileWriteAlignment bytes at a time
+//------------------------------------------------------------------------------
+class FileWriteBuffer
+{
+public:
+
+    FileWriteBuffer(OutputFile& file, std::size_t capacity)
+        : m_file(file),
+        m_data(static_cast<unsigned char*>(::operator new(capacity, std::align_val_t{ kFileWriteAlignment }))),
+        m_capacity(capacity)
+    {
+    }
+
+    ~FileWriteBuffer()
+    {
+        ::operator delete(m_data, std::align_val_t{ kFileWriteAlignment });
+    }
+
+    // Ban copy
+    FileWriteBuffer(const FileWriteBuffer&) = delete;
+    FileWriteBuffer& operator=(const FileWriteBuffer&) = delete;
+
+    // Free space, to be filled and then committed
+    [[nodiscard]] unsigned char* GetFreeSpace() noexcept
+    {
+        return m_data + m_length;
+    }
+
+    [[nodiscard]] std::size_t GetFreeLength() const noexcept
+    {
+        return m_capacity - m_length;
+    }
+
+    [[nodiscard]] std::uint64_t GetBytesWritten() const noexcept
+    {
+        return m_bytesWritten;
+    }
+
+    //--------------------------------------------------------------------------
+    // Add the given number of bytes written into the free space;
+    // once the buffer is half full, write its aligned part
+    //--------------------------------------------------------------------------
+    void Commit(std::size_t length)
+    {
+        m_length += length;
+        if (m_length >= m_capacity / 2)
+        {
+            const std::size_t alignedLength = m_length - m_length % kFileWriteAlignment;
+            m_file.Write(m_data, alignedLength);
+            m_bytesWritten += alignedLength;
+
+            m_length -= alignedLength;
+            std::memmove(m_data, m_data + alignedLength, m_length);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Write all the buffered bytes
+    //--------------------------------------------------------------------------
+    void Flush()
+    {
+        m_file.Write(m_data, m_length);
+        m_bytesWritten += m_length;
+        m_length = 0;
+    }
+
+private:
+    OutputFile& m_file;
+    unsigned char* m_data;
+    std::size_t m_capacity;
+    std::size_t m_length = 0;
+    std::uint64_t m_bytesWritten = 0;
+};
+
+
+//------------------------------------------------------------------------------
+// Return the BOM of the given encoding, as bytes
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::string_view GetFileBom(FileEncoding encoding) noexcept
+{
+    switch (encoding)
+    {
+    case FileEncoding::Utf8:    return "\xEF\xBB\xBF";
+    case FileEncoding::Utf16LE: return "\xFF\xFE";
+    case FileEncoding::Utf16BE: return "\xFE\xFF";
+    }
+    return {};
+}
+
+
+//------------------------------------------------------------------------------
+// Is the host little-endian?
+//------------------------------------------------------------------------------
+[[nodiscard]] inline bool IsLittleEndianHost() noexcept
+{
+    const std::uint16_t one = 1;
+    unsigned char firstByte = 0;
+    std::memcpy(&firstByte, &one, 1);
+    return firstByte == 1;
+}
+
+
+//------------------------------------------------------------------------------
+// Swap the bytes of UTF-16 code units, between little-endian and big-endian
+//------------------------------------------------------------------------------
+inline void SwapUtf16Bytes(const char16_t* src, std::size_t length, char16_t* dst) noexcept
+{
+    for (std::size_t i = 0; i < length; i++)
+    {
+        dst[i] = static_cast<char16_t>((src[i] >> 8) | (src[i] << 8));
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Return the number of code units at the end of a chunk that start
+// a code point which is not complete: the next chunk converts them
+//------------------------------------------------------------------------------
+[[nodiscard]] inline std::size_t IncompleteTailLength(const char* src, std::size_t length) noexcept
+{
+    return Utf8IncompleteTailLength(src, length);
+}
+
+[[nodiscard]] inline std::size_t IncompleteTailLength(const char16_t* src, std::size_t length) noexcept
+{
+    return (length > 0 && (src[length - 1] & 0xFC00) == 0xD800) ? 1 : 0;
+}
+
+
+//------------------------------------------------------------------------------
+// Transcode a chunk of text from the source code units to the target ones,
+// with worst-case room in dst; text in the same encoding is validated
+// and copied
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionResult TranscodeFileChunk(
+    const char16_t* src, std::size_t length, char* dst) noexcept
+{
+    return ConvertUtf16ToUtf8(src, length, dst);
+}
+
+[[nodiscard]] inline ConversionResult TranscodeFileChunk(
+    const char* src, std::size_t length, char16_t* dst) noexcept
+{
+    return ConvertUtf8ToUtf16(src, length, dst);
+}
+
+[[nodiscard]] inline ConversionResult TranscodeFileChunk(
+    const char16_t* src, std::size_t length, char16_t* dst) noexcept
+{
+    const ConversionResult result = MeasureUtf16ToUtf8(src, length);
+    if (result.status != ConversionStatus::Ok)
+    {
+        return { result.status, result.unitsRead, 0 };
+    }
+
+    std::memcpy(dst, src, length * sizeof(char16_t));
+    return { ConversionStatus::Ok, length, length };
+}
+
+[[nodiscard]] inline ConversionResult TranscodeFileChunk(
+    const char* src, std::size_t length, char* dst) noexcept
+{
+    const ConversionResult result = MeasureUtf8ToUtf16(src, length);
+    if (result.status != ConversionStatus::Ok)
+    {
+        return { result.status, result.unitsRead, 0 };
+    }
+
+    std::memcpy(dst, src, length);
+    return { ConversionStatus::Ok, length, length };
+}
+
+
+//------------------------------------------------------------------------------
+// Describe the invalid input found in a chunk at src[offset]
+//------------------------------------------------------------------------------
+[[nodiscard]] inline ConversionError DescribeFileChunkError(
+    const char* src, std::size_t length, std::size_t offset) noexcept
+{
+    return DescribeUtf8Error(src, length, offset);
+}
+
+[[nodiscard]] inline ConversionError DescribeFileChunkError(
+    const char16_t* src, std::size_t /* length */, std::size_t offset) noexcept
+{
+    return DescribeUtf16Error(src, offset);
+}
+
+
+//------------------------------------------------------------------------------
+// Return the conversion type reported for invalid text, given the encodings
+// of the source and target files
+//------------------------------------------------------------------------------
+[[nodiscard]] constexpr UnicodeConversionException::ConversionType GetFileConversionType(
+    bool isUtf8Source, bool isUtf8Target) noexcept
+{
+    using ConversionType = UnicodeConversionException::ConversionType;
+    if (isUtf8Source)
+    {
+        return isUtf8Target ? ConversionType::FromUtf8ToUtf8 : ConversionType::FromUtf8ToUtf16;
+    }
+    return isUtf8Target ? ConversionType::FromUtf16ToUtf8 : ConversionType::FromUtf16ToUtf16;
+}
+
+
+//------------------------------------------------------------------------------
+// Transcode the text of the source file, which starts at textOffset,
+// mapping a view at a time, into the write buffer.
+// The source and target code units are byte-swapped if their byte order
+// is not the one of the host. A UTF-16 source must have an even length.
+//------------------------------------------------------------------------------
+template <typename SourceChar, typename TargetChar>
+void TranscodeFileText(MappedFile& source, std::uint64_t textOffset, bool swapSource,
+                       FileWriteBuffer& target, bool swapTarget, std::size_t mappingLength)
+{
+    // Worst-case growth, in target code units per source code unit
+    constexpr std::size_t kMaxGrowth = (sizeof(SourceChar) > sizeof(TargetChar)) ? kMaxUtf8CharsPerUtf16Unit : 1;
+
+    const std::uint64_t fileSize = source.GetSize();
+    const std::uint64_t textLength = (fileSize - textOffset) / sizeof(SourceChar);
+    std::vector<char16_t> swapped;
+
+    std::uint64_t read = 0;
+    while (read < textLength)
+    {
+        // Map the next view, starting at or just before the text left
+        const std::uint64_t position = textOffset + read * sizeof(SourceChar);
+        const std::uint64_t viewOffset = position - position % kFileMappingAlignment;
+        const auto viewLength = static_cast<std::size_t>(
+            (std::min<std::uint64_t>)(mappingLength, fileSize - viewOffset));
+        const unsigned char* view = source.MapView(viewOffset, viewLength);
+
+        const auto* window = reinterpret_cast<const SourceChar*>(view + (position - viewOffset));
+        const std::size_t windowLength = static_cast<std::size_t>(
+            (std::min<std::uint64_t>)((viewLength - (position - viewOffset)) / sizeof(SourceChar), textLength - read));
+        const bool isLastWindow = (read + windowLength == textLength);
+
+        std::size_t windowRead = 0;
+        while (windowRead < windowLength)
+        {
+            // Take the chunk that fits the free space of the buffer in the worst case
+            const std::size_t left = windowLength - windowRead;
+            std::size_t chunkLength = (std::min)(left, target.GetFreeLength() / (sizeof(TargetChar) * kMaxGrowth));
+
+            const SourceChar* chunk = window + windowRead;
+            if constexpr (sizeof(SourceChar) == sizeof(char16_t))
+            {
+                if (swapSource)
+                {
+                    swapped.resize(chunkLength);
+                    SwapUtf16Bytes(chunk, chunkLength, swapped.data());
+                    chunk = swapped.data();
+                }
+            }
+
+            // Leave an incomplete code point at the end of the chunk for the next one,
+            // unless the text ends there: then it's invalid
+            if (chunkLength < left || !isLastWindow)
+            {
+                chunkLength -= IncompleteTailLength(chunk, chunkLength);
+                if (chunkLength == 0)
+                {
+                    // Continue in the next view
+                    break;
+                }
+            }
+
+            auto* dst = reinterpret_cast<TargetChar*>(target.GetFreeSpace());
+            const ConversionResult result = TranscodeFileChunk(chunk, chunkLength, dst);
+            if (result.status != ConversionStatus::Ok)
+            {
+                ConversionError error = DescribeFileChunkError(chunk, chunkLength, result.unitsRead);
+                error.conversionType = GetFileConversionType(sizeof(SourceChar) == 1, sizeof(TargetChar) == 1);
+                error.offset += static_cast<std::size_t>(read + windowRead);
+                ThrowConversionError(error);
+            }
+
+            if constexpr (sizeof(TargetChar) == sizeof(char16_t))
+            {
+                if (swapTarget)
+                {
+                    SwapUtf16Bytes(dst, result.unitsWritten, dst);
+                }
+            }
+
+            target.Commit(result.unitsWritten * sizeof(TargetChar));
+            windowRead += chunkLength;
+        }
+
+        read += windowRead;
+    }
+}
+
+} // namespace Details
+
+
+//------------------------------------------------------------------------------
+// Transcode the source text file into the target file, created or replaced
+// once the transcoding is complete.
+// Signal invalid text throwing UnicodeConversionException, and I/O errors
+// (or a target which is the source file itself) throwing std::system_error;
+// in both cases, the target is left as it was.
+//------------------------------------------------------------------------------
+inline FileTranscodeResult TranscodeFile(
+    const std::filesystem::path& source,
+    const std::filesystem::path& target,
+    const FileTranscodeOptions& options = {})
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    // Replacing the target would destroy the source
+    std::error_code sameFileError;
+    if (std::filesystem::equivalent(source, target, sameFileError))
+    {
+        Details::ThrowFileError(std::make_error_code(std::errc::invalid_argument),
+                                "The source and target are the same file");
+    }
+
+    Details::MappedFile sourceFile(source);
+    const std::uint64_t sourceSize = sourceFile.GetSize();
+    const std::size_t mappingLength = static_cast<std::size_t>((std::max<std::uint64_t>)(
+        options.mappingLength - options.mappingLength % Details::kFileMappingAlignment,
+        2 * Details::kFileMappingAlignment));
+
+    // Find the encoding of the source from its BOM, if any
+    FileTranscodeResult result = { options.sourceEncoding, false, sourceSize, 0, 0.0 };
+    if (sourceSize >= 2)
+    {
+        const unsigned char* view = sourceFile.MapView(0, static_cast<std::size_t>((std::min<std::uint64_t>)(sourceSize, 3)));
+        for (const FileEncoding encoding : { FileEncoding::Utf8, FileEncoding::Utf16LE, FileEncoding::Utf16BE })
+        {
+            const std::string_view bom = Details::GetFileBom(encoding);
+            if (sourceSize >= bom.length() && std::memcmp(view, bom.data(), bom.length()) == 0)
+            {
+                result.sourceEncoding = encoding;
+                result.sourceHasBom = true;
+                break;
+            }
+        }
+    }
+    const std::uint64_t textOffset = result.sourceHasBom ? Details::GetFileBom(result.sourceEncoding).length() : 0;
+
+    // A UTF-16 source can't end with half a code unit: check it before
+    // writing the target
+    const bool isUtf8Source = (result.sourceEncoding == FileEncoding::Utf8);
+    const bool isUtf8Target = (options.targetEncoding == FileEncoding::Utf8);
+    if (!isUtf8Source && (sourceSize - textOffset) % sizeof(char16_t) != 0)
+    {
+        Details::ThrowConversionError(
+            { ConversionStatus::InvalidInput, Details::GetFileConversionType(isUtf8Source, isUtf8Target),
+              static_cast<std::size_t>((sourceSize - textOffset) / sizeof(char16_t)),
+              ConversionErrorKind::TruncatedSequence });
+    }
+
+    Details::OutputFile targetFile(target);
+    Details::FileWriteBuffer buffer(targetFile, (std::max)(
+        options.bufferLength - options.bufferLength % Details::kFileWriteAlignment,
+        std::size_t{ 16 } * Details::kFileWriteAlignment));
+
+    const bool isLittleEndianHost = Details::IsLittleEndianHost();
+    const bool swapSource = (result.sourceEncoding == FileEncoding::Utf16LE) != isLittleEndianHost;
+    const bool swapTarget = (options.targetEncoding == FileEncoding::Utf16LE) != isLittleEndianHost;
+
+    if (options.writeBom)
+    {
+        const std::string_view bom = Details::GetFileBom(options.targetEncoding);
+        std::memcpy(buffer.GetFreeSpace(), bom.data(), bom.length());
+        buffer.Commit(bom.length());
+    }
+
+    if (isUtf8Source && isUtf8Target)
+    {
+        Details::TranscodeFileText<char, char>(sourceFile, textOffset, swapSource, buffer, swapTarget, mappingLength);
+    }
+    else if (isUtf8Source)
+    {
+        Details::TranscodeFileText<char, char16_t>(sourceFile, textOffset, swapSource, buffer, swapTarget, mappingLength);
+    }
+    else if (isUtf8Target)
+    {
+        Details::TranscodeFileText<char16_t, char>(sourceFile, textOffset, swapSource, buffer, swapTarget, mappingLength);
+    }
+    else
+    {
+        Details::TranscodeFileText<char16_t, char16_t>(sourceFile, textOffset, swapSource, buffer, swapTarget, mappingLength);
+    }
+    buffer.Flush();
+    targetFile.MoveToTarget();
+
+    result.bytesWritten = buffer.GetBytesWritten();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+} // namespace UnicodeConvAtlStd
+
+
+#endif // GIOVANNI_DICANIO_UNICODECONVFILE_HPP_INCLUDED
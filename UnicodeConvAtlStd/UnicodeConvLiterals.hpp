@@ -0,0 +1,289 @@
+#ifndef GIOVANNI_DICANIO_UNICODECONVLITERALS_HPP_INCLUDED
+#define GIOVANNI_DICANIO_UNICODECONVLITERALS_HPP_INCLUDED
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compile-time UTF-16/UTF-8 conversion of string literals
+//
+//                  Copyright (C) by Giovanni Dicanio
+//                    <giovanni.dicanio AT gmail.com>
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+//------------------------------------------------------------------------------
+// This is a header-only C++ file that implements constexpr conversions
+// of string literals, e.g. to build lookup tables of UTF-8 constants
+// at compile time, instead of converting wide-string constants at startup.
+//
+// The exported functions are:
+//
+//      * Convert from UTF-16 to UTF-8:
+//        constexpr std::size_t Utf8LengthOfLiteral(const Utf16Char (&utf16)[N])
+//        constexpr std::array<char, Utf8Length> Utf16ToUtf8Literal<Utf8Length>(const Utf16Char (&utf16)[N])
+//
+//      * Convert from UTF-8 to UTF-16:
+//        constexpr std::size_t Utf16LengthOfLiteral(const Utf8Char (&utf8)[N])
+//        constexpr std::array<Utf16Char, Utf16Length> Utf8ToUtf16Literal<Utf16Length, Utf16Char = char16_t>(const Utf8Char (&utf8)[N])
+//
+// and the macros, which compute the length for you:
+//
+//        UNICODECONVATLSTD_UTF8_LITERAL(u"...")   // std::array<char, N>
+//        UNICODECONVATLSTD_UTF16_LITERAL("...")   // std::array<char16_t, N>
+//
+// In C++20, the user-defined literals in UnicodeConvAtlStd::Literals
+// do the same, always at compile time:
+//
+//        u"..."_utf8       // std::array<char, N>
+//        "..."_utf16       // std::array<char16_t, N> (also from u8"...")
+//
+// The arrays hold the converted code units, without a terminating null.
+// Utf16Char is char16_t, or wchar_t on Windows (so L"..." literals work, too);
+// Utf8Char is char or char8_t.
+//
+// The lengths are template arguments, always evaluated at compile time:
+// invalid text in a literal is a compile error, pointing at
+// Details::InvalidUnicodeLiteral. At run time (e.g. converting
+// a constexpr array with Utf16ToUtf8Literal), invalid text throws
+// UnicodeConversionException.
+//
+// These functions live under the UnicodeConvAtlStd namespace.
+// They depend only on the C++ Standard Library.
+//
+//
+// The MIT License(MIT)
+//
+// Copyright(c) 2010-2023 by Giovanni Dicanio
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//------------------------------------------------------------------------------
+
+
+//==============================================================================
+//                              Includes
+//==============================================================================
+
+#include <array>        // std::array
+#include <cstddef>      // std::size_t
+#include <type_traits>  // std::is_same_v
+
+#include "UnicodeConvCore.hpp"  // Portable transcoding core
+
+
+//==============================================================================
+//                              Implementation
+//==============================================================================
+
+namespace UnicodeConvAtlStd {
+
+namespace Details
+{
+
+//------------------------------------------------------------------------------
+// Report invalid text in a literal. This function is not constexpr:
+// reaching it while converting a literal at compile time is a compile error.
+//------------------------------------------------------------------------------
+[[noreturn]] inline void InvalidUnicodeLiteral(const ConversionError& error)
+{
+    ThrowConversionError(error);
+}
+
+
+//------------------------------------------------------------------------------
+// Copy the code units of a string literal, without its terminating null,
+// into an array of the code unit type of the scalar conversions
+// (a copy is needed for wchar_t and char8_t, as constexpr functions
+// can't reinterpret_cast)
+//------------------------------------------------------------------------------
+template <typename CodeUnit, typename CharType, std::size_t N>
+[[nodiscard]] constexpr std::array<CodeUnit, N - 1> CopyLiteral(const CharType (&literal)[N]) noexcept
+{
+    std::array<CodeUnit, N - 1> codeUnits{};
+    for (std::size_t i = 0; i < N - 1; i++)
+    {
+        codeUnits[i] = static_cast<CodeUnit>(literal[i]);
+    }
+    return codeUnits;
+}
+
+} // namespace Details
+
+
+//------------------------------------------------------------------------------
+// Return the length of the UTF-8 conversion of a UTF-16 string literal
+//------------------------------------------------------------------------------
+template <typename Utf16Char, std::size_t N>
+[[nodiscard]] constexpr std::size_t Utf8LengthOfLiteral(const Utf16Char (&utf16)[N])
+{
+    static_assert(Details::kIsUtf16CodeUnit<Utf16Char>,
+                  "The literal must be UTF-16 (u\"...\", or L\"...\" on Windows)");
+
+    const std::array<char16_t, N - 1> codeUnits = Details::CopyLiteral<char16_t>(utf16);
+    const ConversionResult result = Details::MeasureUtf16ToUtf8Scalar(codeUnits.data(), codeUnits.size());
+    if (result.status != ConversionStatus::Ok)
+    {
+        Details::InvalidUnicodeLiteral(Details::DescribeUtf16Error(codeUnits.data(), result.unitsRead));
+    }
+    return result.unitsWritten;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert a UTF-16 string literal to UTF-8.
+// Utf8Length must be Utf8LengthOfLiteral(utf16).
+//------------------------------------------------------------------------------
+template <std::size_t Utf8Length, typename Utf16Char, std::size_t N>
+[[nodiscard]] constexpr std::array<char, Utf8Length> Utf16ToUtf8Literal(const Utf16Char (&utf16)[N])
+{
+    if (Utf8LengthOfLiteral(utf16) != Utf8Length)
+    {
+        Details::InvalidUnicodeLiteral({ ConversionStatus::TargetTooSmall,
+                                         UnicodeConversionException::ConversionType::FromUtf16ToUtf8,
+                                         0, ConversionErrorKind::None });
+    }
+
+    const std::array<char16_t, N - 1> codeUnits = Details::CopyLiteral<char16_t>(utf16);
+    std::array<char, Utf8Length> utf8{};
+    (void)Details::ConvertUtf16ToUtf8Scalar(codeUnits.data(), codeUnits.size(), utf8.data());
+    return utf8;
+}
+
+
+//------------------------------------------------------------------------------
+// Return the length of the UTF-16 conversion of a UTF-8 string literal
+//------------------------------------------------------------------------------
+template <typename Utf8Char, std::size_t N>
+[[nodiscard]] constexpr std::size_t Utf16LengthOfLiteral(const Utf8Char (&utf8)[N])
+{
+    static_assert(Details::kIsUtf8CodeUnit<Utf8Char>,
+                  "The literal must be UTF-8 (\"...\" or u8\"...\")");
+
+    const std::array<char, N - 1> codeUnits = Details::CopyLiteral<char>(utf8);
+    const ConversionResult result = Details::MeasureUtf8ToUtf16Scalar(codeUnits.data(), codeUnits.size());
+    if (result.status != ConversionStatus::Ok)
+    {
+        Details::InvalidUnicodeLiteral(
+            Details::DescribeUtf8Error(codeUnits.data(), codeUnits.size(), result.unitsRead));
+    }
+    return result.unitsWritten;
+}
+
+
+//------------------------------------------------------------------------------
+// Convert a UTF-8 string literal to UTF-16.
+// Utf16Length must be Utf16LengthOfLiteral(utf8).
+//------------------------------------------------------------------------------
+template <std::size_t Utf16Length, typename Utf16Char = char16_t, typename Utf8Char, std::size_t N>
+[[nodiscard]] constexpr std::array<Utf16Char, Utf16Length> Utf8ToUtf16Literal(const Utf8Char (&utf8)[N])
+{
+    static_assert(Details::kIsUtf16CodeUnit<Utf16Char>,
+                  "The output must be UTF-16 (char16_t, or wchar_t on Windows)");
+
+    if (Utf16LengthOfLiteral(utf8) != Utf16Length)
+    {
+        Details::InvalidUnicodeLiteral({ ConversionStatus::TargetTooSmall,
+                                         UnicodeConversionException::ConversionType::FromUtf8ToUtf16,
+                                         0, ConversionErrorKind::None });
+    }
+
+    const std::array<char, N - 1> codeUnits = Details::CopyLiteral<char>(utf8);
+    std::array<char16_t, Utf16Length> utf16{};
+    (void)Details::ConvertUtf8ToUtf16Scalar(codeUnits.data(), codeUnits.size(), utf16.data());
+
+    if constexpr (std::is_same_v<Utf16Char, char16_t>)
+    {
+        return utf16;
+    }
+    else
+    {
+        std::array<Utf16Char, Utf16Length> wideUtf16{};
+        for (std::size_t i = 0; i < Utf16Length; i++)
+        {
+            wideUtf16[i] = static_cast<Utf16Char>(utf16[i]);
+        }
+        return wideUtf16;
+    }
+}
+
+
+#if defined(__cpp_consteval) && defined(__cpp_nontype_template_args) && (__cpp_nontype_template_args >= 201911L)
+
+namespace Details
+{
+
+//------------------------------------------------------------------------------
+// String literal passed as a template argument to the literal operators
+//------------------------------------------------------------------------------
+template <typename CharType, std::size_t N>
+struct LiteralText
+{
+    CharType text[N] = {};
+
+    constexpr LiteralText(const CharType (&literal)[N]) noexcept
+    {
+        for (std::size_t i = 0; i < N; i++)
+        {
+            text[i] = literal[i];
+        }
+    }
+};
+
+} // namespace Details
+
+
+namespace Literals
+{
+
+//------------------------------------------------------------------------------
+// u"..."_utf8: convert a UTF-16 string literal to a std::array of UTF-8 chars
+//------------------------------------------------------------------------------
+template <Details::LiteralText Utf16>
+[[nodiscard]] consteval auto operator""_utf8()
+{
+    return Utf16ToUtf8Literal<Utf8LengthOfLiteral(Utf16.text)>(Utf16.text);
+}
+
+//------------------------------------------------------------------------------
+// "..."_utf16: convert a UTF-8 string literal to a std::array of char16_t
+//------------------------------------------------------------------------------
+template <Details::LiteralText Utf8>
+[[nodiscard]] consteval auto operator""_utf16()
+{
+    return Utf8ToUtf16Literal<Utf16LengthOfLiteral(Utf8.text)>(Utf8.text);
+}
+
+} // namespace Literals
+
+#endif // Class-type template parameters and consteval (C++20)
+
+} // namespace UnicodeConvAtlStd
+
+
+//------------------------------------------------------------------------------
+// Convert string literals, computing the lengths of the arrays
+//------------------------------------------------------------------------------
+#define UNICODECONVATLSTD_UTF8_LITERAL(utf16Literal) \
+    (::UnicodeConvAtlStd::Utf16ToUtf8Literal<::UnicodeConvAtlStd::Utf8LengthOfLiteral(utf16Literal)>(utf16Literal))
+
+#define UNICODECONVATLSTD_UTF16_LITERAL(utf8Literal) \
+    (::UnicodeConvAtlStd::Utf8ToUtf16Literal<::UnicodeConvAtlStd::Utf16LengthOfLiteral(utf8Literal)>(utf8Literal))
+
+
+#endif // GIOVANNI_DICANIO_UNICODECONVLITERALS_HPP_INCLUDED
@@ -0,0 +1,342 @@
+#ifndef GIOVANNI_DICANIO_UNICODECONVPARALLEL_HPP_INCLUDED
+#define GIOVANNI_DICANIO_UNICODECONVPARALLEL_HPP_INCLUDED
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Multithreaded UTF-16/UTF-8 conversion of very large buffers
+//
+//                  Copyright (C) by Giovanni Dicanio
+//                    <giovanni.dicanio AT gmail.com>
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+//------------------------------------------------------------------------------
+// This is a header-only C++ file that implements conversions of very large
+// inputs (e.g. hundreds of MB or more) on several threads.
+//
+// The input is split into chunks at code point boundaries; then:
+//
+//      1. The output length of each chunk is measured in parallel
+//         (which also validates the input);
+//      2. A prefix sum of the lengths gives the offset of each chunk
+//         in the output, which is allocated once, with its exact length;
+//      3. The chunks are converted in parallel, each into its own slice
+//         of the output.
+//
+// The exported functions are:
+//
+//      * Convert from UTF-16 to UTF-8:
+//        std::string Utf16ToUtf8Parallel(std::u16string_view utf16,
+//                                        Executor&& executor = ThreadExecutor{},
+//                                        size_t chunkLength = kDefaultParallelChunkLength)
+//
+//      * Convert from UTF-8 to UTF-16:
+//        std::u16string Utf8ToUtf16Parallel(std::string_view utf8,
+//                                           Executor&& executor = ThreadExecutor{},
+//                                           size_t chunkLength = kDefaultParallelChunkLength)
+//
+// The threads are provided by an executor: a callable object invoked as
+//
+//        executor(taskCount, task)
+//
+// which must call task(i) once for each i in [0, taskCount), on any threads,
+// and return when all the calls have returned (e.g. a parallel for loop of
+// a thread pool). The tasks don't throw.
+// ThreadExecutor, the default, runs the tasks on std::threads started
+// for the call, one per hardware thread.
+//
+// Inputs not longer than a chunk are converted on the calling thread,
+// as the single-threaded conversions do.
+// Invalid input is signaled throwing UnicodeConversionException, with the same
+// offset and kind of error as the single-threaded conversions.
+//
+// These functions live under the UnicodeConvAtlStd namespace.
+// They depend only on the C++ Standard Library.
+//
+//
+// The MIT License(MIT)
+//
+// Copyright(c) 2010-2023 by Giovanni Dicanio
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//------------------------------------------------------------------------------
+
+
+//==============================================================================
+//                              Includes
+//==============================================================================
+
+#include <algorithm>    // std::min, std::max
+#include <atomic>       // std::atomic
+#include <cstddef>      // std::size_t
+#include <exception>    // std::exception_ptr
+#include <string>       // std::string, std::u16string
+#include <string_view>  // std::string_view, std::u16string_view
+#include <thread>       // std::thread
+#include <vector>       // std::vector
+
+#include "UnicodeConvCore.hpp"  // Portable transcoding core
+
+
+//==============================================================================
+//                              Implementation
+//==============================================================================
+
+namespace UnicodeConvAtlStd {
+
+//------------------------------------------------------------------------------
+// Default length of the chunks converted by each task, in input code units:
+// large enough for the per-task overhead to be negligible, small enough
+// to balance the load among the threads.
+//------------------------------------------------------------------------------
+inline constexpr std::size_t kDefaultParallelChunkLength = std::size_t{ 1 } << 20;
+
+
+//------------------------------------------------------------------------------
+// Executor running the tasks on std::threads started for each call
+// (the calling thread runs tasks, too). Each thread takes the next task
+// left, until none is left.
+//------------------------------------------------------------------------------
+class ThreadExecutor
+{
+public:
+
+    //--------------------------------------------------------------------------
+    // Run the tasks on up to threadCount threads;
+    // 0 means one per hardware thread
+    //--------------------------------------------------------------------------
+    explicit ThreadExecutor(unsigned int threadCount = 0) noexcept
+        : m_threadCount((threadCount != 0) ? threadCount : std::thread::hardware_concurrency())
+    {
+        // hardware_concurrency() returns 0 if it can't tell
+        if (m_threadCount == 0)
+        {
+            m_threadCount = 1;
+        }
+    }
+
+    [[nodiscard]] unsigned int GetThreadCount() const noexcept
+    {
+        return m_threadCount;
+    }
+
+    //--------------------------------------------------------------------------
+    // Call task(i) for each i in [0, taskCount), and wait for all the calls
+    //--------------------------------------------------------------------------
+    template <typename Task>
+    void operator()(std::size_t taskCount, const Task& task) const
+    {
+        if (taskCount == 0)
+        {
+            return;
+        }
+
+        std::atomic<std::size_t> nextTask{ 0 };
+        const auto runTasks = [&]
+        {
+            for (std::size_t i = nextTask++; i < taskCount; i = nextTask++)
+            {
+                task(i);
+            }
+        };
+
+        // The threads are joined even if starting one of them throws
+        struct ThreadJoiner
+        {
+            std::vector<std::thread> threads;
+
+            ~ThreadJoiner()
+            {
+                for (std::thread& thread : threads)
+                {
+                    thread.join();
+                }
+            }
+        } helpers;
+
+        const std::size_t helperCount = (std::min<std::size_t>)(m_threadCount, taskCount) - 1;
+        helpers.threads.reserve(helperCount);
+        for (std::size_t i = 0; i < helperCount; i++)
+        {
+            helpers.threads.emplace_back(runTasks);
+        }
+        runTasks();
+    }
+
+private:
+    unsigned int m_threadCount;
+};
+
+
+namespace Details
+{
+
+//------------------------------------------------------------------------------
+// Parallel conversion of src into a new string of type OutputString:
+// split the input into chunks with splitChunk(src, remainingLength, chunkLength),
+// measure them in parallel with measure(src, length), allocate the output once,
+// and convert them in parallel with convertBounded(src, length, dst, capacity).
+// Signal errors throwing the ConversionError returned by describe(src, offset)
+// for the first invalid chunk.
+//------------------------------------------------------------------------------
+template <typename OutputString, typename SrcChar, typename Executor,
+          typename SplitChunk, typename Measure, typename ConvertBounded, typename Describe>
+[[nodiscard]] OutputString ConvertParallel(
+    const SrcChar* src, std::size_t srcLength,
+    Executor& executor, std::size_t chunkLength,
+    SplitChunk splitChunk, Measure measure, ConvertBounded convertBounded, Describe describe)
+{
+    // Split the input at code point boundaries: a boundary is at most
+    // 3 code units before the chunk length, so chunks of at least 4 code units
+    // are never empty
+    chunkLength = (std::max<std::size_t>)(chunkLength, 4);
+    std::vector<std::size_t> chunkOffsets = { 0 };
+    while (chunkOffsets.back() < srcLength)
+    {
+        const std::size_t offset = chunkOffsets.back();
+        chunkOffsets.push_back(offset + splitChunk(src + offset, srcLength - offset, chunkLength));
+    }
+    const std::size_t chunkCount = chunkOffsets.size() - 1;
+
+    // Measure (and validate) the chunks in parallel
+    std::vector<ConversionResult> measured(chunkCount);
+    executor(chunkCount, [&](std::size_t i)
+    {
+        measured[i] = measure(src + chunkOffsets[i], chunkOffsets[i + 1] - chunkOffsets[i]);
+    });
+
+    // Prefix sum of the output lengths; the first invalid chunk,
+    // after valid ones, holds the first error of the input
+    std::vector<std::size_t> outputOffsets(chunkCount + 1, 0);
+    for (std::size_t i = 0; i < chunkCount; i++)
+    {
+        if (measured[i].status != ConversionStatus::Ok)
+        {
+            ThrowConversionError(describe(src, chunkOffsets[i] + measured[i].unitsRead));
+        }
+        outputOffsets[i + 1] = outputOffsets[i] + measured[i].unitsWritten;
+    }
+
+    // Convert the chunks in parallel, each into its slice of the output:
+    // the bounded conversion doesn't write past the end of the slice
+    const auto convertChunks = [&](auto* data)
+    {
+        executor(chunkCount, [&](std::size_t i)
+        {
+            (void)convertBounded(src + chunkOffsets[i], chunkOffsets[i + 1] - chunkOffsets[i],
+                                 data + outputOffsets[i], outputOffsets[i + 1] - outputOffsets[i]);
+        });
+    };
+
+    OutputString output;
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+    // The writer of resize_and_overwrite must not throw: the exceptions
+    // of the executor (e.g. std::system_error if a thread can't be created)
+    // are thrown after the output string is resized
+    std::exception_ptr executorError;
+    ResizeAndOverwrite(output, outputOffsets[chunkCount], [&](auto* data, std::size_t length)
+    {
+        try
+        {
+            convertChunks(data);
+        }
+        catch (...)
+        {
+            executorError = std::current_exception();
+            return std::size_t{ 0 };
+        }
+        return length;
+    });
+
+    if (executorError)
+    {
+        std::rethrow_exception(executorError);
+    }
+#else
+    ResizeAndOverwrite(output, outputOffsets[chunkCount], [&](auto* data, std::size_t length)
+    {
+        convertChunks(data);
+        return length;
+    });
+#endif
+
+    return output;
+}
+
+} // namespace Details
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-16 to UTF-8 on several threads, provided by the executor.
+// Inputs not longer than chunkLength are converted on the calling thread.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+template <typename Executor = ThreadExecutor>
+[[nodiscard]] std::string Utf16ToUtf8Parallel(
+    std::u16string_view utf16,
+    Executor&& executor = Executor{},
+    std::size_t chunkLength = kDefaultParallelChunkLength)
+{
+    if (utf16.length() <= chunkLength)
+    {
+        return Utf16ToUtf8(utf16);
+    }
+
+    return Details::ConvertParallel<std::string>(
+        utf16.data(), utf16.length(), executor, chunkLength,
+        Details::Utf16ChunkBoundary,
+        Details::MeasureUtf16ToUtf8,
+        Details::ConvertUtf16ToUtf8Bounded,
+        Details::DescribeUtf16Error);
+}
+
+
+//------------------------------------------------------------------------------
+// Convert from UTF-8 to UTF-16 on several threads, provided by the executor.
+// Inputs not longer than chunkLength are converted on the calling thread.
+// Signal errors throwing UnicodeConversionException.
+//------------------------------------------------------------------------------
+template <typename Executor = ThreadExecutor>
+[[nodiscard]] std::u16string Utf8ToUtf16Parallel(
+    std::string_view utf8,
+    Executor&& executor = Executor{},
+    std::size_t chunkLength = kDefaultParallelChunkLength)
+{
+    if (utf8.length() <= chunkLength)
+    {
+        return Utf8ToUtf16(utf8);
+    }
+
+    return Details::ConvertParallel<std::u16string>(
+        utf8.data(), utf8.length(), executor, chunkLength,
+        Details::Utf8ChunkBoundary,
+        Details::MeasureUtf8ToUtf16,
+        Details::ConvertUtf8ToUtf16Bounded,
+        [&utf8](const char* src, std::size_t offset)
+        {
+            return Details::DescribeUtf8Error(src, utf8.length(), offset);
+        });
+}
+
+} // namespace UnicodeConvAtlStd
+
+
+#endif // GIOVANNI_DICANIO_UNICODECONVPARALLEL_HPP_INCLUDED
@@ -0,0 +1,1687 @@
+#ifndef GIOVANNI_DICANIO_UNICODECONVSIMD_HPP_INCLUDED
+#define GIOVANNI_DICANIO_UNICODECONVSIMD_HPP_INCLUDED
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Vectorized kernels for the portable UTF-16/UTF-8 transcoding core
+//
+//                  Copyright (C) by Giovanni Dicanio
+//                    <giovanni.dicanio AT gmail.com>
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+//------------------------------------------------------------------------------
+// This header is an implementation detail of UnicodeConvCore.hpp.
+//
+// The kernels convert the leading part of their input that they can handle
+// with vector instructions, and return how far they got. They never consume
+// an invalid or incomplete sequence: they stop before it, and let the scalar
+// code of the core convert it or report the error.
+//
+// The kernels are available on x86-64, in tiers of instruction sets
+// (see KernelTier). The best tier the processor supports is detected once
+// with cpuid, and its kernels are called through cached function pointers,
+// so a single binary runs everywhere. Define UNICODECONVATLSTD_NO_SIMD
+// to build the core without kernels.
+//
+// The tier can be forced to a lower one, e.g. for benchmarking or bug triage,
+// calling SetKernelTier(), or setting the UNICODECONVATLSTD_KERNEL_TIER
+// environment variable to one of: scalar, sse2, sse4.2, avx2, avx512.
+//
+//------------------------------------------------------------------------------
+//
+// The MIT License(MIT)
+//
+// Copyright(c) 2010-2023 by Giovanni Dicanio
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//------------------------------------------------------------------------------
+
+
+//==============================================================================
+//                              Includes
+//==============================================================================
+
+#include <atomic>       // std::atomic
+#include <cstddef>      // std::size_t, std::ptrdiff_t
+#include <cstdint>      // std::uint8_t, std::int32_t, std::uint32_t
+#include <cstdlib>      // std::getenv, std::free
+#include <cstring>      // std::strcmp
+
+#if !defined(UNICODECONVATLSTD_NO_SIMD) && (defined(_M_X64) || defined(__x86_64__))
+#define UNICODECONVATLSTD_X64_SIMD 1
+#endif
+
+#if defined(UNICODECONVATLSTD_X64_SIMD)
+#include <immintrin.h>  // SSE/AVX intrinsics
+#if defined(_MSC_VER)
+#include <intrin.h>     // _BitScanForward, __cpuidex
+#else
+#include <cpuid.h>      // __cpuid_count
+#endif
+#endif
+
+
+//==============================================================================
+//                              Implementation
+//==============================================================================
+
+//
+// Enable instruction set extensions on a per-function basis.
+// GCC and Clang require this to use the corresponding intrinsics;
+// MSVC always allows them.
+//
+#if defined(__GNUC__) || defined(__clang__)
+#define UNICODECONVATLSTD_TARGET(features) __attribute__((target(features)))
+#else
+#define UNICODECONVATLSTD_TARGET(features)
+#endif
+
+#define UNICODECONVATLSTD_TARGET_SSE42 UNICODECONVATLSTD_TARGET("sse4.2,popcnt")
+#define UNICODECONVATLSTD_TARGET_AVX2 UNICODECONVATLSTD_TARGET("avx2,bmi,bmi2,popcnt")
+#define UNICODECONVATLSTD_TARGET_AVX512 \
+    UNICODECONVATLSTD_TARGET("avx2,bmi,bmi2,popcnt,avx512f,avx512bw,avx512vl,avx512vbmi2")
+
+
+namespace UnicodeConvAtlStd {
+
+//------------------------------------------------------------------------------
+// Instruction set tiers of the vectorized kernels, from the lowest.
+// The conversions pick the best one the processor supports at run time.
+//------------------------------------------------------------------------------
+enum class KernelTier
+{
+    Scalar,     // No vectorized kernels
+    Sse2,       // Baseline x86-64
+    Sse42,      // SSSE3, SSE4.1, SSE4.2, POPCNT
+    Avx2,       // AVX2, BMI1, BMI2
+    Avx512,     // AVX-512 F, BW, VL, VBMI2
+};
+
+
+//------------------------------------------------------------------------------
+// Return the name of a kernel tier, as accepted by the
+// UNICODECONVATLSTD_KERNEL_TIER environment variable
+//------------------------------------------------------------------------------
+[[nodiscard]] inline const char* GetKernelTierName(KernelTier tier) noexcept
+{
+    switch (tier)
+    {
+    case KernelTier::Scalar: return "scalar";
+    case KernelTier::Sse2:   return "sse2";
+    case KernelTier::Sse42:  return "sse4.2";
+    case KernelTier::Avx2:   return "avx2";
+    case KernelTier::Avx512: return "avx512";
+    }
+    return "unknown";
+}
+
+
+namespace Details
+{
+
+//------------------------------------------------------------------------------
+// How far a vectorized kernel got: both counts are in code units,
+// and the conversion kernels always stop at a sequence boundary.
+//------------------------------------------------------------------------------
+struct KernelProgress
+{
+    std::size_t unitsRead;
+    std::size_t unitsWritten;
+};
+
+
+//------------------------------------------------------------------------------
+// Shuffle masks to compress the kept 16-bit lanes of an 8-lane vector
+// to its front, indexed by the 8-bit mask of the lanes to keep.
+//------------------------------------------------------------------------------
+struct Compress16Table
+{
+    alignas(16) std::uint8_t shuffle[256][16];
+    std::uint8_t count[256];
+};
+
+constexpr Compress16Table MakeCompress16Table() noexcept
+{
+    Compress16Table table{};
+    for (unsigned int mask = 0; mask < 256; mask++)
+    {
+        unsigned int kept = 0;
+        for (unsigned int lane = 0; lane < 8; lane++)
+        {
+            if (mask & (1u << lane))
+            {
+                table.shuffle[mask][2 * kept] = static_cast<std::uint8_t>(2 * lane);
+                table.shuffle[mask][2 * kept + 1] = static_cast<std::uint8_t>(2 * lane + 1);
+                kept++;
+            }
+        }
+        for (unsigned int i = 2 * kept; i < 16; i++)
+        {
+            // pshufb zeroes the destination bytes whose index has the high bit set
+            table.shuffle[mask][i] = 0x80;
+        }
+        table.count[mask] = static_cast<std::uint8_t>(kept);
+    }
+    return table;
+}
+
+inline constexpr Compress16Table kCompress16Table = MakeCompress16Table();
+
+
+//------------------------------------------------------------------------------
+// Shuffle masks to pack the UTF-8 encodings of 4 BMP code points,
+// computed in 32-bit lanes (lead byte first), into consecutive bytes.
+// The index is the 4-bit mask of the lanes at or above U+0080, plus the
+// 4-bit mask of the lanes at or above U+0800 shifted left by 4.
+//------------------------------------------------------------------------------
+struct Utf8PackTable
+{
+    alignas(16) std::uint8_t shuffle[256][16];
+    std::uint8_t length[256];
+};
+
+constexpr Utf8PackTable MakeUtf8PackTable() noexcept
+{
+    Utf8PackTable table{};
+    for (unsigned int index = 0; index < 256; index++)
+    {
+        unsigned int length = 0;
+        for (unsigned int lane = 0; lane < 4; lane++)
+        {
+            const unsigned int laneLength = 1
+                + ((index >> lane) & 1)
+                + ((index >> (lane + 4)) & 1);
+            for (unsigned int i = 0; i < laneLength; i++)
+            {
+                table.shuffle[index][length++] = static_cast<std::uint8_t>(4 * lane + i);
+            }
+        }
+        for (unsigned int i = length; i < 16; i++)
+        {
+            table.shuffle[index][i] = 0x80;
+        }
+        table.length[index] = static_cast<std::uint8_t>(length);
+    }
+    return table;
+}
+
+inline constexpr Utf8PackTable kUtf8PackTable = MakeUtf8PackTable();
+
+
+#if defined(UNICODECONVATLSTD_X64_SIMD)
+
+//------------------------------------------------------------------------------
+// Index of the lowest set bit of a non-zero value
+//------------------------------------------------------------------------------
+inline unsigned int CountTrailingZeros(std::uint32_t value) noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index = 0;
+    _BitScanForward(&index, value);
+    return static_cast<unsigned int>(index);
+#else
+    return static_cast<unsigned int>(__builtin_ctz(value));
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+// Widen 16 ASCII chars to 16 UTF-16 code units
+//------------------------------------------------------------------------------
+inline void StoreWidenedAscii16(__m128i in, char16_t* dst) noexcept
+{
+    const __m128i zero = _mm_setzero_si128();
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi8(in, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), _mm_unpackhi_epi8(in, zero));
+}
+
+
+//------------------------------------------------------------------------------
+// Decode 16 UTF-8 chars made of 8 complete 2-char sequences,
+// seen as 8 little-endian 16-bit lanes (lead in the low byte).
+// Returns false, without writing, if the block isn't exactly that.
+//------------------------------------------------------------------------------
+inline bool DecodeUtf8TwoByteRun16(__m128i in, char16_t* dst) noexcept
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    // Every lane must be 110xxxxx 10xxxxxx
+    const __m128i pattern = _mm_cmpeq_epi16(
+        _mm_and_si128(in, _mm_set1_epi16(static_cast<short>(0xC0E0))),
+        _mm_set1_epi16(static_cast<short>(0x80C0)));
+
+    // Overlong C0/C1 leads have no payload bits above the low one
+    const __m128i overlong = _mm_cmpeq_epi16(
+        _mm_and_si128(in, _mm_set1_epi16(0x001E)), zero);
+
+    if (_mm_movemask_epi8(_mm_andnot_si128(overlong, pattern)) != 0xFFFF)
+    {
+        return false;
+    }
+
+    const __m128i codePoints = _mm_or_si128(
+        _mm_slli_epi16(_mm_and_si128(in, _mm_set1_epi16(0x001F)), 6),
+        _mm_and_si128(_mm_srli_epi16(in, 8), _mm_set1_epi16(0x003F)));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), codePoints);
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
+// SSE2 UTF-8 to UTF-16 kernel: ASCII runs and runs of 2-char sequences,
+// 16 chars per iteration.
+// The destination must have room for at least srcLength code units.
+//------------------------------------------------------------------------------
+inline KernelProgress ConvertUtf8ToUtf16Sse2(
+    const char* src, std::size_t srcLength, char16_t* dst) noexcept
+{
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    while (srcLength - read >= 16)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + read));
+        const int nonAsciiMask = _mm_movemask_epi8(in);
+
+        if (nonAsciiMask == 0)
+        {
+            StoreWidenedAscii16(in, dst + written);
+            read += 16;
+            written += 16;
+            continue;
+        }
+
+        if (nonAsciiMask == 0xFFFF && DecodeUtf8TwoByteRun16(in, dst + written))
+        {
+            read += 16;
+            written += 8;
+            continue;
+        }
+
+        // Keep the ASCII prefix of the block, and leave the rest to the scalar code.
+        // There is always room for 16 code units here, as each char produces at most one.
+        const unsigned int asciiPrefix = CountTrailingZeros(static_cast<std::uint32_t>(nonAsciiMask));
+        StoreWidenedAscii16(in, dst + written);
+        read += asciiPrefix;
+        written += asciiPrefix;
+        break;
+    }
+
+    return { read, written };
+}
+
+
+//------------------------------------------------------------------------------
+// Decode 16 UTF-8 chars made of any mix of ASCII chars and complete
+// 2-char sequences (a 2-char lead in the last byte is left for later).
+// Returns the number of chars consumed, or 0 if the block isn't of that kind.
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET("ssse3")
+inline std::size_t DecodeUtf8OneTwoByteMix16(
+    __m128i in, char16_t* dst, std::size_t& written) noexcept
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    // 3- and 4-char leads (and invalid bytes above them) are not handled here
+    const __m128i e0 = _mm_set1_epi8(static_cast<char>(0xE0));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(in, e0), e0)) != 0)
+    {
+        return 0;
+    }
+
+    // Overlong C0/C1 leads
+    const __m128i overlong = _mm_cmpeq_epi8(
+        _mm_and_si128(in, _mm_set1_epi8(static_cast<char>(0xFE))),
+        _mm_set1_epi8(static_cast<char>(0xC0)));
+    if (_mm_movemask_epi8(overlong) != 0)
+    {
+        return 0;
+    }
+
+    const unsigned int highMask = static_cast<unsigned int>(_mm_movemask_epi8(in));
+    const unsigned int continuationMask = static_cast<unsigned int>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(
+            _mm_and_si128(in, _mm_set1_epi8(static_cast<char>(0xC0))),
+            _mm_set1_epi8(static_cast<char>(0x80)))));
+    const unsigned int leadMask = highMask & ~continuationMask;
+
+    // Each lead must be followed by exactly one continuation byte
+    // (the block starts at a sequence boundary)
+    if (continuationMask != ((leadMask << 1) & 0xFFFF))
+    {
+        return 0;
+    }
+
+    // A lead in the last byte has its continuation in the next block
+    const bool splitAtEnd = (leadMask & 0x8000) != 0;
+    const unsigned int keepMask = ~continuationMask & (splitAtEnd ? 0x7FFFu : 0xFFFFu);
+
+    // Pair every char with the next one in 16-bit lanes:
+    // ASCII lanes keep the low byte, lead lanes combine both bytes
+    const __m128i next = _mm_srli_si128(in, 1);
+    const __m128i halves[2] = { _mm_unpacklo_epi8(in, next), _mm_unpackhi_epi8(in, next) };
+
+    for (int half = 0; half < 2; half++)
+    {
+        const __m128i lanes = halves[half];
+        const __m128i isAscii = _mm_cmpeq_epi16(_mm_and_si128(lanes, _mm_set1_epi16(0x0080)), zero);
+        const __m128i ascii = _mm_and_si128(lanes, _mm_set1_epi16(0x007F));
+        const __m128i twoByte = _mm_or_si128(
+            _mm_slli_epi16(_mm_and_si128(lanes, _mm_set1_epi16(0x001F)), 6),
+            _mm_and_si128(_mm_srli_epi16(lanes, 8), _mm_set1_epi16(0x003F)));
+        const __m128i codeUnits = _mm_or_si128(
+            _mm_and_si128(isAscii, ascii),
+            _mm_andnot_si128(isAscii, twoByte));
+
+        const unsigned int laneMask = (keepMask >> (8 * half)) & 0xFF;
+        const __m128i shuffle = _mm_load_si128(
+            reinterpret_cast<const __m128i*>(kCompress16Table.shuffle[laneMask]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + written), _mm_shuffle_epi8(codeUnits, shuffle));
+        written += kCompress16Table.count[laneMask];
+    }
+
+    return splitAtEnd ? 15 : 16;
+}
+
+
+//------------------------------------------------------------------------------
+// Decode 12 UTF-8 chars made of 4 complete 3-char sequences
+// (the other 4 chars of the 16-char block are ignored).
+// Returns false, without writing, if the block doesn't start that way.
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET("ssse3")
+inline bool DecodeUtf8ThreeByteRun12(__m128i in, char16_t* dst) noexcept
+{
+    // Leads are 1110xxxx, continuation bytes are 10xxxxxx
+    const __m128i patternMask = _mm_setr_epi8(
+        static_cast<char>(0xF0), static_cast<char>(0xC0), static_cast<char>(0xC0),
+        static_cast<char>(0xF0), static_cast<char>(0xC0), static_cast<char>(0xC0),
+        static_cast<char>(0xF0), static_cast<char>(0xC0), static_cast<char>(0xC0),
+        static_cast<char>(0xF0), static_cast<char>(0xC0), static_cast<char>(0xC0),
+        0, 0, 0, 0);
+    const __m128i patternValue = _mm_setr_epi8(
+        static_cast<char>(0xE0), static_cast<char>(0x80), static_cast<char>(0x80),
+        static_cast<char>(0xE0), static_cast<char>(0x80), static_cast<char>(0x80),
+        static_cast<char>(0xE0), static_cast<char>(0x80), static_cast<char>(0x80),
+        static_cast<char>(0xE0), static_cast<char>(0x80), static_cast<char>(0x80),
+        0, 0, 0, 0);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(in, patternMask), patternValue)) != 0xFFFF)
+    {
+        return false;
+    }
+
+    // Gather each sequence in a 32-bit lane, as lead << 16 | second << 8 | third
+    const __m128i gather = _mm_setr_epi8(
+        2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m128i lanes = _mm_shuffle_epi8(in, gather);
+
+    const __m128i codePoints = _mm_or_si128(
+        _mm_or_si128(
+            _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(lanes, 16), _mm_set1_epi32(0x0F)), 12),
+            _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(lanes, 8), _mm_set1_epi32(0x3F)), 6)),
+        _mm_and_si128(lanes, _mm_set1_epi32(0x3F)));
+
+    // Reject overlong forms (below U+0800) and encoded surrogates (U+D800-U+DFFF)
+    const __m128i overlong = _mm_cmplt_epi32(codePoints, _mm_set1_epi32(0x800));
+    const __m128i surrogate = _mm_cmpeq_epi32(
+        _mm_and_si128(codePoints, _mm_set1_epi32(0xF800)), _mm_set1_epi32(0xD800));
+    if (_mm_movemask_epi8(_mm_or_si128(overlong, surrogate)) != 0)
+    {
+        return false;
+    }
+
+    // Narrow the 32-bit lanes to 16-bit code units
+    const __m128i narrow = _mm_setr_epi8(
+        0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_shuffle_epi8(codePoints, narrow));
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
+// Decode a block of 16 UTF-8 chars at src + read with the 128-bit paths:
+// ASCII, mixes of ASCII and 2-char sequences, runs of 3-char sequences.
+// Returns false if the block must be left to the scalar code,
+// after converting its ASCII prefix.
+// The destination must have room for at least 16 more code units.
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_SSE42
+inline bool DecodeUtf8Block16(
+    const char* src, char16_t* dst, std::size_t& read, std::size_t& written) noexcept
+{
+    const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + read));
+    const int nonAsciiMask = _mm_movemask_epi8(in);
+
+    if (nonAsciiMask == 0)
+    {
+        StoreWidenedAscii16(in, dst + written);
+        read += 16;
+        written += 16;
+        return true;
+    }
+
+    const std::size_t mixRead = DecodeUtf8OneTwoByteMix16(in, dst, written);
+    if (mixRead != 0)
+    {
+        read += mixRead;
+        return true;
+    }
+
+    if (DecodeUtf8ThreeByteRun12(in, dst + written))
+    {
+        read += 12;
+        written += 4;
+        return true;
+    }
+
+    const unsigned int asciiPrefix = CountTrailingZeros(static_cast<std::uint32_t>(nonAsciiMask));
+    StoreWidenedAscii16(in, dst + written);
+    read += asciiPrefix;
+    written += asciiPrefix;
+    return false;
+}
+
+
+//------------------------------------------------------------------------------
+// SSE4.2 UTF-8 to UTF-16 kernel: ASCII runs and mixes of ASCII
+// and 2-char sequences 16 chars per iteration,
+// runs of 3-char sequences 12 chars per iteration.
+// The destination must have room for at least srcLength code units.
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_SSE42
+inline KernelProgress ConvertUtf8ToUtf16Sse42(
+    const char* src, std::size_t srcLength, char16_t* dst) noexcept
+{
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    while (srcLength - read >= 16 && DecodeUtf8Block16(src, dst, read, written))
+    {
+    }
+
+    return { read, written };
+}
+
+
+//------------------------------------------------------------------------------
+// AVX2 UTF-8 to UTF-16 kernel: as the SSE4.2 kernel,
+// plus ASCII runs 32 chars per iteration.
+// The destination must have room for at least srcLength code units.
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_AVX2
+inline KernelProgress ConvertUtf8ToUtf16Avx2(
+    const char* src, std::size_t srcLength, char16_t* dst) noexcept
+{
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    while (srcLength - read >= 16)
+    {
+        if (srcLength - read >= 32)
+        {
+            const __m256i in32 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + read));
+            if (_mm256_movemask_epi8(in32) == 0)
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + written),
+                                    _mm256_cvtepu8_epi16(_mm256_castsi256_si128(in32)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + written + 16),
+                                    _mm256_cvtepu8_epi16(_mm256_extracti128_si256(in32, 1)));
+                read += 32;
+                written += 32;
+                continue;
+            }
+        }
+
+        if (!DecodeUtf8Block16(src, dst, read, written))
+        {
+            break;
+        }
+    }
+
+    return { read, written };
+}
+
+
+//------------------------------------------------------------------------------
+// SSE2 UTF-16 to UTF-8 kernel: ASCII runs, 16 code units per iteration.
+// The destination must have room for at least
+// kMaxUtf8CharsPerUtf16Unit * srcLength chars.
+//------------------------------------------------------------------------------
+inline KernelProgress ConvertUtf16ToUtf8Sse2(
+    const char16_t* src, std::size_t srcLength, char* dst) noexcept
+{
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    while (srcLength - read >= 16)
+    {
+        const __m128i in0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + read));
+        const __m128i in1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + read + 8));
+
+        // ASCII code units have no bits set above the low 7
+        const __m128i nonAsciiBits = _mm_set1_epi16(static_cast<short>(0xFF80));
+        const __m128i isAscii0 = _mm_cmpeq_epi16(_mm_and_si128(in0, nonAsciiBits), _mm_setzero_si128());
+        const __m128i isAscii1 = _mm_cmpeq_epi16(_mm_and_si128(in1, nonAsciiBits), _mm_setzero_si128());
+        const int asciiMask = _mm_movemask_epi8(_mm_packs_epi16(isAscii0, isAscii1));
+
+        // Saturation leaves ASCII code units as they are
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + written), _mm_packus_epi16(in0, in1));
+
+        if (asciiMask == 0xFFFF)
+        {
+            read += 16;
+            written += 16;
+            continue;
+        }
+
+        // Keep the ASCII prefix of the block, and leave the rest to the scalar code
+        const unsigned int asciiPrefix = CountTrailingZeros(static_cast<std::uint32_t>(~asciiMask));
+        read += asciiPrefix;
+        written += asciiPrefix;
+        break;
+    }
+
+    return { read, written };
+}
+
+
+//------------------------------------------------------------------------------
+// Compute the UTF-8 encodings of BMP code points (no surrogates)
+// in 32-bit lanes, lead byte first
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_SSE42
+inline __m128i EncodeUtf8Lanes(__m128i codePoints, __m128i atLeast80, __m128i atLeast800) noexcept
+{
+    const __m128i lowBits = _mm_or_si128(
+        _mm_and_si128(codePoints, _mm_set1_epi32(0x3F)), _mm_set1_epi32(0x80));
+
+    const __m128i twoBytes = _mm_or_si128(
+        _mm_or_si128(_mm_srli_epi32(codePoints, 6), _mm_set1_epi32(0xC0)),
+        _mm_slli_epi32(lowBits, 8));
+
+    const __m128i middleBits = _mm_or_si128(
+        _mm_and_si128(_mm_srli_epi32(codePoints, 6), _mm_set1_epi32(0x3F)),
+        _mm_set1_epi32(0x80));
+    const __m128i threeBytes = _mm_or_si128(
+        _mm_or_si128(_mm_srli_epi32(codePoints, 12), _mm_set1_epi32(0xE0)),
+        _mm_or_si128(_mm_slli_epi32(middleBits, 8), _mm_slli_epi32(lowBits, 16)));
+
+    return _mm_blendv_epi8(
+        _mm_blendv_epi8(codePoints, twoBytes, atLeast80),
+        threeBytes,
+        atLeast800);
+}
+
+
+//------------------------------------------------------------------------------
+// Encode the low 4 BMP code units (no surrogates) of a vector to UTF-8.
+// Writes up to 12 bytes past the returned length.
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_SSE42
+inline std::size_t EncodeUtf8Bmp4(__m128i in, char* dst) noexcept
+{
+    const __m128i codePoints = _mm_cvtepu16_epi32(in);
+    const __m128i atLeast80 = _mm_cmpgt_epi32(codePoints, _mm_set1_epi32(0x7F));
+    const __m128i atLeast800 = _mm_cmpgt_epi32(codePoints, _mm_set1_epi32(0x7FF));
+    const __m128i lanes = EncodeUtf8Lanes(codePoints, atLeast80, atLeast800);
+
+    const unsigned int index = static_cast<unsigned int>(_mm_movemask_ps(_mm_castsi128_ps(atLeast80)))
+        | (static_cast<unsigned int>(_mm_movemask_ps(_mm_castsi128_ps(atLeast800))) << 4);
+    const __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(kUtf8PackTable.shuffle[index]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_shuffle_epi8(lanes, shuffle));
+
+    return kUtf8PackTable.length[index];
+}
+
+
+//------------------------------------------------------------------------------
+// SSE4.2 UTF-16 to UTF-8 kernel, 8 code units per iteration:
+// ASCII runs are narrowed, other BMP code points are encoded in 32-bit lanes
+// and packed with shuffle tables. Blocks with surrogates are left
+// to the scalar code.
+// The destination must have room for at least
+// kMaxUtf8CharsPerUtf16Unit * srcLength chars.
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_SSE42
+inline KernelProgress ConvertUtf16ToUtf8Sse42(
+    const char16_t* src, std::size_t srcLength, char* dst) noexcept
+{
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    // EncodeUtf8Bmp4 writes up to 12 bytes past its output: 2 more code units
+    // of input guarantee at least 18 bytes of room for its second call
+    while (srcLength - read >= 8 + 2)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + read));
+
+        if (_mm_testz_si128(in, _mm_set1_epi16(static_cast<short>(0xFF80))))
+        {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + written), _mm_packus_epi16(in, in));
+            read += 8;
+            written += 8;
+            continue;
+        }
+
+        const __m128i surrogates = _mm_cmpeq_epi16(
+            _mm_and_si128(in, _mm_set1_epi16(static_cast<short>(0xF800))),
+            _mm_set1_epi16(static_cast<short>(0xD800)));
+        if (_mm_movemask_epi8(surrogates) != 0)
+        {
+            break;
+        }
+
+        written += EncodeUtf8Bmp4(in, dst + written);
+        written += EncodeUtf8Bmp4(_mm_srli_si128(in, 8), dst + written);
+        read += 8;
+    }
+
+    return { read, written };
+}
+
+
+//------------------------------------------------------------------------------
+// Compute the UTF-8 encodings of BMP code points (no surrogates)
+// in 32-bit lanes, lead byte first
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_AVX2
+inline __m256i EncodeUtf8Lanes(__m256i codePoints, __m256i atLeast80, __m256i atLeast800) noexcept
+{
+    const __m256i lowBits = _mm256_or_si256(
+        _mm256_and_si256(codePoints, _mm256_set1_epi32(0x3F)), _mm256_set1_epi32(0x80));
+
+    const __m256i twoBytes = _mm256_or_si256(
+        _mm256_or_si256(_mm256_srli_epi32(codePoints, 6), _mm256_set1_epi32(0xC0)),
+        _mm256_slli_epi32(lowBits, 8));
+
+    const __m256i middleBits = _mm256_or_si256(
+        _mm256_and_si256(_mm256_srli_epi32(codePoints, 6), _mm256_set1_epi32(0x3F)),
+        _mm256_set1_epi32(0x80));
+    const __m256i threeBytes = _mm256_or_si256(
+        _mm256_or_si256(_mm256_srli_epi32(codePoints, 12), _mm256_set1_epi32(0xE0)),
+        _mm256_or_si256(_mm256_slli_epi32(middleBits, 8), _mm256_slli_epi32(lowBits, 16)));
+
+    return _mm256_blendv_epi8(
+        _mm256_blendv_epi8(codePoints, twoBytes, atLeast80),
+        threeBytes,
+        atLeast800);
+}
+
+
+//------------------------------------------------------------------------------
+// Encode 8 BMP code units (no surrogates) to UTF-8.
+// Writes up to 12 bytes past the returned length: the second 16-byte store
+// follows the first 4 code points, which can pack to only 4 bytes.
+// In all, at most 28 bytes are written (12 bytes, then 16).
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_AVX2
+inline std::size_t EncodeUtf8Bmp8(__m128i in, char* dst) noexcept
+{
+    const __m256i codePoints = _mm256_cvtepu16_epi32(in);
+    const __m256i atLeast80 = _mm256_cmpgt_epi32(codePoints, _mm256_set1_epi32(0x7F));
+    const __m256i atLeast800 = _mm256_cmpgt_epi32(codePoints, _mm256_set1_epi32(0x7FF));
+    const __m256i lanes = EncodeUtf8Lanes(codePoints, atLeast80, atLeast800);
+
+    const unsigned int mask80 = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(atLeast80)));
+    const unsigned int mask800 = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(atLeast800)));
+    const unsigned int index0 = (mask80 & 0x0F) | ((mask800 & 0x0F) << 4);
+    const unsigned int index1 = (mask80 >> 4) | (mask800 & 0xF0);
+
+    // pshufb works within each 128-bit half: 4 lanes each
+    const __m256i shuffle = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kUtf8PackTable.shuffle[index0]))),
+        _mm_load_si128(reinterpret_cast<const __m128i*>(kUtf8PackTable.shuffle[index1])),
+        1);
+    const __m256i packed = _mm256_shuffle_epi8(lanes, shuffle);
+
+    const std::size_t length0 = kUtf8PackTable.length[index0];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(packed));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + length0), _mm256_extracti128_si256(packed, 1));
+
+    return length0 + kUtf8PackTable.length[index1];
+}
+
+
+//------------------------------------------------------------------------------
+// AVX2 UTF-16 to UTF-8 kernel, 16 code units per iteration:
+// ASCII runs are narrowed, other BMP code points are encoded in 32-bit lanes
+// and packed with shuffle tables. Blocks with surrogates are left
+// to the scalar code.
+// The destination must have room for at least
+// kMaxUtf8CharsPerUtf16Unit * srcLength chars.
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_AVX2
+inline KernelProgress ConvertUtf16ToUtf8Avx2(
+    const char16_t* src, std::size_t srcLength, char* dst) noexcept
+{
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    // EncodeUtf8Bmp8 writes up to 12 bytes past its output, at most 28 bytes
+    // in all: 2 more code units of input guarantee at least 30 bytes of room
+    // for its second call (54 bytes for 18 code units, less at most 24 bytes
+    // written by the first call)
+    while (srcLength - read >= 16 + 2)
+    {
+        const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + read));
+
+        if (_mm256_testz_si256(in, _mm256_set1_epi16(static_cast<short>(0xFF80))))
+        {
+            const __m128i ascii = _mm_packus_epi16(
+                _mm256_castsi256_si128(in), _mm256_extracti128_si256(in, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + written), ascii);
+            read += 16;
+            written += 16;
+            continue;
+        }
+
+        // Surrogates (paired or lone) are found in registers,
+        // and left to the scalar code, after encoding the first half
+        // of the block if it has none
+        const __m256i surrogates = _mm256_cmpeq_epi16(
+            _mm256_and_si256(in, _mm256_set1_epi16(static_cast<short>(0xF800))),
+            _mm256_set1_epi16(static_cast<short>(0xD800)));
+        const unsigned int surrogateMask = static_cast<unsigned int>(_mm256_movemask_epi8(surrogates));
+        if (surrogateMask != 0)
+        {
+            if ((surrogateMask & 0xFFFF) == 0)
+            {
+                written += EncodeUtf8Bmp8(_mm256_castsi256_si128(in), dst + written);
+                read += 8;
+            }
+            break;
+        }
+
+        written += EncodeUtf8Bmp8(_mm256_castsi256_si128(in), dst + written);
+        written += EncodeUtf8Bmp8(_mm256_extracti128_si256(in, 1), dst + written);
+        read += 16;
+    }
+
+    return { read, written };
+}
+
+
+// GCC 12 AVX-512 intrinsics trigger spurious -Wmaybe-uninitialized warnings
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+//------------------------------------------------------------------------------
+// AVX-512 UTF-16 to UTF-8 kernel, 32 code units per iteration:
+// ASCII runs are narrowed, other BMP code points are encoded in 32-bit lanes
+// and packed with byte compression (VBMI2). Blocks with surrogates
+// and shorter tails are left to the AVX2 kernel.
+// The destination must have room for at least
+// kMaxUtf8CharsPerUtf16Unit * srcLength chars.
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_AVX512
+inline KernelProgress ConvertUtf16ToUtf8Avx512(
+    const char16_t* src, std::size_t srcLength, char* dst) noexcept
+{
+    // One bit for each byte of the 16 32-bit lanes
+    constexpr unsigned long long kLaneBytes = 0x1111111111111111ULL;
+
+    std::size_t read = 0;
+    std::size_t written = 0;
+
+    while (srcLength - read >= 32)
+    {
+        const __m512i in = _mm512_loadu_si512(src + read);
+
+        if (_mm512_test_epi16_mask(in, _mm512_set1_epi16(static_cast<short>(0xFF80))) == 0)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + written), _mm512_cvtepi16_epi8(in));
+            read += 32;
+            written += 32;
+            continue;
+        }
+
+        const __mmask32 surrogates = _mm512_cmpeq_epi16_mask(
+            _mm512_and_si512(in, _mm512_set1_epi16(static_cast<short>(0xF800))),
+            _mm512_set1_epi16(static_cast<short>(0xD800)));
+        if (surrogates != 0)
+        {
+            break;
+        }
+
+        for (std::size_t half = 0; half < 32; half += 16)
+        {
+            const __m512i codePoints = _mm512_cvtepu16_epi32(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + read + half)));
+            const __mmask16 atLeast80 = _mm512_cmpgt_epu32_mask(codePoints, _mm512_set1_epi32(0x7F));
+            const __mmask16 atLeast800 = _mm512_cmpgt_epu32_mask(codePoints, _mm512_set1_epi32(0x7FF));
+
+            const __m512i lowBits = _mm512_or_si512(
+                _mm512_and_si512(codePoints, _mm512_set1_epi32(0x3F)), _mm512_set1_epi32(0x80));
+            const __m512i twoBytes = _mm512_or_si512(
+                _mm512_or_si512(_mm512_srli_epi32(codePoints, 6), _mm512_set1_epi32(0xC0)),
+                _mm512_slli_epi32(lowBits, 8));
+            const __m512i middleBits = _mm512_or_si512(
+                _mm512_and_si512(_mm512_srli_epi32(codePoints, 6), _mm512_set1_epi32(0x3F)),
+                _mm512_set1_epi32(0x80));
+            const __m512i threeBytes = _mm512_or_si512(
+                _mm512_or_si512(_mm512_srli_epi32(codePoints, 12), _mm512_set1_epi32(0xE0)),
+                _mm512_or_si512(_mm512_slli_epi32(middleBits, 8), _mm512_slli_epi32(lowBits, 16)));
+            const __m512i lanes = _mm512_mask_blend_epi32(
+                atLeast800,
+                _mm512_mask_blend_epi32(atLeast80, codePoints, twoBytes),
+                threeBytes);
+
+            // Keep the lead byte of every lane, plus the second and third
+            // bytes of the lanes that need them
+            const unsigned long long keep = kLaneBytes
+                | (_pdep_u64(atLeast80, kLaneBytes) << 1)
+                | (_pdep_u64(atLeast800, kLaneBytes) << 2);
+            const unsigned int length = static_cast<unsigned int>(_mm_popcnt_u64(keep));
+
+            _mm512_mask_storeu_epi8(
+                dst + written,
+                (1ULL << length) - 1,
+                _mm512_maskz_compress_epi8(keep, lanes));
+            written += length;
+        }
+        read += 32;
+    }
+
+    const KernelProgress tail = ConvertUtf16ToUtf8Avx2(src + read, srcLength - read, dst + written);
+    return { read + tail.unitsRead, written + tail.unitsWritten };
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+
+//------------------------------------------------------------------------------
+// The scanning kernels validate a prefix of their input, stopping at the first
+// block with an error, or when less than a block is left. With kMeasure, they
+// also count the code units of its conversion to the other encoding.
+// They return the length of the prefix, and the count (or 0).
+// The last sequence of the prefix may be incomplete: the caller must
+// back off to its start, and let the scalar code check the rest.
+//------------------------------------------------------------------------------
+
+
+//------------------------------------------------------------------------------
+// Error bits of the UTF-8 validation lookup tables. Each pair of
+// consecutive chars is classified by three 16-entry tables, indexed by
+// the high and low nibbles of the first char and the high nibble of the
+// second one: a bit left set in all three is an error (the technique of
+// Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte").
+//------------------------------------------------------------------------------
+inline constexpr char kUtf8TooShort     = 1 << 0;   // Lead or ASCII after a lead
+inline constexpr char kUtf8TooLong      = 1 << 1;   // Continuation after ASCII
+inline constexpr char kUtf8Overlong3    = 1 << 2;   // E0 80..9F
+inline constexpr char kUtf8TooLarge     = 1 << 3;   // F4 90..BF, F5..FF
+inline constexpr char kUtf8Surrogate    = 1 << 4;   // ED A0..BF
+inline constexpr char kUtf8Overlong2    = 1 << 5;   // C0..C1
+inline constexpr char kUtf8TooLarge1000 = 1 << 6;   // F5..FF 80..8F
+inline constexpr char kUtf8Overlong4    = 1 << 6;   // F0 80..8F
+inline constexpr char kUtf8TwoConts     = static_cast<char>(1 << 7);   // Continuation after continuation
+inline constexpr char kUtf8Carry        = kUtf8TooShort | kUtf8TooLong | kUtf8TwoConts;
+
+
+//------------------------------------------------------------------------------
+// Find the UTF-8 errors of a block of 16 chars, given the previous block:
+// returns non-zero bytes where a sequence is invalid, except for
+// a sequence left incomplete at the end of the block.
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_SSE42
+inline __m128i FindUtf8Errors16(__m128i in, __m128i previous) noexcept
+{
+    const __m128i byte1HighTable = _mm_setr_epi8(
+        kUtf8TooLong, kUtf8TooLong, kUtf8TooLong, kUtf8TooLong,
+        kUtf8TooLong, kUtf8TooLong, kUtf8TooLong, kUtf8TooLong,
+        kUtf8TwoConts, kUtf8TwoConts, kUtf8TwoConts, kUtf8TwoConts,
+        kUtf8TooShort | kUtf8Overlong2,
+        kUtf8TooShort,
+        kUtf8TooShort | kUtf8Overlong3 | kUtf8Surrogate,
+        kUtf8TooShort | kUtf8TooLarge | kUtf8TooLarge1000 | kUtf8Overlong4);
+    const __m128i byte1LowTable = _mm_setr_epi8(
+        kUtf8Carry | kUtf8Overlong3 | kUtf8Overlong2 | kUtf8Overlong4,
+        kUtf8Carry | kUtf8Overlong2,
+        kUtf8Carry,
+        kUtf8Carry,
+        kUtf8Carry | kUtf8TooLarge,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000 | kUtf8Surrogate,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000);
+    const __m128i byte2HighTable = _mm_setr_epi8(
+        kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort,
+        kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Overlong3 | kUtf8TooLarge1000 | kUtf8Overlong4,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Overlong3 | kUtf8TooLarge,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Surrogate | kUtf8TooLarge,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Surrogate | kUtf8TooLarge,
+        kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort);
+
+    const __m128i lowNibble = _mm_set1_epi8(0x0F);
+
+    // Classify each char with the char before it
+    const __m128i previous1 = _mm_alignr_epi8(in, previous, 15);
+    const __m128i byte1High = _mm_shuffle_epi8(byte1HighTable, _mm_and_si128(_mm_srli_epi16(previous1, 4), lowNibble));
+    const __m128i byte1Low = _mm_shuffle_epi8(byte1LowTable, _mm_and_si128(previous1, lowNibble));
+    const __m128i byte2High = _mm_shuffle_epi8(byte2HighTable, _mm_and_si128(_mm_srli_epi16(in, 4), lowNibble));
+    const __m128i special = _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+
+    // The 3rd and 4th chars of 3-char and 4-char sequences must be continuations
+    // (bit 7 set here only after a lead of 0xE0 and above, or 0xF0 and above),
+    // which is the only case where two continuations in a row are valid
+    const __m128i thirdChar = _mm_subs_epu8(_mm_alignr_epi8(in, previous, 14), _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    const __m128i fourthChar = _mm_subs_epu8(_mm_alignr_epi8(in, previous, 13), _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    const __m128i mustBeContinuation = _mm_and_si128(_mm_or_si128(thirdChar, fourthChar), _mm_set1_epi8(kUtf8TwoConts));
+
+    return _mm_xor_si128(mustBeContinuation, special);
+}
+
+
+//------------------------------------------------------------------------------
+// Return non-zero bytes if the block ends with an incomplete sequence
+// (a lead of 2, 3, 4 chars in its last 1, 2, 3 chars)
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_SSE42
+inline __m128i FindUtf8IncompleteEnd16(__m128i in) noexcept
+{
+    const __m128i maxValues = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm_subs_epu8(in, maxValues);
+}
+
+
+//------------------------------------------------------------------------------
+// Count the UTF-16 code units of the UTF-8 chars of a block:
+// one per lead or ASCII char, and another one per 4-char lead
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_SSE42
+inline unsigned int CountUtf16Units16(__m128i in) noexcept
+{
+    // Continuations are 0x80..0xBF, 4-char leads 0xF0 and above:
+    // as signed chars, the ASCII ones must be excluded from the latter
+    const int continuationMask = _mm_movemask_epi8(_mm_cmplt_epi8(in, _mm_set1_epi8(static_cast<char>(0xC0))));
+    const int fourCharLeadMask = _mm_movemask_epi8(_mm_cmpgt_epi8(in, _mm_set1_epi8(static_cast<char>(0xEF))))
+                               & _mm_movemask_epi8(in);
+    return static_cast<unsigned int>(16 - _mm_popcnt_u32(static_cast<unsigned int>(continuationMask))
+                                     + _mm_popcnt_u32(static_cast<unsigned int>(fourCharLeadMask)));
+}
+
+
+//------------------------------------------------------------------------------
+// SSE2 UTF-8 scanning kernel: ASCII runs, 16 chars per iteration
+//------------------------------------------------------------------------------
+template <bool kMeasure>
+inline KernelProgress ScanUtf8Sse2(const char* src, std::size_t srcLength) noexcept
+{
+    std::size_t read = 0;
+
+    while (srcLength - read >= 16
+           && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + read))) == 0)
+    {
+        read += 16;
+    }
+
+    return { read, kMeasure ? read : 0 };
+}
+
+
+//------------------------------------------------------------------------------
+// SSE4.2 UTF-8 scanning kernel: 16 chars per iteration
+//------------------------------------------------------------------------------
+template <bool kMeasure>
+UNICODECONVATLSTD_TARGET_SSE42
+inline KernelProgress ScanUtf8Sse42(const char* src, std::size_t srcLength) noexcept
+{
+    std::size_t read = 0;
+    std::size_t counted = 0;
+    __m128i previous = _mm_setzero_si128();
+    __m128i previousIncomplete = _mm_setzero_si128();
+
+    while (srcLength - read >= 16)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + read));
+
+        // An ASCII block is valid, unless it cuts short a sequence
+        // left incomplete by the previous block
+        __m128i errors = previousIncomplete;
+        const bool ascii = (_mm_movemask_epi8(in) == 0);
+        if (!ascii)
+        {
+            errors = FindUtf8Errors16(in, previous);
+            previousIncomplete = FindUtf8IncompleteEnd16(in);
+        }
+
+        if (!_mm_testz_si128(errors, errors))
+        {
+            break;
+        }
+
+        if (kMeasure)
+        {
+            counted += ascii ? 16 : CountUtf16Units16(in);
+        }
+        previous = in;
+        read += 16;
+    }
+
+    return { read, counted };
+}
+
+
+//------------------------------------------------------------------------------
+// AVX2 versions of FindUtf8Errors16 and FindUtf8IncompleteEnd16,
+// on blocks of 32 chars
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_AVX2
+inline __m256i FindUtf8Errors32(__m256i in, __m256i previous) noexcept
+{
+    const __m256i byte1HighTable = _mm256_setr_epi8(
+        kUtf8TooLong, kUtf8TooLong, kUtf8TooLong, kUtf8TooLong,
+        kUtf8TooLong, kUtf8TooLong, kUtf8TooLong, kUtf8TooLong,
+        kUtf8TwoConts, kUtf8TwoConts, kUtf8TwoConts, kUtf8TwoConts,
+        kUtf8TooShort | kUtf8Overlong2,
+        kUtf8TooShort,
+        kUtf8TooShort | kUtf8Overlong3 | kUtf8Surrogate,
+        kUtf8TooShort | kUtf8TooLarge | kUtf8TooLarge1000 | kUtf8Overlong4,
+        kUtf8TooLong, kUtf8TooLong, kUtf8TooLong, kUtf8TooLong,
+        kUtf8TooLong, kUtf8TooLong, kUtf8TooLong, kUtf8TooLong,
+        kUtf8TwoConts, kUtf8TwoConts, kUtf8TwoConts, kUtf8TwoConts,
+        kUtf8TooShort | kUtf8Overlong2,
+        kUtf8TooShort,
+        kUtf8TooShort | kUtf8Overlong3 | kUtf8Surrogate,
+        kUtf8TooShort | kUtf8TooLarge | kUtf8TooLarge1000 | kUtf8Overlong4);
+    const __m256i byte1LowTable = _mm256_setr_epi8(
+        kUtf8Carry | kUtf8Overlong3 | kUtf8Overlong2 | kUtf8Overlong4,
+        kUtf8Carry | kUtf8Overlong2,
+        kUtf8Carry,
+        kUtf8Carry,
+        kUtf8Carry | kUtf8TooLarge,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000 | kUtf8Surrogate,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8Overlong3 | kUtf8Overlong2 | kUtf8Overlong4,
+        kUtf8Carry | kUtf8Overlong2,
+        kUtf8Carry,
+        kUtf8Carry,
+        kUtf8Carry | kUtf8TooLarge,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000 | kUtf8Surrogate,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000);
+    const __m256i byte2HighTable = _mm256_setr_epi8(
+        kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort,
+        kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Overlong3 | kUtf8TooLarge1000 | kUtf8Overlong4,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Overlong3 | kUtf8TooLarge,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Surrogate | kUtf8TooLarge,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Surrogate | kUtf8TooLarge,
+        kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort,
+        kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort,
+        kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Overlong3 | kUtf8TooLarge1000 | kUtf8Overlong4,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Overlong3 | kUtf8TooLarge,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Surrogate | kUtf8TooLarge,
+        kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Surrogate | kUtf8TooLarge,
+        kUtf8TooShort, kUtf8TooShort, kUtf8TooShort, kUtf8TooShort);
+
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+
+    // The chars before each char: the 128-bit lanes are shifted separately,
+    // so pair the high lane of the previous block with the low lane of this one
+    const __m256i straddle = _mm256_permute2x128_si256(previous, in, 0x21);
+    const __m256i previous1 = _mm256_alignr_epi8(in, straddle, 15);
+
+    const __m256i byte1High = _mm256_shuffle_epi8(byte1HighTable, _mm256_and_si256(_mm256_srli_epi16(previous1, 4), lowNibble));
+    const __m256i byte1Low = _mm256_shuffle_epi8(byte1LowTable, _mm256_and_si256(previous1, lowNibble));
+    const __m256i byte2High = _mm256_shuffle_epi8(byte2HighTable, _mm256_and_si256(_mm256_srli_epi16(in, 4), lowNibble));
+    const __m256i special = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+    const __m256i thirdChar = _mm256_subs_epu8(_mm256_alignr_epi8(in, straddle, 14), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    const __m256i fourthChar = _mm256_subs_epu8(_mm256_alignr_epi8(in, straddle, 13), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    const __m256i mustBeContinuation = _mm256_and_si256(_mm256_or_si256(thirdChar, fourthChar), _mm256_set1_epi8(kUtf8TwoConts));
+
+    return _mm256_xor_si256(mustBeContinuation, special);
+}
+
+UNICODECONVATLSTD_TARGET_AVX2
+inline __m256i FindUtf8IncompleteEnd32(__m256i in) noexcept
+{
+    const __m256i maxValues = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm256_subs_epu8(in, maxValues);
+}
+
+
+//------------------------------------------------------------------------------
+// AVX2 version of CountUtf16Units16, on a block of 32 chars
+//------------------------------------------------------------------------------
+UNICODECONVATLSTD_TARGET_AVX2
+inline unsigned int CountUtf16Units32(__m256i in) noexcept
+{
+    const int continuationMask = _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(0xC0)), in));
+    const int fourCharLeadMask = _mm256_movemask_epi8(_mm256_cmpgt_epi8(in, _mm256_set1_epi8(static_cast<char>(0xEF))))
+                               & _mm256_movemask_epi8(in);
+    return static_cast<unsigned int>(32 - _mm_popcnt_u32(static_cast<unsigned int>(continuationMask))
+                                     + _mm_popcnt_u32(static_cast<unsigned int>(fourCharLeadMask)));
+}
+
+
+//------------------------------------------------------------------------------
+// AVX2 UTF-8 scanning kernel: 32 chars per iteration,
+// ASCII runs 64 chars per iteration
+//------------------------------------------------------------------------------
+template <bool kMeasure>
+UNICODECONVATLSTD_TARGET_AVX2
+inline KernelProgress ScanUtf8Avx2(const char* src, std::size_t srcLength) noexcept
+{
+    std::size_t read = 0;
+    std::size_t counted = 0;
+    __m256i previous = _mm256_setzero_si256();
+    __m256i previousIncomplete = _mm256_setzero_si256();
+
+    while (srcLength - read >= 32)
+    {
+        const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + read));
+
+        if (_mm256_movemask_epi8(in) == 0)
+        {
+            // An ASCII block is valid, unless it cuts short a sequence
+            // left incomplete by the previous block
+            if (!_mm256_testz_si256(previousIncomplete, previousIncomplete))
+            {
+                break;
+            }
+
+            // Skip the following ASCII blocks two at a time
+            const std::size_t asciiStart = read;
+            read += 32;
+            while (srcLength - read >= 64)
+            {
+                const __m256i in0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + read));
+                const __m256i in1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + read + 32));
+                if (_mm256_movemask_epi8(_mm256_or_si256(in0, in1)) != 0)
+                {
+                    break;
+                }
+                read += 64;
+            }
+
+            if (kMeasure)
+            {
+                counted += read - asciiStart;
+            }
+            previous = _mm256_setzero_si256();
+            previousIncomplete = _mm256_setzero_si256();
+            continue;
+        }
+
+        const __m256i errors = FindUtf8Errors32(in, previous);
+        if (!_mm256_testz_si256(errors, errors))
+        {
+            break;
+        }
+
+        if (kMeasure)
+        {
+            counted += CountUtf16Units32(in);
+        }
+        previous = in;
+        previousIncomplete = FindUtf8IncompleteEnd32(in);
+        read += 32;
+    }
+
+    return { read, counted };
+}
+
+
+//------------------------------------------------------------------------------
+// Sum the 16-bit lanes of a vector
+//------------------------------------------------------------------------------
+inline std::ptrdiff_t SumLanes16(__m128i lanes) noexcept
+{
+    alignas(16) std::int32_t sums[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(sums), _mm_madd_epi16(lanes, _mm_set1_epi16(1)));
+    return static_cast<std::ptrdiff_t>(sums[0]) + sums[1] + sums[2] + sums[3];
+}
+
+
+//------------------------------------------------------------------------------
+// The UTF-16 scanning kernels count 3 UTF-8 chars per code unit,
+// and add -1 per lane mask of code units below 0x80, below 0x800,
+// and of surrogates (a pair takes 4 chars). The 16-bit lane sums are
+// flushed every kLaneSumIterations blocks, before they can overflow.
+//------------------------------------------------------------------------------
+inline constexpr std::size_t kLaneSumIterations = 4096;
+
+
+//------------------------------------------------------------------------------
+// SSE2 UTF-16 scanning kernel: 8 code units per iteration.
+// Each high surrogate must be followed by a low surrogate,
+// and each low surrogate preceded by a high one.
+//------------------------------------------------------------------------------
+template <bool kMeasure>
+inline KernelProgress ScanUtf16Sse2(const char16_t* src, std::size_t srcLength) noexcept
+{
+    // The pairs are checked from their high surrogate:
+    // a low surrogate can't start the text
+    if (srcLength == 0 || (src[0] & 0xFC00) == 0xDC00)
+    {
+        return { 0, 0 };
+    }
+
+    const __m128i surrogateBits = _mm_set1_epi16(static_cast<short>(0xFC00));
+    const __m128i highSurrogate = _mm_set1_epi16(static_cast<short>(0xD800));
+    const __m128i lowSurrogate = _mm_set1_epi16(static_cast<short>(0xDC00));
+
+    std::size_t read = 0;
+    std::ptrdiff_t adjustment = 0;
+    __m128i laneSums = _mm_setzero_si128();
+    std::size_t iterations = 0;
+
+    // Compare each code unit with the next one
+    while (srcLength - read >= 9)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + read));
+        const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + read + 1));
+        const __m128i isHigh = _mm_cmpeq_epi16(_mm_and_si128(in, surrogateBits), highSurrogate);
+        const __m128i isNextLow = _mm_cmpeq_epi16(_mm_and_si128(next, surrogateBits), lowSurrogate);
+        if (_mm_movemask_epi8(_mm_xor_si128(isHigh, isNextLow)) != 0)
+        {
+            break;
+        }
+
+        if (kMeasure)
+        {
+            const __m128i isAscii = _mm_cmpeq_epi16(
+                _mm_and_si128(in, _mm_set1_epi16(static_cast<short>(0xFF80))), _mm_setzero_si128());
+            const __m128i isBelow800 = _mm_cmpeq_epi16(
+                _mm_and_si128(in, _mm_set1_epi16(static_cast<short>(0xF800))), _mm_setzero_si128());
+            const __m128i isSurrogate = _mm_cmpeq_epi16(
+                _mm_and_si128(in, _mm_set1_epi16(static_cast<short>(0xF800))), highSurrogate);
+            laneSums = _mm_add_epi16(laneSums, _mm_add_epi16(_mm_add_epi16(isAscii, isBelow800), isSurrogate));
+            if (++iterations == kLaneSumIterations)
+            {
+                adjustment += SumLanes16(laneSums);
+                laneSums = _mm_setzero_si128();
+                iterations = 0;
+            }
+        }
+        read += 8;
+    }
+
+    if (!kMeasure)
+    {
+        return { read, 0 };
+    }
+
+    adjustment += SumLanes16(laneSums);
+    return { read, static_cast<std::size_t>(static_cast<std::ptrdiff_t>(read * 3) + adjustment) };
+}
+
+
+//------------------------------------------------------------------------------
+// AVX2 UTF-16 scanning kernel: as the SSE2 one, 16 code units per iteration
+//------------------------------------------------------------------------------
+template <bool kMeasure>
+UNICODECONVATLSTD_TARGET_AVX2
+inline KernelProgress ScanUtf16Avx2(const char16_t* src, std::size_t srcLength) noexcept
+{
+    if (srcLength == 0 || (src[0] & 0xFC00) == 0xDC00)
+    {
+        return { 0, 0 };
+    }
+
+    const __m256i surrogateBits = _mm256_set1_epi16(static_cast<short>(0xFC00));
+    const __m256i highSurrogate = _mm256_set1_epi16(static_cast<short>(0xD800));
+    const __m256i lowSurrogate = _mm256_set1_epi16(static_cast<short>(0xDC00));
+
+    std::size_t read = 0;
+    std::ptrdiff_t adjustment = 0;
+    __m256i laneSums = _mm256_setzero_si256();
+    std::size_t iterations = 0;
+
+    while (srcLength - read >= 17)
+    {
+        const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + read));
+        const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + read + 1));
+        const __m256i isHigh = _mm256_cmpeq_epi16(_mm256_and_si256(in, surrogateBits), highSurrogate);
+        const __m256i isNextLow = _mm256_cmpeq_epi16(_mm256_and_si256(next, surrogateBits), lowSurrogate);
+        if (!_mm256_testz_si256(_mm256_xor_si256(isHigh, isNextLow), _mm256_set1_epi8(-1)))
+        {
+            break;
+        }
+
+        if (kMeasure)
+        {
+            const __m256i isAscii = _mm256_cmpeq_epi16(
+                _mm256_and_si256(in, _mm256_set1_epi16(static_cast<short>(0xFF80))), _mm256_setzero_si256());
+            const __m256i isBelow800 = _mm256_cmpeq_epi16(
+                _mm256_and_si256(in, _mm256_set1_epi16(static_cast<short>(0xF800))), _mm256_setzero_si256());
+            const __m256i isSurrogate = _mm256_cmpeq_epi16(
+                _mm256_and_si256(in, _mm256_set1_epi16(static_cast<short>(0xF800))), highSurrogate);
+            laneSums = _mm256_add_epi16(laneSums, _mm256_add_epi16(_mm256_add_epi16(isAscii, isBelow800), isSurrogate));
+            if (++iterations == kLaneSumIterations)
+            {
+                adjustment += SumLanes16(_mm_add_epi16(_mm256_castsi256_si128(laneSums),
+                                                       _mm256_extracti128_si256(laneSums, 1)));
+                laneSums = _mm256_setzero_si256();
+                iterations = 0;
+            }
+        }
+        read += 16;
+    }
+
+    if (!kMeasure)
+    {
+        return { read, 0 };
+    }
+
+    adjustment += SumLanes16(_mm_add_epi16(_mm256_castsi256_si128(laneSums),
+                                           _mm256_extracti128_si256(laneSums, 1)));
+    return { read, static_cast<std::size_t>(static_cast<std::ptrdiff_t>(read * 3) + adjustment) };
+}
+
+#endif // UNICODECONVATLSTD_X64_SIMD
+
+
+#if defined(UNICODECONVATLSTD_X64_SIMD)
+
+//------------------------------------------------------------------------------
+// Query the processor with cpuid (leaf, subleaf): returns eax, ebx, ecx, edx
+//------------------------------------------------------------------------------
+inline void QueryCpuid(unsigned int leaf, unsigned int subleaf, unsigned int registers[4]) noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int values[4] = {};
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; i++)
+    {
+        registers[i] = static_cast<unsigned int>(values[i]);
+    }
+#else
+    registers[0] = registers[1] = registers[2] = registers[3] = 0;
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+// Register state the operating system saves on context switches (XCR0)
+//------------------------------------------------------------------------------
+inline unsigned long long QueryEnabledRegisterState() noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _xgetbv(0);
+#else
+    unsigned int eax = 0;
+    unsigned int edx = 0;
+    __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+#endif // UNICODECONVATLSTD_X64_SIMD
+
+
+//------------------------------------------------------------------------------
+// Detect the best kernel tier the processor (and the OS) supports
+//------------------------------------------------------------------------------
+inline KernelTier DetectKernelTier() noexcept
+{
+#if defined(UNICODECONVATLSTD_X64_SIMD)
+    unsigned int leaf0[4];
+    QueryCpuid(0, 0, leaf0);
+
+    unsigned int leaf1[4];
+    QueryCpuid(1, 0, leaf1);
+
+    unsigned int leaf7[4] = {};
+    if (leaf0[0] >= 7)
+    {
+        QueryCpuid(7, 0, leaf7);
+    }
+
+    const auto hasBit = [](unsigned int reg, int bit) { return ((reg >> bit) & 1) != 0; };
+
+    // SSSE3, SSE4.1, SSE4.2, POPCNT
+    if (!(hasBit(leaf1[2], 9) && hasBit(leaf1[2], 19) && hasBit(leaf1[2], 20) && hasBit(leaf1[2], 23)))
+    {
+        return KernelTier::Sse2;
+    }
+
+    // AVX registers must be enabled by the OS (OSXSAVE, then XMM and YMM state)
+    if (!(hasBit(leaf1[2], 27) && hasBit(leaf1[2], 28)))
+    {
+        return KernelTier::Sse42;
+    }
+    const unsigned long long registerState = QueryEnabledRegisterState();
+
+    // AVX2, BMI1, BMI2
+    if ((registerState & 0x06) != 0x06
+        || !(hasBit(leaf7[1], 5) && hasBit(leaf7[1], 3) && hasBit(leaf7[1], 8)))
+    {
+        return KernelTier::Sse42;
+    }
+
+    // AVX-512 F, BW, VL, VBMI2, with opmask and ZMM state enabled
+    if ((registerState & 0xE6) != 0xE6
+        || !(hasBit(leaf7[1], 16) && hasBit(leaf7[1], 30) && hasBit(leaf7[1], 31) && hasBit(leaf7[2], 6)))
+    {
+        return KernelTier::Avx2;
+    }
+
+    return KernelTier::Avx512;
+#else
+    return KernelTier::Scalar;
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+// The kernels of a tier; the scalar tier has none
+//------------------------------------------------------------------------------
+struct KernelTable
+{
+    KernelTier tier;
+    KernelProgress (*utf8ToUtf16)(const char* src, std::size_t srcLength, char16_t* dst) noexcept;
+    KernelProgress (*utf16ToUtf8)(const char16_t* src, std::size_t srcLength, char* dst) noexcept;
+    KernelProgress (*validateUtf8)(const char* src, std::size_t srcLength) noexcept;
+    KernelProgress (*validateUtf16)(const char16_t* src, std::size_t srcLength) noexcept;
+    KernelProgress (*measureUtf8ToUtf16)(const char* src, std::size_t srcLength) noexcept;
+    KernelProgress (*measureUtf16ToUtf8)(const char16_t* src, std::size_t srcLength) noexcept;
+};
+
+// Indexed by KernelTier; there is no AVX-512 UTF-8 decoder, nor AVX-512
+// scanning kernels, so that tier uses the AVX2 kernels for them
+inline constexpr KernelTable kKernelTables[] =
+{
+    { KernelTier::Scalar, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr },
+#if defined(UNICODECONVATLSTD_X64_SIMD)
+    { KernelTier::Sse2, ConvertUtf8ToUtf16Sse2, ConvertUtf16ToUtf8Sse2,
+      ScanUtf8Sse2<false>, ScanUtf16Sse2<false>, ScanUtf8Sse2<true>, ScanUtf16Sse2<true> },
+    { KernelTier::Sse42, ConvertUtf8ToUtf16Sse42, ConvertUtf16ToUtf8Sse42,
+      ScanUtf8Sse42<false>, ScanUtf16Sse2<false>, ScanUtf8Sse42<true>, ScanUtf16Sse2<true> },
+    { KernelTier::Avx2, ConvertUtf8ToUtf16Avx2, ConvertUtf16ToUtf8Avx2,
+      ScanUtf8Avx2<false>, ScanUtf16Avx2<false>, ScanUtf8Avx2<true>, ScanUtf16Avx2<true> },
+    { KernelTier::Avx512, ConvertUtf8ToUtf16Avx2, ConvertUtf16ToUtf8Avx512,
+      ScanUtf8Avx2<false>, ScanUtf16Avx2<false>, ScanUtf8Avx2<true>, ScanUtf16Avx2<true> },
+#endif
+};
+
+
+//------------------------------------------------------------------------------
+// Best tier supported on this machine, detected once
+//------------------------------------------------------------------------------
+inline KernelTier GetSupportedKernelTierCached() noexcept
+{
+    static const KernelTier supportedTier = DetectKernelTier();
+    return supportedTier;
+}
+
+
+//------------------------------------------------------------------------------
+// Find the tier with the given name. Returns false if there is none.
+//------------------------------------------------------------------------------
+inline bool FindKernelTierByName(const char* name, KernelTier& tier) noexcept
+{
+    for (const KernelTable& table : kKernelTables)
+    {
+        if (std::strcmp(name, GetKernelTierName(table.tier)) == 0)
+        {
+            tier = table.tier;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+//------------------------------------------------------------------------------
+// Read the tier forced with the UNICODECONVATLSTD_KERNEL_TIER
+// environment variable. Returns false if it's not set (or not valid).
+//------------------------------------------------------------------------------
+inline bool ReadKernelTierFromEnvironment(KernelTier& tier) noexcept
+{
+    constexpr const char* kVariableName = "UNICODECONVATLSTD_KERNEL_TIER";
+
+#if defined(_MSC_VER)
+    char* value = nullptr;
+    std::size_t valueLength = 0;
+    if (_dupenv_s(&value, &valueLength, kVariableName) != 0 || value == nullptr)
+    {
+        return false;
+    }
+    const bool found = FindKernelTierByName(value, tier);
+    std::free(value);
+    return found;
+#else
+    const char* value = std::getenv(kVariableName);
+    return value != nullptr && FindKernelTierByName(value, tier);
+#endif
+}
+
+
+//------------------------------------------------------------------------------
+// Tier not above the supported one
+//------------------------------------------------------------------------------
+inline KernelTier ClampKernelTier(KernelTier tier) noexcept
+{
+    const KernelTier supportedTier = GetSupportedKernelTierCached();
+    return (static_cast<int>(tier) > static_cast<int>(supportedTier)) ? supportedTier : tier;
+}
+
+
+// Kernels in use; selected on first use
+inline std::atomic<const KernelTable*> g_kernelTable{ nullptr };
+
+
+//------------------------------------------------------------------------------
+// Return the kernels in use, selecting them on first call: the best supported
+// tier, unless a lower one is forced from the environment
+//------------------------------------------------------------------------------
+inline const KernelTable& GetKernelTable() noexcept
+{
+    const KernelTable* table = g_kernelTable.load(std::memory_order_acquire);
+    if (table != nullptr)
+    {
+        return *table;
+    }
+
+    KernelTier tier = GetSupportedKernelTierCached();
+    if (ReadKernelTierFromEnvironment(tier))
+    {
+        tier = ClampKernelTier(tier);
+    }
+
+    // A concurrent first call or SetKernelTier() may get there first
+    const KernelTable* selected = &kKernelTables[static_cast<int>(tier)];
+    if (!g_kernelTable.compare_exchange_strong(table, selected, std::memory_order_acq_rel))
+    {
+        return *table;
+    }
+    return *selected;
+}
+
+} // namespace Details
+
+
+//------------------------------------------------------------------------------
+// Return the best kernel tier supported by this processor
+//------------------------------------------------------------------------------
+[[nodiscard]] inline KernelTier GetSupportedKernelTier() noexcept
+{
+    return Details::GetSupportedKernelTierCached();
+}
+
+
+//------------------------------------------------------------------------------
+// Return the kernel tier used by the conversions
+//------------------------------------------------------------------------------
+[[nodiscard]] inline KernelTier GetKernelTier() noexcept
+{
+    return Details::GetKernelTable().tier;
+}
+
+
+//------------------------------------------------------------------------------
+// Force the kernel tier used by the conversions, e.g. for benchmarking or
+// to rule out a vectorized kernel when investigating a bug.
+// Tiers above the supported one are lowered to it.
+// Returns the tier actually in use.
+//------------------------------------------------------------------------------
+inline KernelTier SetKernelTier(KernelTier tier) noexcept
+{
+    const Details::KernelTable& table = Details::kKernelTables[static_cast<int>(Details::ClampKernelTier(tier))];
+    Details::g_kernelTable.store(&table, std::memory_order_release);
+    return table.tier;
+}
+
+} // namespace UnicodeConvAtlStd
+
+
+#endif // GIOVANNI_DICANIO_UNICODECONVSIMD_HPP_INCLUDED
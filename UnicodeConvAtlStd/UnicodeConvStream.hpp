@@ -0,0 +1,340 @@
+#ifndef GIOVANNI_DICANIO_UNICODECONVSTREAM_HPP_INCLUDED
+#define GIOVANNI_DICANIO_UNICODECONVSTREAM_HPP_INCLUDED
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Streaming UTF-16/UTF-8 transcoders for text received in fragments
+//
+//                  Copyright (C) by Giovanni Dicanio
+//                    <giovanni.dicanio AT gmail.com>
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+//------------------------------------------------------------------------------
+// This is a header-only C++ file that implements stateful transcoders
+// for input that arrives in fragments (e.g. from sockets or files),
+// which can split a UTF-8 sequence or a UTF-16 surrogate pair.
+//
+// The exported classes are:
+//
+//      * Convert from UTF-8 to UTF-16:
+//        class Utf8ToUtf16Stream
+//
+//      * Convert from UTF-16 to UTF-8:
+//        class Utf16ToUtf8Stream
+//
+// Feed() converts the complete code points of each fragment, appending them
+// to an output string, and keeps the incomplete one at the end (at most
+// 3 UTF-8 chars, or a high surrogate) for the next call: the memory used
+// doesn't depend on the total length of the input.
+// Finish() reports a truncated sequence left at the end of the input.
+//
+// Errors are signaled throwing UnicodeConversionException, as in
+// UnicodeConvCore.hpp, with error offsets counted from the start of the input;
+// the output of the failed Feed() call is discarded, and the transcoder
+// is reset, ready for a new input.
+//
+// These classes live under the UnicodeConvAtlStd namespace.
+// They depend only on the C++ Standard Library.
+//
+//
+// The MIT License(MIT)
+//
+// Copyright(c) 2010-2023 by Giovanni Dicanio
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//------------------------------------------------------------------------------
+
+
+//==============================================================================
+//                              Includes
+//==============================================================================
+
+#include <cstddef>      // std::size_t
+#include <cstring>      // std::memcpy
+#include <string>       // std::string, std::u16string
+#include <string_view>  // std::string_view, std::u16string_view
+
+#include "UnicodeConvCore.hpp"  // Portable transcoding core
+
+
+//==============================================================================
+//                              Implementation
+//==============================================================================
+
+namespace UnicodeConvAtlStd {
+
+//------------------------------------------------------------------------------
+// Convert UTF-8 text, received in fragments, to UTF-16
+//------------------------------------------------------------------------------
+class Utf8ToUtf16Stream
+{
+public:
+
+    //--------------------------------------------------------------------------
+    // Convert the next fragment of UTF-8 input, appending the UTF-16 code units
+    // of its complete code points to utf16.
+    // An incomplete sequence at the end is kept, to be completed by the next
+    // fragment. Signal errors throwing UnicodeConversionException.
+    //--------------------------------------------------------------------------
+    void Feed(std::string_view utf8, std::u16string& utf16)
+    {
+        const std::size_t oldLength = utf16.length();
+        const std::size_t fragmentOffset = m_offset;
+        m_offset += utf8.length();
+
+        // Complete the sequence left by the previous fragment
+        std::size_t taken = 0;
+        if (m_pendingLength > 0)
+        {
+            const auto lead = static_cast<unsigned char>(m_pending[0]);
+            const std::size_t sequenceLength = (lead >= 0xF0) ? 4 : (lead >= 0xE0) ? 3 : 2;
+
+            const std::size_t pendingOffset = fragmentOffset - m_pendingLength;
+            while (m_pendingLength < sequenceLength && taken < utf8.length()
+                   && (static_cast<unsigned char>(utf8[taken]) & 0xC0) == 0x80)
+            {
+                m_pending[m_pendingLength++] = utf8[taken++];
+            }
+
+            if (m_pendingLength < sequenceLength && taken == utf8.length()
+                && Details::Utf8SequenceCanBeCompleted(m_pending, m_pendingLength))
+            {
+                // Still incomplete: wait for the next fragment
+                return;
+            }
+
+            // Complete, cut short by a char that can't continue it,
+            // or already invalid: then the conversion reports the invalid sequence
+            const ConversionResult result = Details::AppendUtf8ToUtf16SinglePass(
+                std::string_view(m_pending, m_pendingLength), utf16);
+            if (result.status != ConversionStatus::Ok)
+            {
+                Fail(utf16, oldLength, pendingOffset,
+                     Details::ClassifyUtf8Error(m_pending, m_pendingLength));
+            }
+
+            m_pendingLength = 0;
+            utf8.remove_prefix(taken);
+        }
+
+        // Convert the complete sequences, and keep the incomplete one at the end,
+        // unless it's already invalid (e.g. a 0xFF byte): then it's reported now
+        std::size_t tailLength = Details::Utf8IncompleteTailLength(utf8.data(), utf8.length());
+        if (tailLength > 0
+            && !Details::Utf8SequenceCanBeCompleted(utf8.data() + utf8.length() - tailLength, tailLength))
+        {
+            tailLength = 0;
+        }
+        const ConversionResult result = Details::AppendUtf8ToUtf16SinglePass(
+            utf8.substr(0, utf8.length() - tailLength), utf16);
+        if (result.status != ConversionStatus::Ok)
+        {
+            Fail(utf16, oldLength, fragmentOffset + taken + result.unitsRead,
+                 Details::ClassifyUtf8Error(utf8.data() + result.unitsRead, utf8.length() - result.unitsRead));
+        }
+
+        std::memcpy(m_pending, utf8.data() + utf8.length() - tailLength, tailLength);
+        m_pendingLength = tailLength;
+    }
+
+    //--------------------------------------------------------------------------
+    // Signal the end of the input: throw UnicodeConversionException
+    // if it ended with an incomplete sequence.
+    // The transcoder is then ready for a new input.
+    //--------------------------------------------------------------------------
+    void Finish()
+    {
+        if (m_pendingLength > 0)
+        {
+            // A truncated sequence: chars that can't start a valid one
+            // were already reported by Feed()
+            const std::size_t pendingOffset = m_offset - m_pendingLength;
+            const ConversionErrorKind errorKind = Details::ClassifyUtf8Error(m_pending, m_pendingLength);
+            Reset();
+            Details::ThrowConversionError(
+                { ConversionStatus::InvalidInput, UnicodeConversionException::ConversionType::FromUtf8ToUtf16,
+                  pendingOffset, errorKind });
+        }
+        Reset();
+    }
+
+    //--------------------------------------------------------------------------
+    // Is part of a sequence waiting for the next fragment?
+    //--------------------------------------------------------------------------
+    [[nodiscard]] bool HasPendingInput() const noexcept
+    {
+        return m_pendingLength > 0;
+    }
+
+    //--------------------------------------------------------------------------
+    // Discard the pending input, to start a new conversion
+    //--------------------------------------------------------------------------
+    void Reset() noexcept
+    {
+        m_pendingLength = 0;
+        m_offset = 0;
+    }
+
+private:
+
+    // Discard the output of the failed Feed() call, reset, and throw
+    // (errorOffset counts from the start of the input)
+    [[noreturn]] void Fail(
+        std::u16string& utf16, std::size_t oldLength, std::size_t errorOffset, ConversionErrorKind errorKind)
+    {
+        utf16.resize(oldLength);
+        Reset();
+        Details::ThrowConversionError(
+            { ConversionStatus::InvalidInput, UnicodeConversionException::ConversionType::FromUtf8ToUtf16,
+              errorOffset, errorKind });
+    }
+
+    // The leading chars of an incomplete sequence (at most 3 are kept
+    // between calls; the 4th completes it)
+    char m_pending[4] = {};
+    std::size_t m_pendingLength = 0;
+
+    // Chars fed since the start of the input
+    std::size_t m_offset = 0;
+};
+
+
+//------------------------------------------------------------------------------
+// Convert UTF-16 text, received in fragments, to UTF-8
+//------------------------------------------------------------------------------
+class Utf16ToUtf8Stream
+{
+public:
+
+    //--------------------------------------------------------------------------
+    // Convert the next fragment of UTF-16 input, appending the UTF-8 chars
+    // of its complete code points to utf8.
+    // A high surrogate at the end is kept, to be completed by the next
+    // fragment. Signal errors throwing UnicodeConversionException.
+    //--------------------------------------------------------------------------
+    void Feed(std::u16string_view utf16, std::string& utf8)
+    {
+        const std::size_t oldLength = utf8.length();
+        const std::size_t fragmentOffset = m_offset;
+        m_offset += utf16.length();
+
+        // Complete the surrogate pair left by the previous fragment
+        std::size_t taken = 0;
+        if (m_pendingHighSurrogate != 0)
+        {
+            if (utf16.empty())
+            {
+                return;
+            }
+
+            // If the next code unit is not a low surrogate,
+            // the conversion reports the lone high surrogate
+            const char16_t surrogatePair[2] = { m_pendingHighSurrogate, utf16[0] };
+            const ConversionResult result = Details::AppendUtf16ToUtf8SinglePass(
+                std::u16string_view(surrogatePair, 2), utf8);
+            if (result.status != ConversionStatus::Ok)
+            {
+                Fail(utf8, oldLength, fragmentOffset - 1, ConversionErrorKind::LoneHighSurrogate);
+            }
+
+            m_pendingHighSurrogate = 0;
+            utf16.remove_prefix(1);
+            taken = 1;
+        }
+
+        // Convert the complete code points, and keep a high surrogate at the end
+        const std::size_t tailLength =
+            (!utf16.empty() && (utf16.back() & 0xFC00) == 0xD800) ? 1 : 0;
+        const ConversionResult result = Details::AppendUtf16ToUtf8SinglePass(
+            utf16.substr(0, utf16.length() - tailLength), utf8);
+        if (result.status != ConversionStatus::Ok)
+        {
+            Fail(utf8, oldLength, fragmentOffset + taken + result.unitsRead,
+                 Details::DescribeUtf16Error(utf16.data(), result.unitsRead).kind);
+        }
+
+        if (tailLength > 0)
+        {
+            m_pendingHighSurrogate = utf16.back();
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Signal the end of the input: throw UnicodeConversionException
+    // if it ended with a high surrogate.
+    // The transcoder is then ready for a new input.
+    //--------------------------------------------------------------------------
+    void Finish()
+    {
+        if (m_pendingHighSurrogate != 0)
+        {
+            const std::size_t pendingOffset = m_offset - 1;
+            Reset();
+            Details::ThrowConversionError(
+                { ConversionStatus::InvalidInput, UnicodeConversionException::ConversionType::FromUtf16ToUtf8,
+                  pendingOffset, ConversionErrorKind::LoneHighSurrogate });
+        }
+        Reset();
+    }
+
+    //--------------------------------------------------------------------------
+    // Is a high surrogate waiting for the next fragment?
+    //--------------------------------------------------------------------------
+    [[nodiscard]] bool HasPendingInput() const noexcept
+    {
+        return m_pendingHighSurrogate != 0;
+    }
+
+    //--------------------------------------------------------------------------
+    // Discard the pending input, to start a new conversion
+    //--------------------------------------------------------------------------
+    void Reset() noexcept
+    {
+        m_pendingHighSurrogate = 0;
+        m_offset = 0;
+    }
+
+private:
+
+    // Discard the output of the failed Feed() call, reset, and throw
+    // (errorOffset counts from the start of the input)
+    [[noreturn]] void Fail(
+        std::string& utf8, std::size_t oldLength, std::size_t errorOffset, ConversionErrorKind errorKind)
+    {
+        utf8.resize(oldLength);
+        Reset();
+        Details::ThrowConversionError(
+            { ConversionStatus::InvalidInput, UnicodeConversionException::ConversionType::FromUtf16ToUtf8,
+              errorOffset, errorKind });
+    }
+
+    // High surrogate at the end of the previous fragment (0 if none)
+    char16_t m_pendingHighSurrogate = 0;
+
+    // Code units fed since the start of the input
+    std::size_t m_offset = 0;
+};
+
+} // namespace UnicodeConvAtlStd
+
+
+#endif // GIOVANNI_DICANIO_UNICODECONVSTREAM_HPP_INCLUDED
@@ -0,0 +1,402 @@
+#ifndef GIOVANNI_DICANIO_UNICODECONVSTREAMBUF_HPP_INCLUDED
+#define GIOVANNI_DICANIO_UNICODECONVSTREAMBUF_HPP_INCLUDED
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Stream buffers transcoding between UTF-16 and UTF-8 on the fly
+//
+//                  Copyright (C) by Giovanni Dicanio
+//                    <giovanni.dicanio AT gmail.com>
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+//------------------------------------------------------------------------------
+// This is a header-only C++ file that implements std::basic_streambuf adapters,
+// to write and read UTF-16 text through iostreams while the underlying
+// stream buffer holds UTF-8 (e.g. a std::filebuf, or the buffer
+// of a std::ofstream or of std::cout).
+//
+// The exported classes are:
+//
+//      * Write UTF-16, encoded as UTF-8 into a sink stream buffer:
+//        template <typename Utf16Char = char16_t>
+//        class Utf8EncodingStreambuf
+//
+//      * Read UTF-16, decoded from UTF-8 read from a source stream buffer:
+//        template <typename Utf16Char = char16_t>
+//        class Utf8DecodingStreambuf
+//
+// Utf16Char is char16_t, or wchar_t on Windows (e.g. to use them
+// with std::wostream and std::wistream).
+//
+// The text is transcoded through a fixed-size internal buffer, using
+// the streaming transcoders of UnicodeConvStream.hpp: the memory used
+// doesn't depend on the length of the text, and code points split
+// between two writes or reads are carried over.
+//
+// Invalid text is signaled throwing UnicodeConversionException, as in
+// UnicodeConvCore.hpp, with error offsets counted from the start of the text;
+// the iostreams catch it, and set badbit (rethrowing it if badbit is
+// in their exceptions() mask). Utf8EncodingStreambuf writes the valid text
+// before the error, and its Finish() throws the error again.
+//
+// These classes live under the UnicodeConvAtlStd namespace.
+// They depend only on the C++ Standard Library.
+//
+//
+// The MIT License(MIT)
+//
+// Copyright(c) 2010-2023 by Giovanni Dicanio
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//------------------------------------------------------------------------------
+
+
+//==============================================================================
+//                              Includes
+//==============================================================================
+
+#include <algorithm>    // std::min, std::max
+#include <cstddef>      // std::size_t
+#include <ios>          // std::streamsize
+#include <optional>     // std::optional
+#include <streambuf>    // std::basic_streambuf, std::streambuf
+#include <string>       // std::string, std::u16string
+#include <string_view>  // std::string_view, std::u16string_view
+#include <vector>       // std::vector
+
+#include "UnicodeConvCore.hpp"    // Portable transcoding core
+#include "UnicodeConvStream.hpp"  // Streaming transcoders
+
+
+//==============================================================================
+//                              Implementation
+//==============================================================================
+
+namespace UnicodeConvAtlStd {
+
+// Default length of the internal buffers, in code units
+inline constexpr std::size_t kDefaultStreambufLength = 4096;
+
+
+//------------------------------------------------------------------------------
+// Stream buffer that takes UTF-16 text, and writes it as UTF-8
+// into a sink stream buffer
+//------------------------------------------------------------------------------
+template <typename Utf16Char = char16_t>
+class Utf8EncodingStreambuf
+    : public std::basic_streambuf<Utf16Char>
+{
+    static_assert(Details::kIsUtf16CodeUnit<Utf16Char>,
+                  "The stream buffer must take UTF-16 code units (char16_t, or wchar_t on Windows)");
+
+public:
+
+    using int_type = typename std::basic_streambuf<Utf16Char>::int_type;
+    using traits_type = typename std::basic_streambuf<Utf16Char>::traits_type;
+
+    //--------------------------------------------------------------------------
+    // Write to the given sink, buffering bufferLength UTF-16 code units
+    //--------------------------------------------------------------------------
+    explicit Utf8EncodingStreambuf(std::streambuf& sink, std::size_t bufferLength = kDefaultStreambufLength)
+        : m_sink(sink),
+        m_buffer((std::max<std::size_t>)(bufferLength, 2))
+    {
+        m_utf8.reserve(m_buffer.size() * Details::kMaxUtf8CharsPerUtf16Unit);
+        ResetPutArea();
+    }
+
+    //--------------------------------------------------------------------------
+    // Write the buffered text. As with std::basic_filebuf, errors are ignored
+    // here: call Finish() to get them.
+    //--------------------------------------------------------------------------
+    ~Utf8EncodingStreambuf() override
+    {
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+        try
+        {
+            (void)Drain();
+        }
+        catch (...)
+        {
+        }
+#else
+        (void)Drain();
+#endif
+    }
+
+    // Ban copy
+    Utf8EncodingStreambuf(const Utf8EncodingStreambuf&) = delete;
+    Utf8EncodingStreambuf& operator=(const Utf8EncodingStreambuf&) = delete;
+
+    //--------------------------------------------------------------------------
+    // Signal the end of the text: write the buffered text, and flush the sink.
+    // Throw UnicodeConversionException if the text is invalid (also if that
+    // was already signaled to a stream), or if it ended with a high surrogate;
+    // return false if the sink failed.
+    // The stream buffer is then ready for a new text.
+    //--------------------------------------------------------------------------
+    bool Finish()
+    {
+        const bool written = Drain();
+        m_textLength = 0;
+        if (m_error.has_value())
+        {
+            const ConversionError error = *m_error;
+            m_error.reset();
+            Details::ThrowConversionError(error);
+        }
+        m_stream.Finish();
+        return written && m_sink.pubsync() != -1;
+    }
+
+protected:
+
+    int_type overflow(int_type ch) override
+    {
+        if (!Drain())
+        {
+            ThrowIfInvalid();
+            return traits_type::eof();
+        }
+
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            *this->pptr() = traits_type::to_char_type(ch);
+            this->pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const Utf16Char* text, std::streamsize count) override
+    {
+        // Copy short text into the buffer
+        if (count <= this->epptr() - this->pptr())
+        {
+            return std::basic_streambuf<Utf16Char>::xsputn(text, count);
+        }
+
+        // Transcode long text directly, a buffer length at a time
+        if (!Drain())
+        {
+            ThrowIfInvalid();
+            return 0;
+        }
+        std::streamsize written = 0;
+        while (written < count)
+        {
+            const std::size_t length = (std::min)(static_cast<std::size_t>(count - written), m_buffer.size());
+            if (!Write(text + written, length))
+            {
+                ThrowIfInvalid();
+                break;
+            }
+            written += static_cast<std::streamsize>(length);
+        }
+        return written;
+    }
+
+    int sync() override
+    {
+        if (!Drain())
+        {
+            ThrowIfInvalid();
+            return -1;
+        }
+        return (m_sink.pubsync() != -1) ? 0 : -1;
+    }
+
+private:
+
+    std::streambuf& m_sink;
+    std::vector<Utf16Char> m_buffer;
+
+    // UTF-8 output of each write, reused
+    std::string m_utf8;
+
+    // Carries a high surrogate over to the next write
+    Utf16ToUtf8Stream m_stream;
+
+    // Code units transcoded since the start of the text
+    std::size_t m_textLength = 0;
+
+    // First error of the text: nothing more is written after it
+    std::optional<ConversionError> m_error;
+
+    void ResetPutArea() noexcept
+    {
+        this->setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+    }
+
+    // Transcode the buffered text to the sink, emptying the buffer
+    // (also when the text is invalid)
+    bool Drain()
+    {
+        const Utf16Char* const begin = this->pbase();
+        const auto length = static_cast<std::size_t>(this->pptr() - begin);
+        ResetPutArea();
+        return Write(begin, length);
+    }
+
+    // Transcode the given text to the sink.
+    // On invalid text, write the valid text before the error,
+    // keep the error, and return false.
+    bool Write(const Utf16Char* text, std::size_t length)
+    {
+        if (m_error.has_value())
+        {
+            return false;
+        }
+
+        const std::u16string_view utf16(reinterpret_cast<const char16_t*>(text), length);
+        const std::size_t textOffset = m_textLength;
+        m_textLength += length;
+
+        m_utf8.clear();
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+        const Utf16ToUtf8Stream previousStream = m_stream;
+        try
+        {
+            m_stream.Feed(utf16, m_utf8);
+        }
+        catch (const UnicodeConversionException& ex)
+        {
+            m_error = ConversionError{ ConversionStatus::InvalidInput, ex.GetConversionType(),
+                                       ex.GetErrorOffset(), ex.GetErrorKind() };
+
+            // The error can be a high surrogate left by the previous write
+            const std::size_t validLength =
+                (ex.GetErrorOffset() > textOffset) ? ex.GetErrorOffset() - textOffset : 0;
+            m_stream = previousStream;
+            m_utf8.clear();
+            m_stream.Feed(utf16.substr(0, validLength), m_utf8);
+            m_stream.Reset();
+
+            (void)WriteUtf8();
+            return false;
+        }
+#else
+        m_stream.Feed(utf16, m_utf8);
+#endif
+
+        return WriteUtf8();
+    }
+
+    // Write the transcoded text to the sink
+    bool WriteUtf8()
+    {
+        const auto utf8Length = static_cast<std::streamsize>(m_utf8.length());
+        return m_sink.sputn(m_utf8.data(), utf8Length) == utf8Length;
+    }
+
+    // Signal the error of the text, if any, to the stream
+    void ThrowIfInvalid() const
+    {
+        if (m_error.has_value())
+        {
+            Details::ThrowConversionError(*m_error);
+        }
+    }
+};
+
+
+//------------------------------------------------------------------------------
+// Stream buffer that reads UTF-8 text from a source stream buffer,
+// and gives it as UTF-16
+//------------------------------------------------------------------------------
+template <typename Utf16Char = char16_t>
+class Utf8DecodingStreambuf
+    : public std::basic_streambuf<Utf16Char>
+{
+    static_assert(Details::kIsUtf16CodeUnit<Utf16Char>,
+                  "The stream buffer must give UTF-16 code units (char16_t, or wchar_t on Windows)");
+
+public:
+
+    using int_type = typename std::basic_streambuf<Utf16Char>::int_type;
+    using traits_type = typename std::basic_streambuf<Utf16Char>::traits_type;
+
+    //--------------------------------------------------------------------------
+    // Read from the given source, bufferLength UTF-8 chars at a time
+    //--------------------------------------------------------------------------
+    explicit Utf8DecodingStreambuf(std::streambuf& source, std::size_t bufferLength = kDefaultStreambufLength)
+        : m_source(source),
+        m_buffer((std::max<std::size_t>)(bufferLength, 4))
+    {
+        m_utf16.reserve(m_buffer.size());
+    }
+
+    // Ban copy
+    Utf8DecodingStreambuf(const Utf8DecodingStreambuf&) = delete;
+    Utf8DecodingStreambuf& operator=(const Utf8DecodingStreambuf&) = delete;
+
+protected:
+
+    //--------------------------------------------------------------------------
+    // Decode the next chars of the source. Throw UnicodeConversionException
+    // if they are invalid, or if the source ends with a truncated sequence.
+    //--------------------------------------------------------------------------
+    int_type underflow() override
+    {
+        while (this->gptr() == this->egptr())
+        {
+            if (m_isFinished)
+            {
+                return traits_type::eof();
+            }
+
+            const std::streamsize length = m_source.sgetn(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+            if (length <= 0)
+            {
+                m_isFinished = true;
+                m_stream.Finish();
+                return traits_type::eof();
+            }
+
+            m_utf16.clear();
+            m_stream.Feed(std::string_view(m_buffer.data(), static_cast<std::size_t>(length)), m_utf16);
+
+            auto* const utf16 = reinterpret_cast<Utf16Char*>(m_utf16.data());
+            this->setg(utf16, utf16, utf16 + m_utf16.length());
+        }
+
+        return traits_type::to_int_type(*this->gptr());
+    }
+
+private:
+
+    std::streambuf& m_source;
+    std::vector<char> m_buffer;
+
+    // UTF-16 output of each read, reused
+    std::u16string m_utf16;
+
+    // Carries an incomplete sequence over to the next read
+    Utf8ToUtf16Stream m_stream;
+
+    // Has the source ended?
+    bool m_isFinished = false;
+};
+
+} // namespace UnicodeConvAtlStd
+
+
+#endif // GIOVANNI_DICANIO_UNICODECONVSTREAMBUF_HPP_INCLUDED